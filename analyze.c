@@ -0,0 +1,375 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "analyze.h"
+#include "engine.h"
+#include "form.h"
+#include "timeline.h"
+
+// --- Cost Measurement Settings ---
+#define COST_VOICES 16       // Voices held on an instrument while its cost is measured.
+#define COST_SECONDS 1.0     // Amount of audio rendered per measurement.
+#define COST_WARMUP_BLOCKS 8 // Blocks performed before timing starts.
+
+#define DENSITY_BAR_WIDTH 40 // Width of the longest bar in the density report.
+
+/**
+ * @brief A voice starting (+1) or ending (-1) on an instrument.
+ */
+typedef struct {
+    double time;
+    int instrument;
+    int delta;
+} VoiceEdge;
+
+static int compare_edges(const void* a, const void* b) {
+    const VoiceEdge* x = (const VoiceEdge*)a;
+    const VoiceEdge* y = (const VoiceEdge*)b;
+    if (x->time != y->time) return x->time < y->time ? -1 : 1;
+    return x->delta - y->delta; // A voice that ends as another starts is not counted twice.
+}
+
+/**
+ * @brief Returns the cost of one voice of an instrument. Instruments without a
+ *        figure are charged as the most expensive measured one.
+ */
+static double voice_cost(const VoiceCosts* costs, int instrument) {
+    if (instrument >= 1 && instrument <= NUM_INSTRUMENTS) {
+        return costs->voice_cost[instrument];
+    }
+    double highest = 0.0;
+    for (int i = 1; i <= NUM_INSTRUMENTS; i++) {
+        if (costs->voice_cost[i] > highest) {
+            highest = costs->voice_cost[i];
+        }
+    }
+    return highest;
+}
+
+/**
+ * @brief Counts the score events every track plays, walking its form.
+ */
+static int count_events(const Track* tracks, int num_tracks) {
+    int events = 0;
+    for (int t = 0; t < num_tracks; t++) {
+        FormCursor cursor;
+        for (form_start(&tracks[t], &cursor); cursor.measure >= 0; form_next(&tracks[t], &cursor)) {
+            events += tracks[t].measures[cursor.measure].event_count;
+        }
+    }
+    return events;
+}
+
+int analyze_score(Track* tracks, int num_tracks, const VoiceCosts* costs, ScoreAnalysis* analysis) {
+    memset(analysis, 0, sizeof(*analysis));
+    analysis->events = count_events(tracks, num_tracks);
+
+    Timeline timeline;
+    timeline_init(&timeline);
+    if (timeline_build(&timeline, tracks, num_tracks, 0.0, -1.0) != 0) {
+        timeline_free(&timeline);
+        return -1;
+    }
+    analysis->notes = timeline.count;
+
+    int instrument_count = 1;
+    for (int i = 0; i < timeline.count; i++) {
+        if (timeline.notes[i].instrument > instrument_count) {
+            instrument_count = timeline.notes[i].instrument;
+        }
+    }
+    analysis->instrument_count = instrument_count;
+    analysis->instruments = (InstrumentLoad*)calloc(instrument_count, sizeof(InstrumentLoad));
+    int* active = (int*)calloc(instrument_count, sizeof(int));
+    VoiceEdge* edges = (VoiceEdge*)malloc((size_t)(timeline.count > 0 ? timeline.count : 1) * 2 * sizeof(VoiceEdge));
+    if (analysis->instruments == NULL || active == NULL || edges == NULL) {
+        free(active);
+        free(edges);
+        timeline_free(&timeline);
+        analysis_free(analysis);
+        return -1;
+    }
+
+    // Every note holds a voice from its start until its release has ended.
+    for (int i = 0; i < timeline.count; i++) {
+        const PlayerNote* note = &timeline.notes[i];
+        double end = note->time + note->duration + instrument_release_seconds(note->instrument, note->duration);
+        InstrumentLoad* load = &analysis->instruments[note->instrument - 1];
+        load->notes++;
+        load->voice_seconds += end - note->time;
+        edges[2 * i] = (VoiceEdge){note->time, note->instrument, 1};
+        edges[2 * i + 1] = (VoiceEdge){end, note->instrument, -1};
+        if (end > analysis->duration) {
+            analysis->duration = end;
+        }
+    }
+    int edge_count = timeline.count * 2;
+    qsort(edges, edge_count, sizeof(VoiceEdge), compare_edges);
+
+    // First sweep: the peaks, which size the histograms.
+    int total = 0;
+    for (int e = 0; e < edge_count; e++) {
+        InstrumentLoad* load = &analysis->instruments[edges[e].instrument - 1];
+        active[edges[e].instrument - 1] += edges[e].delta;
+        total += edges[e].delta;
+        if (active[edges[e].instrument - 1] > load->peak_voices) {
+            load->peak_voices = active[edges[e].instrument - 1];
+        }
+        if (total > analysis->peak_voices) {
+            analysis->peak_voices = total;
+        }
+    }
+    int failed = 0;
+    for (int i = 0; i < instrument_count; i++) {
+        analysis->instruments[i].histogram = (double*)calloc(analysis->instruments[i].peak_voices + 1, sizeof(double));
+        failed |= analysis->instruments[i].histogram == NULL;
+    }
+
+    // Second sweep: how long each voice count lasts, and the cost of audio at every moment.
+    if (!failed) {
+        analysis->estimated = costs != NULL;
+        if (costs != NULL) {
+            analysis->peak_load = costs->baseline;
+        }
+        memset(active, 0, instrument_count * sizeof(int));
+        double previous = 0.0;
+        for (int e = 0; e < edge_count; e++) {
+            double span = edges[e].time - previous;
+            if (span > 0) {
+                for (int i = 0; i < instrument_count; i++) {
+                    analysis->instruments[i].histogram[active[i]] += span;
+                }
+                previous = edges[e].time;
+            }
+            active[edges[e].instrument - 1] += edges[e].delta;
+            if (costs != NULL && edges[e].delta > 0) {
+                double load = costs->baseline;
+                for (int i = 0; i < instrument_count; i++) {
+                    load += voice_cost(costs, i + 1) * active[i];
+                }
+                if (load > analysis->peak_load) {
+                    analysis->peak_load = load;
+                }
+            }
+        }
+        if (costs != NULL) {
+            analysis->render_seconds = costs->baseline * analysis->duration;
+            for (int i = 0; i < instrument_count; i++) {
+                analysis->render_seconds += voice_cost(costs, i + 1) * analysis->instruments[i].voice_seconds;
+            }
+        }
+
+        // Note density, in at most ANALYSIS_MAX_WINDOWS windows of whole seconds.
+        analysis->window_seconds = ceil(analysis->duration / ANALYSIS_MAX_WINDOWS);
+        if (analysis->window_seconds < 1.0) {
+            analysis->window_seconds = 1.0;
+        }
+        analysis->window_count = (int)ceil(analysis->duration / analysis->window_seconds);
+        analysis->window_notes = (int*)calloc(analysis->window_count > 0 ? analysis->window_count : 1, sizeof(int));
+        failed = analysis->window_notes == NULL;
+        for (int i = 0; i < timeline.count && !failed; i++) {
+            int w = (int)(timeline.notes[i].time / analysis->window_seconds);
+            analysis->window_notes[w < analysis->window_count ? w : analysis->window_count - 1]++;
+        }
+    }
+
+    free(active);
+    free(edges);
+    timeline_free(&timeline);
+    if (failed) {
+        analysis_free(analysis);
+        return -1;
+    }
+    return 0;
+}
+
+void analysis_free(ScoreAnalysis* analysis) {
+    if (analysis->instruments != NULL) {
+        for (int i = 0; i < analysis->instrument_count; i++) {
+            free(analysis->instruments[i].histogram);
+        }
+    }
+    free(analysis->instruments);
+    free(analysis->window_notes);
+    memset(analysis, 0, sizeof(*analysis));
+}
+
+void analysis_print(const ScoreAnalysis* analysis, FILE* out) {
+    fprintf(out, "Score analysis:\n");
+    fprintf(out, "  Duration:    %.2f s, until the last release has ended\n", analysis->duration);
+    fprintf(out, "  Events:      %d notes, chords and rests, repeats included\n", analysis->events);
+    fprintf(out, "  Voices:      %d started, at most %d sounding at once\n", analysis->notes, analysis->peak_voices);
+
+    int densest = 1;
+    for (int w = 0; w < analysis->window_count; w++) {
+        if (analysis->window_notes[w] > densest) {
+            densest = analysis->window_notes[w];
+        }
+    }
+    fprintf(out, "\nNote density (voices started per second, %.0f s windows):\n", analysis->window_seconds);
+    for (int w = 0; w < analysis->window_count; w++) {
+        int bar = (analysis->window_notes[w] * DENSITY_BAR_WIDTH + densest - 1) / densest;
+        fprintf(out, "  %7.0f s %7.1f  ", w * analysis->window_seconds, analysis->window_notes[w] / analysis->window_seconds);
+        for (int i = 0; i < bar; i++) {
+            fputc('#', out);
+        }
+        fputc('\n', out);
+    }
+
+    fprintf(out, "\nVoices per instrument (seconds with k voices sounding, k = 0, 1, 2, ...):\n");
+    fprintf(out, "  %5s %7s %5s %10s  %s\n", "instr", "notes", "peak", "voice-s", "histogram");
+    for (int i = 0; i < analysis->instrument_count; i++) {
+        const InstrumentLoad* load = &analysis->instruments[i];
+        if (load->notes == 0) {
+            continue;
+        }
+        fprintf(out, "  %5d %7d %5d %10.2f ", i + 1, load->notes, load->peak_voices, load->voice_seconds);
+        for (int k = 0; k <= load->peak_voices; k++) {
+            fprintf(out, " %.2f", load->histogram[k]);
+        }
+        fputc('\n', out);
+    }
+
+    if (analysis->estimated) {
+        fprintf(out, "\nEstimate:\n");
+        fprintf(out, "  Render time: %.3f s", analysis->render_seconds);
+        if (analysis->render_seconds > 0) {
+            fprintf(out, " (%.1fx real time)", analysis->duration / analysis->render_seconds);
+        }
+        fprintf(out, "\n  Peak load:   %.3f of one core\n", analysis->peak_load);
+    } else {
+        fprintf(out, "\nNo voice costs given: measure them with --calibrate-costs FILE and pass --costs FILE for an estimate.\n");
+    }
+
+    double voice_seconds = 0.0;
+    for (int i = 0; i < analysis->instrument_count; i++) {
+        voice_seconds += analysis->instruments[i].voice_seconds;
+    }
+    fprintf(out, "\nestimate duration=%.3f events=%d notes=%d peak_voices=%d voice_seconds=%.3f",
+        analysis->duration, analysis->events, analysis->notes, analysis->peak_voices, voice_seconds);
+    if (analysis->estimated) {
+        fprintf(out, " render_seconds=%.3f peak_load=%.3f", analysis->render_seconds, analysis->peak_load);
+    }
+    fputc('\n', out);
+}
+
+// --- Voice Costs ---
+
+/**
+ * @brief Measures the time taken to render one second of audio with voices held on an instrument.
+ * @param instrument The instrument to hold voices on, or 0 for none.
+ * @return The time in seconds, or a negative value if the instance could not run.
+ */
+static double measure_load(const EngineProfile* profile, int instrument, int voices) {
+    CSOUND* csound = engine_create(profile, "-n");
+    if (csound == NULL) {
+        return -1.0;
+    }
+    csoundSetOption(csound, "-m0");
+    if (csoundStart(csound) != 0) {
+        engine_destroy(csound);
+        return -1.0;
+    }
+
+    char score_event[128];
+    for (int v = 0; v < voices; v++) {
+        double freq = 110.0 * (1.0 + v * 0.25);
+        sprintf(score_event, "i%d %f %f %f %f", instrument, 0.0, 3600.0, freq, 0.01);
+        csoundInputMessage(csound, score_event);
+    }
+    for (int b = 0; b < COST_WARMUP_BLOCKS; b++) {
+        csoundPerformKsmps(csound);
+    }
+
+    int blocks = (int)(COST_SECONDS * profile->sr / profile->ksmps);
+    double start = engine_now_seconds();
+    for (int b = 0; b < blocks; b++) {
+        if (csoundPerformKsmps(csound) != 0) {
+            break;
+        }
+    }
+    double elapsed = engine_now_seconds() - start;
+
+    engine_destroy(csound);
+    return elapsed / (blocks * (double)profile->ksmps / profile->sr);
+}
+
+int analyze_measure_costs(const EngineProfile* profile, VoiceCosts* costs) {
+    memset(costs, 0, sizeof(*costs));
+    snprintf(costs->profile, sizeof(costs->profile), "%s", profile->name);
+
+    printf("Measuring voice costs with profile '%s' and %d voices per instrument...\n", profile->name, COST_VOICES);
+    costs->baseline = measure_load(profile, 0, 0);
+    if (costs->baseline < 0) {
+        fprintf(stderr, "Error: Failed to run a Csound instance for the cost measurement.\n");
+        return -1;
+    }
+    printf("  %-10s %12.6f s per second of audio\n", "baseline", costs->baseline);
+
+    for (int instr = 1; instr <= NUM_INSTRUMENTS; instr++) {
+        double load = measure_load(profile, instr, COST_VOICES);
+        if (load < 0) {
+            fprintf(stderr, "Error: Failed to run a Csound instance for the cost measurement.\n");
+            return -1;
+        }
+        double cost = (load - costs->baseline) / COST_VOICES;
+        costs->voice_cost[instr] = cost > 0 ? cost : 0.0;
+        printf("  instr %-4d %12.6f s per second of one voice\n", instr, costs->voice_cost[instr]);
+    }
+    return 0;
+}
+
+int voice_costs_save(const VoiceCosts* costs, const char* path) {
+    FILE* file = fopen(path, "w");
+    if (file == NULL) {
+        fprintf(stderr, "Error: Cannot create voice cost file '%s'.\n", path);
+        return -1;
+    }
+    fprintf(file, "# Voice costs: seconds of render time per second of audio.\n");
+    fprintf(file, "profile %s\n", costs->profile);
+    fprintf(file, "baseline %.9f\n", costs->baseline);
+    for (int instr = 1; instr <= NUM_INSTRUMENTS; instr++) {
+        fprintf(file, "voice %d %.9f\n", instr, costs->voice_cost[instr]);
+    }
+    if (fclose(file) != 0) {
+        fprintf(stderr, "Error: Failed to write voice cost file '%s'.\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+int voice_costs_load(const char* path, VoiceCosts* costs) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "Error: Cannot open voice cost file '%s'.\n", path);
+        return -1;
+    }
+    memset(costs, 0, sizeof(*costs));
+
+    char line[256];
+    int line_number = 0;
+    int result = 0;
+    while (result == 0 && fgets(line, sizeof(line), file) != NULL) {
+        line_number++;
+        int instr;
+        double value;
+        char name[32];
+        if (line[0] == '#' || line[strspn(line, " \t\r\n")] == '\0') {
+            continue;
+        }
+        if (sscanf(line, "profile %31s", name) == 1) {
+            snprintf(costs->profile, sizeof(costs->profile), "%s", name);
+        } else if (sscanf(line, "baseline %lf", &value) == 1) {
+            costs->baseline = value;
+        } else if (sscanf(line, "voice %d %lf", &instr, &value) == 2 && instr >= 1 && instr <= NUM_INSTRUMENTS) {
+            costs->voice_cost[instr] = value;
+        } else {
+            fprintf(stderr, "Error: %s:%d: Unrecognized line.\n", path, line_number);
+            result = -1;
+        }
+    }
+    fclose(file);
+    return result;
+}
@@ -0,0 +1,116 @@
+#ifndef ANALYZE_H
+#define ANALYZE_H
+
+#include <stdio.h>
+#include "engine.h"
+#include "instruments.h"
+#include "score.h"
+
+// --- Score Cost Analysis ---
+//
+// Predicts what a render will cost from the score alone, without starting
+// Csound. The piece is laid out with the player's own timing and every note
+// is counted as a voice from its start until its release has ended (a chord
+// is one voice per note). The analysis reports the note density over time,
+// how many voices each instrument sounds at once, and for how long.
+//
+// With voice costs measured on the target machine (analyze_measure_costs()),
+// it also estimates the render time and the peak CPU load:
+//
+//   cost of one second of audio = baseline + sum over instruments of (voice cost * sounding voices)
+//
+// The estimate ends with a single line for schedulers to parse:
+//
+//   estimate duration=<s> events=<n> notes=<n> peak_voices=<n> voice_seconds=<s> render_seconds=<s> peak_load=<cores>
+
+#define ANALYSIS_MAX_WINDOWS 32 // The density report uses at most this many windows (each at least one second).
+
+/**
+ * @brief The voice usage of one instrument.
+ */
+typedef struct {
+    int notes;            /**< The number of voices started. */
+    int peak_voices;      /**< The most voices sounding at once. */
+    double voice_seconds; /**< The total time voices sound, summed over voices. */
+    double* histogram;    /**< peak_voices + 1 entries: the seconds during which exactly k voices sound. */
+} InstrumentLoad;
+
+/**
+ * @brief CPU cost figures of the orchestra, measured on one machine with one profile.
+ */
+typedef struct {
+    char profile[32];                       /**< The name of the profile the costs were measured with. */
+    double baseline;                        /**< CPU seconds per second of audio with no voice sounding. */
+    double voice_cost[NUM_INSTRUMENTS + 1]; /**< Per instrument (from 1), CPU seconds per second of one sounding voice. */
+} VoiceCosts;
+
+/**
+ * @brief The predicted cost of a score.
+ */
+typedef struct {
+    double duration;             /**< The time in seconds until the last voice has been released. */
+    int events;                  /**< The score events played, repeats included (notes, chords and rests). */
+    int notes;                   /**< The voices started, with chords expanded. */
+    int peak_voices;             /**< The most voices sounding at once, over all instruments. */
+    double window_seconds;       /**< The length of one density window. */
+    int window_count;            /**< The number of density windows. */
+    int* window_notes;           /**< The number of voices started in every window. */
+    int instrument_count;        /**< The highest instrument number used; instruments has this many entries. */
+    InstrumentLoad* instruments; /**< The load of every instrument, indexed by instrument number - 1. */
+    int estimated;               /**< Non-zero if the fields below were computed from voice costs. */
+    double render_seconds;       /**< The estimated CPU time of the render. */
+    double peak_load;            /**< The highest cost of one second of audio, in CPU seconds (1.0 = one core in real time). */
+} ScoreAnalysis;
+
+/**
+ * @brief Analyzes the cost of playing a set of tracks.
+ * @param tracks The tracks to analyze.
+ * @param num_tracks The number of tracks.
+ * @param costs Measured voice costs for the estimate, or NULL to only count.
+ * @param analysis Receives the result. Release it with analysis_free().
+ * @return 0 on success, -1 if memory allocation fails.
+ */
+int analyze_score(Track* tracks, int num_tracks, const VoiceCosts* costs, ScoreAnalysis* analysis);
+
+/**
+ * @brief Releases the memory owned by an analysis.
+ * @param analysis The analysis to free.
+ */
+void analysis_free(ScoreAnalysis* analysis);
+
+/**
+ * @brief Prints an analysis as a human-readable report followed by the estimate line.
+ * @param analysis The analysis to print.
+ * @param out Where to print.
+ */
+void analysis_print(const ScoreAnalysis* analysis, FILE* out);
+
+/**
+ * @brief Measures the baseline and per-voice cost of every instrument.
+ *
+ * Each instrument is run offline with a fixed number of held voices, and
+ * the time taken beyond an empty instance is divided among the voices.
+ *
+ * @param profile The profile to measure with (its sr, ksmps and threads matter).
+ * @param costs Receives the figures.
+ * @return 0 on success, -1 if an instance could not be run.
+ */
+int analyze_measure_costs(const EngineProfile* profile, VoiceCosts* costs);
+
+/**
+ * @brief Writes voice costs to a text file.
+ * @param costs The costs to write.
+ * @param path The file to create.
+ * @return 0 on success, -1 on failure (an error is printed).
+ */
+int voice_costs_save(const VoiceCosts* costs, const char* path);
+
+/**
+ * @brief Reads voice costs written by voice_costs_save().
+ * @param path The file to read.
+ * @param costs Receives the figures.
+ * @return 0 on success, -1 on failure (an error is printed).
+ */
+int voice_costs_load(const char* path, VoiceCosts* costs);
+
+#endif // ANALYZE_H
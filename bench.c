@@ -0,0 +1,324 @@
+#include <csound.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "engine.h"
+#include "event_table.h"
+#include "instrument_piano.h"
+#include "instruments.h"
+#include "player.h"
+#include "render.h"
+#include "score.h"
+
+// --- Synthetic Score ---
+// A dense piece spread evenly over every instrument: every fourth track plays
+// chords in half notes, the others play eighth-note lines in different
+// registers, so there are always many instrument instances to share out.
+
+#define BENCH_TRACKS 32         // Tracks in the synthetic score.
+#define BENCH_MEASURES 16       // Measures per track.
+#define BENCH_BPM 120.0         // Tempo of the synthetic score.
+#define BENCH_MELODY_EVENTS 8   // Eighth notes per 4/4 measure.
+#define BENCH_CHORD_EVENTS 2    // Half notes per 4/4 measure.
+#define BENCH_CHORD_INTERVAL 4  // Every this many tracks, one is a chord track.
+
+static MusicEvent bench_events[BENCH_TRACKS][BENCH_MEASURES][BENCH_MELODY_EVENTS];
+static Measure bench_measures[BENCH_TRACKS][BENCH_MEASURES];
+static char bench_names[BENCH_TRACKS][32];
+
+/**
+ * @brief Fills tracks with the synthetic score.
+ * @param tracks An array of BENCH_TRACKS tracks.
+ */
+static void build_synthetic_score(Track* tracks) {
+    for (int t = 0; t < BENCH_TRACKS; t++) {
+        int chords = t % BENCH_CHORD_INTERVAL == BENCH_CHORD_INTERVAL - 1;
+        int instrument = t % NUM_INSTRUMENTS + 1;
+        for (int m = 0; m < BENCH_MEASURES; m++) {
+            MusicEvent* events = bench_events[t][m];
+            int count = chords ? BENCH_CHORD_EVENTS : BENCH_MELODY_EVENTS;
+            for (int e = 0; e < count; e++) {
+                if (chords) {
+                    events[e].value = (t + m * 3 + e) % (CHORD_Bm7b5 + 1);
+                    events[e].duration = HALF_NOTE;
+                } else {
+                    // Walk a two-octave range starting at a register that depends on the track.
+                    events[e].value = C3 + (t * 5) % 24 + (m * 7 + e * 2) % 24;
+                    events[e].duration = EIGHTH_NOTE;
+                }
+            }
+            bench_measures[t][m] = (Measure){events, count, 4, 4, m == 0 ? BENCH_BPM : 0};
+        }
+        snprintf(bench_names[t], sizeof(bench_names[t]), "Synthetic %d", t + 1);
+        tracks[t] = (Track){bench_names[t], chords ? TRACK_CHORD : TRACK_MELODY, instrument,
+            bench_measures[t], BENCH_MEASURES, NULL, 0, NULL};
+    }
+}
+
+// --- Thread Scaling ---
+
+static int count_frames(void* user, const MYFLT* samples, int frames, int nchnls) {
+    (void)samples;
+    (void)nchnls;
+    *(long*)user += frames;
+    return 0;
+}
+
+/**
+ * @brief Renders the tracks once with the given number of threads, discarding the audio.
+ * @param seconds Receives the length of the rendered audio.
+ * @return The wall-clock time of the render, or a negative value on failure.
+ */
+static double time_render(const EngineProfile* profile, int threads, Track* tracks, int num_tracks, double* seconds) {
+    EngineProfile candidate = *profile;
+    candidate.threads = threads;
+    CSOUND* csound = engine_create_offline(&candidate);
+    if (csound == NULL) {
+        return -1.0;
+    }
+    csoundSetOption(csound, "-m0");
+    if (csoundStart(csound) != 0) {
+        engine_destroy(csound);
+        return -1.0;
+    }
+
+    long frames = 0;
+    double start = engine_now_seconds();
+    int result = render_tracks(csound, tracks, num_tracks, 0.0, count_frames, &frames);
+    double elapsed = engine_now_seconds() - start;
+    engine_destroy(csound);
+
+    *seconds = (double)frames / candidate.sr;
+    return result == 0 ? elapsed : -1.0;
+}
+
+/**
+ * @brief Renders the synthetic score with 1, 2, 4, ... threads up to max_threads and reports the speed of each.
+ * @return 0 on success, -1 if a render failed.
+ */
+static int bench_threads(const EngineProfile* profile, int max_threads) {
+    Track tracks[BENCH_TRACKS];
+    build_synthetic_score(tracks);
+
+    printf("Rendering %d synthetic tracks with profile '%s' (sr=%d, ksmps=%d)...\n",
+        BENCH_TRACKS, profile->name, profile->sr, profile->ksmps);
+    printf("  %7s %10s %10s %8s %10s\n", "threads", "wall (s)", "realtime", "speedup", "efficiency");
+
+    double single = 0.0;
+    double best = 0.0;
+    int best_threads = 1;
+    for (int threads = 1;; threads = threads * 2 < max_threads ? threads * 2 : max_threads) {
+        double seconds = 0.0;
+        double elapsed = time_render(profile, threads, tracks, BENCH_TRACKS, &seconds);
+        if (elapsed <= 0) {
+            printf("  %7d  (failed to render)\n", threads);
+            return -1;
+        }
+        if (threads == 1) {
+            single = elapsed;
+        }
+        double speedup = single / elapsed;
+        printf("  %7d %10.3f %9.1fx %7.2fx %9.0f%%\n",
+            threads, elapsed, seconds / elapsed, speedup, speedup / threads * 100.0);
+
+        if (speedup > best) {
+            best = speedup;
+            best_threads = threads;
+        }
+        if (threads == max_threads) {
+            break;
+        }
+    }
+    printf("Fastest: %d threads (%.2fx the single-threaded speed).\n", best_threads, best);
+    return 0;
+}
+
+// --- Scheduling Cost ---
+// A generative workload: every track holds a few notes of num_tracks / 2
+// ticks, and the tracks are staggered by half a tick each, so the piece
+// starts about two notes per tick however many tracks it has. The player is
+// stepped block by block without Csound, so the time measured is the
+// scheduling alone. With the player's event queue the cost of a block
+// depends on the notes due in it, not on the number of tracks.
+
+#define HEAP_MIN_TRACKS 10       // The smallest piece measured.
+#define HEAP_MAX_TRACKS 100000   // The largest piece measured (its notes are just under the longest event).
+#define HEAP_TRACK_NOTES 8       // Notes per track.
+#define HEAP_BPM 120.0           // Tempo of the workload.
+#define HEAP_MAX_SECONDS 600.0   // Playing time simulated at most per piece (the rest repeats the same load).
+#define HEAP_MIN_WALL 0.25       // Each piece is replayed until it has been timed for at least this long.
+
+/**
+ * @brief The tracks of a generated workload and the storage they point to.
+ */
+typedef struct {
+    Track* tracks;
+    Measure* measures;
+    MusicEvent* events;
+    int num_tracks;
+} Workload;
+
+static void free_workload(Workload* workload) {
+    free(workload->tracks);
+    free(workload->measures);
+    free(workload->events);
+}
+
+/**
+ * @brief Generates a workload of num_tracks staggered tracks.
+ * @return 0 on success, -1 if memory allocation fails.
+ */
+static int build_workload(Workload* workload, int num_tracks) {
+    int per_track = HEAP_TRACK_NOTES + 1; // A leading rest, then the notes.
+    double note_ticks = num_tracks / 2;
+    workload->num_tracks = num_tracks;
+    workload->tracks = (Track*)malloc(num_tracks * sizeof(Track));
+    workload->measures = (Measure*)malloc(num_tracks * sizeof(Measure));
+    workload->events = (MusicEvent*)malloc((size_t)num_tracks * per_track * sizeof(MusicEvent));
+    if (workload->tracks == NULL || workload->measures == NULL || workload->events == NULL) {
+        free_workload(workload);
+        return -1;
+    }
+    for (int t = 0; t < num_tracks; t++) {
+        MusicEvent* events = &workload->events[(size_t)t * per_track];
+        int count = 0;
+        if (t / 2 > 0) {
+            events[count++] = (MusicEvent){REST, (double)(t / 2) / TICKS_PER_QUARTER};
+        }
+        for (int e = 0; e < HEAP_TRACK_NOTES; e++) {
+            events[count++] = (MusicEvent){C3 + (t * 5 + e * 2) % 24, note_ticks / TICKS_PER_QUARTER};
+        }
+        workload->measures[t] = (Measure){events, count, 4, 4, HEAP_BPM};
+        workload->tracks[t] = (Track){"Generated", TRACK_MELODY, t % NUM_INSTRUMENTS + 1,
+            &workload->measures[t], 1, NULL, 0, NULL};
+    }
+    return 0;
+}
+
+static void count_note(void* user, const PlayerNote* note) {
+    (void)note;
+    (*(long*)user)++;
+}
+
+/**
+ * @brief Steps a player over a workload one control block at a time.
+ * @param blocks Receives the number of blocks stepped.
+ * @param notes Receives the number of notes played.
+ * @return The wall-clock time spent in player_update(), or a negative value on failure.
+ */
+static double time_schedule(const EngineProfile* profile, Workload* workload, long* blocks, long* notes) {
+    Player player;
+    if (player_init(&player, workload->tracks, workload->num_tracks, 0.0, NULL) != 0) {
+        return -1.0;
+    }
+    player.on_note = count_note;
+    player.note_user = notes;
+
+    // Every track starts with an event at time 0; that first block is not timed.
+    player_update(&player, NULL, 0.0);
+
+    double block = (double)profile->ksmps / profile->sr;
+    long count = 0;
+    double start = engine_now_seconds();
+    while (!player_finished(&player, count * block) && count * block < HEAP_MAX_SECONDS) {
+        count++;
+        player_update(&player, NULL, count * block);
+    }
+    double elapsed = engine_now_seconds() - start;
+    player_free(&player);
+    *blocks += count;
+    return elapsed;
+}
+
+/**
+ * @brief Measures the scheduling cost per control block for 10 to 100000 tracks.
+ * @return 0 on success, -1 on failure.
+ */
+static int bench_heap(const EngineProfile* profile) {
+    printf("Scheduling generated pieces of staggered tracks with ksmps=%d at sr=%d...\n", profile->ksmps, profile->sr);
+    printf("  %7s %10s %10s %12s %12s\n", "tracks", "blocks", "notes", "ns/block", "ns/note");
+
+    for (int num_tracks = HEAP_MIN_TRACKS; num_tracks <= HEAP_MAX_TRACKS; num_tracks *= 10) {
+        Workload workload;
+        if (build_workload(&workload, num_tracks) != 0) {
+            fprintf(stderr, "Error: Failed to allocate memory for %d tracks.\n", num_tracks);
+            return -1;
+        }
+        long blocks = 0;
+        long notes = 0;
+        double elapsed = 0.0;
+        while (elapsed < HEAP_MIN_WALL) {
+            double run = time_schedule(profile, &workload, &blocks, &notes);
+            if (run < 0) {
+                fprintf(stderr, "Error: Failed to prepare a player for %d tracks.\n", num_tracks);
+                free_workload(&workload);
+                return -1;
+            }
+            elapsed += run;
+        }
+        free_workload(&workload);
+        printf("  %7d %10ld %10ld %12.1f %12.1f\n",
+            num_tracks, blocks, notes, elapsed / blocks * 1e9, notes > 0 ? elapsed / notes * 1e9 : 0.0);
+    }
+    return 0;
+}
+
+// --- Main Program ---
+
+static void print_usage(const char* program) {
+    printf("Usage: %s <benchmark> [options]\n", program);
+    printf("Benchmarks:\n");
+    printf("  threads            Render speed of a synthetic %d-track score against Csound's thread count\n", BENCH_TRACKS);
+    printf("  heap               Scheduling cost per block of generated pieces with %d to %d tracks\n", HEAP_MIN_TRACKS, HEAP_MAX_TRACKS);
+    printf("Options:\n");
+    printf("  --profile NAME     Engine profile to benchmark (default: offline)\n");
+    printf("  --max-threads N    Highest thread count to try (default: CPU count)\n");
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2 || strcmp(argv[1], "--help") == 0) {
+        print_usage(argv[0]);
+        return argc < 2 ? 1 : 0;
+    }
+
+    const EngineProfile* profile = engine_find_profile("offline");
+    int max_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+            profile = engine_find_profile(argv[++i]);
+            if (profile == NULL) {
+                fprintf(stderr, "Error: Unknown profile '%s'.\n", argv[i]);
+                engine_list_profiles();
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--max-threads") == 0 && i + 1 < argc) {
+            max_threads = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "Error: Unknown or incomplete option '%s'.\n", argv[i]);
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+    if (max_threads < 1) {
+        max_threads = 1;
+    }
+
+    generate_piano_frequencies();
+    if (generate_chord_pool() != 0) {
+        fprintf(stderr, "Error: Failed to build the chord pool.\n");
+        return 1;
+    }
+    atexit(free_chord_pool);
+
+    if (strcmp(argv[1], "threads") == 0) {
+        return bench_threads(profile, max_threads) == 0 ? 0 : 1;
+    }
+    if (strcmp(argv[1], "heap") == 0) {
+        return bench_heap(profile) == 0 ? 0 : 1;
+    }
+    fprintf(stderr, "Error: Unknown benchmark '%s'.\n", argv[1]);
+    print_usage(argv[0]);
+    return 1;
+}
@@ -0,0 +1,199 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "engine.h"
+#include "instruments.h"
+
+// --- Built-in Profiles ---
+// "balanced" matches the settings the player has always used.
+static const EngineProfile profiles[] = {
+    {"live",     "Low-latency live playback",      48000, 16,  2, 64,   256,   1},
+    {"balanced", "Balanced latency and CPU cost",  44100, 32,  2, 256,  1024,  1},
+    {"offline",  "Maximum throughput for renders", 44100, 256, 2, 4096, 16384, 1},
+};
+static const int NUM_PROFILES = sizeof(profiles) / sizeof(EngineProfile);
+
+// --- Calibration Settings ---
+#define CALIBRATION_VOICES 16       // Voices started per instrument during calibration.
+#define CALIBRATION_SECONDS 0.5     // Amount of audio rendered per candidate ksmps.
+#define CALIBRATION_WARMUP_BLOCKS 8 // Blocks performed before timing starts.
+#define CALIBRATION_HEADROOM 0.5    // A block may use at most this fraction of its period.
+
+static const int calibration_ksmps[] = {8, 16, 32, 64, 128, 256};
+static const int NUM_CALIBRATION_KSMPS = sizeof(calibration_ksmps) / sizeof(int);
+
+const EngineProfile* engine_find_profile(const char* name) {
+    for (int i = 0; i < NUM_PROFILES; i++) {
+        if (strcmp(profiles[i].name, name) == 0) {
+            return &profiles[i];
+        }
+    }
+    return NULL;
+}
+
+void engine_list_profiles(void) {
+    printf("Available profiles:\n");
+    for (int i = 0; i < NUM_PROFILES; i++) {
+        const EngineProfile* p = &profiles[i];
+        printf("  %-9s sr=%d ksmps=%d -b %d -B %d  (%s)\n",
+            p->name, p->sr, p->ksmps, p->software_buffer, p->hardware_buffer, p->description);
+    }
+}
+
+// The host data of instances created by engine_create_offline(), so they can be recognized.
+static int host_output_marker;
+
+/**
+ * @brief Creates and configures an instance, optionally tagged with host data.
+ */
+static CSOUND* create_instance(const EngineProfile* profile, const char* output_option, void* host_data) {
+    CSOUND* csound = csoundCreate(host_data);
+    if (csound == NULL) {
+        fprintf(stderr, "Error: Failed to create Csound instance.\n");
+        return NULL;
+    }
+
+    char option[64];
+    csoundSetOption(csound, output_option);
+    snprintf(option, sizeof(option), "-b%d", profile->software_buffer);
+    csoundSetOption(csound, option);
+    snprintf(option, sizeof(option), "-B%d", profile->hardware_buffer);
+    csoundSetOption(csound, option);
+    if (profile->threads > 1) {
+        // Instrument instances of one control block are then spread over a pool of threads.
+        snprintf(option, sizeof(option), "-j%d", profile->threads);
+        csoundSetOption(csound, option);
+    }
+
+    char* orc = get_orchestra_string(profile->sr, profile->ksmps, profile->nchnls);
+    if (orc == NULL) {
+        fprintf(stderr, "Error: Failed to allocate memory for orchestra string.\n");
+        csoundDestroy(csound);
+        return NULL;
+    }
+
+    if (csoundCompileOrc(csound, orc) != 0) {
+        fprintf(stderr, "Error: Orchestra compilation failed.\n");
+        free(orc);
+        csoundDestroy(csound);
+        return NULL;
+    }
+    free(orc);
+
+    return csound;
+}
+
+CSOUND* engine_create(const EngineProfile* profile, const char* output_option) {
+    return create_instance(profile, output_option, NULL);
+}
+
+CSOUND* engine_create_offline(const EngineProfile* profile) {
+    CSOUND* csound = create_instance(profile, "-odac", &host_output_marker);
+    if (csound != NULL) {
+        // The "dac" is then the output buffer itself: no device is opened.
+        csoundSetHostImplementedAudioIO(csound, 1, 0);
+    }
+    return csound;
+}
+
+int engine_has_host_output(CSOUND* csound) {
+    return csoundGetHostData(csound) == &host_output_marker;
+}
+
+void engine_destroy(CSOUND* csound) {
+    if (csound != NULL) {
+        csoundStop(csound);
+        csoundDestroy(csound);
+    }
+}
+
+double engine_now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief Measures the average wall-clock cost of one block for a single ksmps value.
+ * @return The cost in seconds, or a negative value if the instance could not run.
+ */
+static double measure_block_cost(const EngineProfile* profile, int ksmps) {
+    EngineProfile candidate = *profile;
+    candidate.ksmps = ksmps;
+    if (candidate.software_buffer < ksmps) {
+        candidate.software_buffer = ksmps;
+    }
+    if (candidate.hardware_buffer < candidate.software_buffer) {
+        candidate.hardware_buffer = candidate.software_buffer;
+    }
+
+    CSOUND* csound = engine_create(&candidate, "-n");
+    if (csound == NULL) {
+        return -1.0;
+    }
+    csoundSetOption(csound, "-m0");
+    if (csoundStart(csound) != 0) {
+        engine_destroy(csound);
+        return -1.0;
+    }
+
+    // Hold a fixed number of voices on every instrument for the whole measurement.
+    char score_event[128];
+    for (int instr = 1; instr <= NUM_INSTRUMENTS; instr++) {
+        for (int v = 0; v < CALIBRATION_VOICES; v++) {
+            double freq = 110.0 * (1.0 + v * 0.25);
+            sprintf(score_event, "i%d %f %f %f %f", instr, 0.0, 3600.0, freq, 0.01);
+            csoundInputMessage(csound, score_event);
+        }
+    }
+
+    for (int b = 0; b < CALIBRATION_WARMUP_BLOCKS; b++) {
+        csoundPerformKsmps(csound);
+    }
+
+    int blocks = (int)(CALIBRATION_SECONDS * candidate.sr / ksmps);
+    double start = engine_now_seconds();
+    for (int b = 0; b < blocks; b++) {
+        if (csoundPerformKsmps(csound) != 0) {
+            break;
+        }
+    }
+    double elapsed = engine_now_seconds() - start;
+
+    engine_destroy(csound);
+    return elapsed / blocks;
+}
+
+int engine_calibrate(const EngineProfile* profile) {
+    printf("Calibrating at sr=%d with %d voices per instrument...\n", profile->sr, CALIBRATION_VOICES);
+    printf("  %6s %12s %12s %7s\n", "ksmps", "period (us)", "cost (us)", "load");
+
+    int recommended = -1;
+    for (int i = 0; i < NUM_CALIBRATION_KSMPS; i++) {
+        int ksmps = calibration_ksmps[i];
+        double cost = measure_block_cost(profile, ksmps);
+        if (cost < 0) {
+            printf("  %6d  (failed to run)\n", ksmps);
+            continue;
+        }
+
+        double period = (double)ksmps / profile->sr;
+        double load = cost / period;
+        printf("  %6d %12.1f %12.1f %6.1f%%\n", ksmps, period * 1e6, cost * 1e6, load * 100.0);
+
+        if (recommended < 0 && load <= CALIBRATION_HEADROOM) {
+            recommended = ksmps;
+        }
+    }
+
+    if (recommended < 0) {
+        printf("No candidate stayed under %.0f%% load; use the largest ksmps or fewer voices.\n",
+            CALIBRATION_HEADROOM * 100.0);
+    } else {
+        printf("Recommended: ksmps = %d (smallest block using at most %.0f%% of its period).\n",
+            recommended, CALIBRATION_HEADROOM * 100.0);
+    }
+    return recommended;
+}
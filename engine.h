@@ -0,0 +1,96 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <csound.h>
+
+// --- Engine Profiles ---
+
+/**
+ * @brief A named set of engine settings tuned for a particular use case.
+ *
+ * A profile decides the trade-off between latency and throughput: a small
+ * ksmps and small buffers react quickly but pay the host round-trip more
+ * often, while a large ksmps and large buffers amortize that cost.
+ */
+typedef struct {
+    const char* name;        /**< The name used to select the profile on the command line. */
+    const char* description; /**< A short human-readable summary of the profile. */
+    int sr;                  /**< The audio sample rate in Hz. */
+    int ksmps;               /**< The number of samples in one control block. */
+    int nchnls;              /**< The number of output channels. */
+    int software_buffer;     /**< The software buffer size in sample frames (Csound's -b). */
+    int hardware_buffer;     /**< The hardware buffer size in sample frames (Csound's -B). */
+    int threads;             /**< The number of threads Csound performs with (Csound's -j). 1 is single-threaded. */
+} EngineProfile;
+
+#define DEFAULT_PROFILE_NAME "balanced"
+
+/**
+ * @brief Looks up a built-in profile by name.
+ * @param name The profile name (e.g., "live", "balanced", "offline").
+ * @return A pointer to the profile, or NULL if no profile has that name.
+ */
+const EngineProfile* engine_find_profile(const char* name);
+
+/**
+ * @brief Prints the built-in profiles and their settings to stdout.
+ */
+void engine_list_profiles(void);
+
+/**
+ * @brief Creates a Csound instance configured by a profile and compiles the orchestra.
+ *
+ * @param profile The profile providing sr, ksmps, nchnls, buffer sizes and the thread count.
+ * @param output_option A Csound output option such as "-odac", "-n" or "-oout.wav".
+ * @return A ready-to-start Csound instance, or NULL on failure (an error is printed).
+ *         The caller releases it with engine_destroy().
+ */
+CSOUND* engine_create(const EngineProfile* profile, const char* output_option);
+
+/**
+ * @brief Creates a Csound instance for offline rendering whose output buffer is read by the host.
+ *
+ * No audio device or file is opened. Besides csoundPerformKsmps(), the
+ * instance can be run with csoundPerformBuffer(), which performs a whole
+ * software buffer of control blocks in one call and leaves the audio in
+ * csoundGetOutputBuffer(). render_tracks() uses this to skip the host
+ * round-trip for blocks in which no note starts.
+ *
+ * @param profile The profile providing sr, ksmps, nchnls, buffer sizes and the thread count.
+ * @return A ready-to-start Csound instance, or NULL on failure (an error is printed).
+ *         The caller releases it with engine_destroy().
+ */
+CSOUND* engine_create_offline(const EngineProfile* profile);
+
+/**
+ * @brief Checks whether an instance was created by engine_create_offline().
+ * @param csound The instance to check.
+ * @return Non-zero if the host reads the instance's output buffer.
+ */
+int engine_has_host_output(CSOUND* csound);
+
+/**
+ * @brief Stops and destroys a Csound instance created by engine_create() or engine_create_offline().
+ * @param csound The instance to destroy. NULL is ignored.
+ */
+void engine_destroy(CSOUND* csound);
+
+/**
+ * @brief Measures the cost of one control block for a range of ksmps values.
+ *
+ * Each candidate ksmps is run with a fixed synthetic voice load and without
+ * audio output. The smallest ksmps whose block cost stays well below the
+ * block period is reported as the recommended setting for this machine.
+ *
+ * @param profile The profile whose sample rate and channel count are used.
+ * @return The recommended ksmps, or -1 if no candidate stayed within the headroom.
+ */
+int engine_calibrate(const EngineProfile* profile);
+
+/**
+ * @brief Returns a monotonic clock reading, for timing renders and benchmarks.
+ * @return The time in seconds since an arbitrary fixed point.
+ */
+double engine_now_seconds(void);
+
+#endif // ENGINE_H
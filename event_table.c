@@ -0,0 +1,81 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "event_table.h"
+
+#define ARENA_ALIGNMENT 16 // Every block taken from the arena is rounded up to this size.
+
+static size_t align_size(size_t size) {
+    return (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+}
+
+int event_table_build(EventTable* table, const Track* track) {
+    if (track->table != NULL) {
+        *table = *track->table;
+        return 0;
+    }
+    memset(table, 0, sizeof(*table));
+
+    int event_count = 0;
+    for (int m = 0; m < track->measure_count; m++) {
+        event_count += track->measures[m].event_count;
+    }
+
+    size_t pitch_size = align_size((size_t)event_count * sizeof(int16_t));
+    size_t duration_size = align_size((size_t)event_count * sizeof(uint16_t));
+    size_t start_size = align_size((size_t)(event_count + 1) * sizeof(uint32_t));
+    size_t first_size = align_size((size_t)(track->measure_count + 1) * sizeof(int));
+
+    table->arena = arena_create(pitch_size + duration_size + start_size + first_size);
+    if (table->arena == NULL) {
+        fprintf(stderr, "Error: Failed to allocate memory for the events of track '%s'.\n", track->name);
+        return -1;
+    }
+    int16_t* pitch = (int16_t*)arena_alloc(table->arena, pitch_size);
+    uint16_t* duration = (uint16_t*)arena_alloc(table->arena, duration_size);
+    uint32_t* start = (uint32_t*)arena_alloc(table->arena, start_size);
+    int* measure_first = (int*)arena_alloc(table->arena, first_size);
+    table->pitch = pitch;
+    table->duration = duration;
+    table->start = start;
+    table->measure_first = measure_first;
+    table->event_count = event_count;
+    table->measure_count = track->measure_count;
+
+    int e = 0;
+    uint32_t tick = 0;
+    for (int m = 0; m < track->measure_count; m++) {
+        const Measure* measure = &track->measures[m];
+        measure_first[m] = e;
+        for (int i = 0; i < measure->event_count; i++, e++) {
+            double exact = measure->events[i].duration * TICKS_PER_QUARTER;
+            double ticks = floor(exact + 0.5);
+            if (ticks > MAX_EVENT_TICKS) {
+                fprintf(stderr, "Error: Track '%s', Measure %d: An event of %.2f quarter notes is longer than the maximum of %.2f.\n",
+                    track->name, m + 1, measure->events[i].duration, (double)MAX_EVENT_TICKS / TICKS_PER_QUARTER);
+                event_table_free(table);
+                return -1;
+            }
+            if (fabs(exact - ticks) > 1e-6) {
+                table->inexact_events++;
+            }
+            pitch[e] = (int16_t)measure->events[i].value;
+            duration[e] = (uint16_t)ticks;
+            start[e] = tick;
+            tick += (uint32_t)ticks;
+        }
+    }
+    measure_first[track->measure_count] = e;
+    start[e] = tick;
+    return 0;
+}
+
+void event_table_free(EventTable* table) {
+    arena_destroy(table->arena);
+    memset(table, 0, sizeof(*table));
+}
+
+uint32_t event_table_measure_ticks(const EventTable* table, int measure) {
+    return table->start[table->measure_first[measure + 1]] - table->start[table->measure_first[measure]];
+}
@@ -0,0 +1,63 @@
+#ifndef EVENT_TABLE_H
+#define EVENT_TABLE_H
+
+#include <stdint.h>
+#include "arena.h"
+#include "score.h"
+
+// --- Event Tables ---
+// The compact, column-oriented form of a track's events used at playback
+// time. Scores are written as Measure/MusicEvent arrays; an EventTable holds
+// the same events as separate pitch, duration and start columns in integer
+// ticks (8 bytes per event instead of 16), with every event's start time
+// precomputed as a prefix sum so scans and range queries never re-accumulate
+// durations.
+
+#define TICKS_PER_QUARTER 480 // Resolution of the tick columns: exact for dyadic notes down to 1/128 and for triplets.
+#define MAX_EVENT_TICKS UINT16_MAX // The longest event a table can hold (about 136 quarter notes).
+
+/**
+ * @brief The events of one track's distinct measures, stored column by column.
+ *
+ * Measure m of the track owns events [measure_first[m], measure_first[m + 1]).
+ * Start times are counted from the first event of the first measure, in the
+ * order the measures are stored (not the order a form plays them in).
+ */
+typedef struct EventTable {
+    Arena* arena;              /**< The arena that owns every column, or NULL for a precomputed table. */
+    int event_count;           /**< The number of events. */
+    int measure_count;         /**< The number of measures. */
+    const int16_t* pitch;      /**< The value of every event: a PianoKey, a chord index or REST. */
+    const uint16_t* duration;  /**< The duration of every event in ticks. */
+    const uint32_t* start;     /**< event_count + 1 prefix sums: the start of every event in ticks, then the total. */
+    const int* measure_first;  /**< measure_count + 1 offsets of the first event of every measure. */
+    int inexact_events;        /**< The number of durations that were not a whole number of ticks and were rounded. */
+} EventTable;
+
+/**
+ * @brief Builds the event table of a track.
+ *
+ * A track with a precomputed table (Track.table, written by the score
+ * compiler) is not converted again: the table refers to its columns.
+ *
+ * @param table The table to fill.
+ * @param track The track whose measures are converted.
+ * @return 0 on success, -1 if memory allocation fails or an event is too long (an error is printed to stderr).
+ */
+int event_table_build(EventTable* table, const Track* track);
+
+/**
+ * @brief Releases an event table. Safe to call on a zeroed table.
+ * @param table The table to free.
+ */
+void event_table_free(EventTable* table);
+
+/**
+ * @brief Returns the length of a measure in ticks.
+ * @param table The table.
+ * @param measure The index of the measure.
+ * @return The sum of the measure's event durations in ticks.
+ */
+uint32_t event_table_measure_ticks(const EventTable* table, int measure);
+
+#endif // EVENT_TABLE_H
@@ -0,0 +1,583 @@
+#include <limits.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "engine.h"
+#include "farm.h"
+#include "job_line.h"
+#include "meter.h"
+#include "pcm.h"
+#include "player.h"
+#include "render.h"
+#include "score_file.h"
+#include "wav.h"
+
+#define FARM_LINE_MAX (2 * PATH_MAX + 16) // Longest accepted manifest line.
+#define FARM_TAIL_SECONDS 3.0              // Room in a slot after the last note for release tails and block rounding.
+#define FARM_POLL_MS 100                   // How long the parent waits for a result before checking for exited workers.
+#define FARM_EXIT_NO_ENGINE 3              // Exit code of a worker whose Csound instance could not start.
+#define FARM_METER_FRAMES 1024             // Frames of a slot converted for the meter at a time.
+
+// --- Farm Structures ---
+
+typedef enum {
+    JOB_PENDING,
+    JOB_DONE,
+    JOB_FAILED
+} JobStatus;
+
+/**
+ * @brief One line of the manifest.
+ */
+typedef struct {
+    char score_path[PATH_MAX];
+    char output_path[PATH_MAX];
+    double length;    /**< The length of the piece in seconds, measured by the parent. */
+    double cost;      /**< The estimated synthesis work: the summed duration of every note. */
+    JobStatus status;
+} FarmJob;
+
+/**
+ * @brief How a worker's render ended.
+ */
+typedef enum {
+    FARM_OK,
+    FARM_LOAD_FAILED,
+    FARM_RENDER_FAILED,
+    FARM_SLOT_FULL
+} FarmResult;
+
+static const char* result_reasons[] = {"", "cannot load score", "render failed", "output larger than its slot"};
+
+/**
+ * @brief Sent by a worker through the result pipe when a job ends.
+ *
+ * It is smaller than PIPE_BUF, so messages from different workers never interleave.
+ */
+typedef struct {
+    int worker;
+    int job;
+    FarmResult result;
+    long frames;      /**< Sample frames left in the worker's slot. */
+    double seconds;   /**< The wall-clock render time. */
+} FarmMessage;
+
+/**
+ * @brief The job queue, in memory shared by the parent and every worker.
+ */
+typedef struct {
+    atomic_int next;  /**< The position in order of the next unclaimed job. */
+    int job_count;    /**< The number of entries in order. */
+    int order[];      /**< Job indices, most expensive first. */
+} FarmQueue;
+
+/**
+ * @brief A worker process as seen by the parent.
+ */
+typedef struct {
+    pid_t pid;        /**< The process, or 0 if the worker is not running. */
+    int ack[2];       /**< The parent writes one byte here once it has emptied the slot. */
+    int16_t* slot;    /**< Shared memory the worker renders each job into. */
+} FarmWorker;
+
+typedef struct {
+    const EngineProfile* profile;
+    FarmJob* jobs;
+    int job_count;
+    FarmQueue* queue;
+    atomic_int* current;   /**< Per worker, the job it is rendering, or -1. Shared. */
+    FarmWorker* workers;
+    int worker_count;
+    long slot_samples;     /**< The capacity of every slot in samples. */
+    int results[2];        /**< The pipe every worker reports finished jobs on. */
+    int succeeded;
+    int malformed;         /**< Manifest lines that are not jobs; each counts as a failed job. */
+} Farm;
+
+static void* shared_alloc(size_t size) {
+    void* memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    return memory == MAP_FAILED ? NULL : memory;
+}
+
+// --- Manifest ---
+
+/**
+ * @brief Reads every job line of a manifest.
+ * @param malformed Receives the number of lines that are neither jobs, comments nor blank.
+ * @return The number of jobs, or -1 if the manifest cannot be read.
+ */
+static int load_manifest(const char* path, FarmJob** jobs, int* malformed) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "Error: Cannot open manifest '%s'.\n", path);
+        return -1;
+    }
+
+    int count = 0;
+    int capacity = 0;
+    *jobs = NULL;
+    *malformed = 0;
+    char line[FARM_LINE_MAX];
+    int status;
+    for (int number = 1; (status = job_line_read(file, line, sizeof(line))) != 0; number++) {
+        char* field[JOB_LINE_FIELDS];
+        if (status < 0) {
+            fprintf(stderr, "Error: Manifest '%s', line %d: line too long.\n", path, number);
+            (*malformed)++;
+            continue;
+        }
+        int fields = job_line_split(line, field);
+        if (fields == 0 || (fields > 0 && field[0][0] == '#')) {
+            continue;
+        }
+        if (fields < 0) {
+            fprintf(stderr, "Error: Manifest '%s', line %d: path too long.\n", path, number);
+            (*malformed)++;
+            continue;
+        }
+        if (fields != JOB_LINE_FIELDS) {
+            fprintf(stderr, "Error: Manifest '%s', line %d: expected <score_path> <output_path>.\n", path, number);
+            (*malformed)++;
+            continue;
+        }
+        if (count == capacity) {
+            capacity = capacity == 0 ? 64 : capacity * 2;
+            FarmJob* grown = (FarmJob*)realloc(*jobs, capacity * sizeof(FarmJob));
+            if (grown == NULL) {
+                fprintf(stderr, "Error: Failed to allocate memory for the manifest.\n");
+                free(*jobs);
+                fclose(file);
+                return -1;
+            }
+            *jobs = grown;
+        }
+        FarmJob* job = &(*jobs)[count++];
+        memset(job, 0, sizeof(*job));
+        snprintf(job->score_path, sizeof(job->score_path), "%s", field[0]);
+        snprintf(job->output_path, sizeof(job->output_path), "%s", field[1]);
+    }
+    fclose(file);
+    return count;
+}
+
+static void add_note_cost(void* user, const PlayerNote* note) {
+    *(double*)user += note->duration;
+}
+
+/**
+ * @brief Lays a job's score out without rendering it to learn its length and cost.
+ * @return 0 on success, -1 if the score cannot be loaded.
+ */
+static int estimate_job(FarmJob* job) {
+    ScoreFile score;
+    if (score_file_load(job->score_path, &score) != 0) {
+        return -1;
+    }
+    validate_score(score.tracks, score.track_count, NULL);
+
+    Player player;
+    if (player_init(&player, score.tracks, score.track_count, 0.0, NULL) != 0) {
+        score_file_free(&score);
+        return -1;
+    }
+    player.on_note = add_note_cost;
+    player.note_user = &job->cost;
+    while (player.running) {
+        player_update(&player, NULL, player_next_time(&player));
+    }
+    job->length = player.max_end_time;
+    player_free(&player);
+    score_file_free(&score);
+    return 0;
+}
+
+typedef struct {
+    double cost;
+    int job;
+} JobCost;
+
+static int compare_costs(const void* a, const void* b) {
+    const JobCost* x = (const JobCost*)a;
+    const JobCost* y = (const JobCost*)b;
+    if (x->cost != y->cost) return x->cost > y->cost ? -1 : 1;
+    return x->job - y->job;
+}
+
+// --- Workers ---
+
+/**
+ * @brief Converts rendered blocks into a worker's slot.
+ */
+typedef struct {
+    int16_t* slot;
+    long capacity; /**< Samples the slot can hold. */
+    long used;     /**< Samples written so far. */
+    int full;      /**< Set if the render did not fit. */
+} SlotWriter;
+
+static int write_slot_block(void* user, const MYFLT* samples, int frames, int nchnls) {
+    SlotWriter* writer = (SlotWriter*)user;
+    long count = (long)frames * nchnls;
+    if (writer->used + count > writer->capacity) {
+        writer->full = 1;
+        return -1;
+    }
+    pcm_convert_int16(samples, writer->slot + writer->used, (size_t)count);
+    writer->used += count;
+    return 0;
+}
+
+static FarmResult render_job(CSOUND* csound, const FarmJob* job, int16_t* slot, long capacity, long* frames) {
+    ScoreFile score;
+    if (score_file_load(job->score_path, &score) != 0) {
+        return FARM_LOAD_FAILED;
+    }
+    validate_score(score.tracks, score.track_count, NULL);
+
+    SlotWriter writer = {slot, capacity, 0, 0};
+    int rendered = render_tracks(csound, score.tracks, score.track_count, 0.0, write_slot_block, &writer);
+    score_file_free(&score);
+
+    // Reset the instance for the next job instead of recreating it.
+    csoundRewindScore(csound);
+
+    *frames = writer.used / csoundGetNchnls(csound);
+    if (writer.full) {
+        return FARM_SLOT_FULL;
+    }
+    return rendered == 0 ? FARM_OK : FARM_RENDER_FAILED;
+}
+
+/**
+ * @brief The body of a worker process: renders jobs from the shared queue until it is empty.
+ *
+ * Never returns; the process exits with 0 when the queue is empty.
+ */
+static void worker_main(Farm* farm, int index) {
+    FarmWorker* self = &farm->workers[index];
+    close(farm->results[0]);
+    for (int i = 0; i < farm->worker_count; i++) {
+        close(farm->workers[i].ack[1]);
+        if (i != index) {
+            close(farm->workers[i].ack[0]);
+        }
+    }
+
+    CSOUND* csound = engine_create_offline(farm->profile);
+    if (csound == NULL) {
+        _exit(FARM_EXIT_NO_ENGINE);
+    }
+    csoundSetMessageLevel(csound, 0);
+    if (csoundStart(csound) != 0) {
+        engine_destroy(csound);
+        _exit(FARM_EXIT_NO_ENGINE);
+    }
+
+    for (;;) {
+        int position = atomic_fetch_add(&farm->queue->next, 1);
+        if (position >= farm->queue->job_count) {
+            break;
+        }
+        int job = farm->queue->order[position];
+        atomic_store(&farm->current[index], job);
+
+        FarmMessage message = {index, job, FARM_OK, 0, 0.0};
+        double start = engine_now_seconds();
+        message.result = render_job(csound, &farm->jobs[job], self->slot, farm->slot_samples, &message.frames);
+        message.seconds = engine_now_seconds() - start;
+        if (write(farm->results[1], &message, sizeof(message)) != (ssize_t)sizeof(message)) {
+            break;
+        }
+        atomic_store(&farm->current[index], -1);
+
+        // The slot may only be reused once the parent has written it out.
+        char ack;
+        if (message.result == FARM_OK && read(self->ack[0], &ack, 1) != 1) {
+            break;
+        }
+    }
+    engine_destroy(csound);
+    _exit(0);
+}
+
+static int spawn_worker(Farm* farm, int index) {
+    FarmWorker* worker = &farm->workers[index];
+
+    // A fresh acknowledgement pipe, so nothing meant for a dead worker is left in it.
+    if (worker->ack[0] >= 0) {
+        close(worker->ack[0]);
+        close(worker->ack[1]);
+    }
+    if (pipe(worker->ack) != 0) {
+        worker->ack[0] = worker->ack[1] = -1;
+        perror("Failed to create a worker pipe");
+        return -1;
+    }
+    atomic_store(&farm->current[index], -1);
+
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    if (pid < 0) {
+        perror("Failed to start a worker");
+        return -1;
+    }
+    if (pid == 0) {
+        worker_main(farm, index);
+    }
+    worker->pid = pid;
+    return 0;
+}
+
+// --- Results ---
+
+static void fail_job(Farm* farm, int job, const char* reason) {
+    farm->jobs[job].status = JOB_FAILED;
+    printf("error %s %s\n", farm->jobs[job].score_path, reason);
+    fflush(stdout);
+}
+
+/**
+ * @brief Measures the 16-bit samples of a slot, as the render's meter would have.
+ */
+static void meter_slot(Meter* meter, const int16_t* slot, long frames) {
+    MYFLT block[FARM_METER_FRAMES * 8];
+    int per_call = FARM_METER_FRAMES * 8 / meter->nchnls;
+    while (frames > 0) {
+        int n = frames > per_call ? per_call : (int)frames;
+        for (int i = 0; i < n * meter->nchnls; i++) {
+            block[i] = (MYFLT)slot[i] / 32768.0;
+        }
+        meter_process(meter, block, n);
+        slot += (long)n * meter->nchnls;
+        frames -= n;
+    }
+}
+
+/**
+ * @brief Writes out a finished job and its level report from its worker's slot and releases the slot.
+ */
+static void complete_job(Farm* farm, const FarmMessage* message) {
+    FarmJob* job = &farm->jobs[message->job];
+    FarmWorker* worker = &farm->workers[message->worker];
+    if (message->result != FARM_OK) {
+        fail_job(farm, message->job, result_reasons[message->result]);
+        return;
+    }
+
+    Meter meter;
+    int metered = meter_init(&meter, farm->profile->nchnls, farm->profile->sr) == 0;
+    if (metered) {
+        meter_slot(&meter, worker->slot, message->frames);
+    }
+    WavWriter writer;
+    int written = wav_open(&writer, job->output_path, WAV_PCM16, farm->profile->sr, farm->profile->nchnls) == 0;
+    if (written) {
+        written = wav_write_pcm16(&writer, worker->slot, message->frames) == 0;
+        written = wav_close(&writer) == 0 && written;
+    }
+    // If the worker has already exited, the byte is dropped along with its pipe when it is replaced.
+    char ack = 1;
+    if (write(worker->ack[1], &ack, 1) != 1) {
+        fprintf(stderr, "Error: Failed to release the output slot of worker %d.\n", message->worker);
+    }
+
+    int reported = 0;
+    if (written && metered) {
+        // The level report goes next to the output, as for --render.
+        char report[PATH_MAX + sizeof(METER_REPORT_SUFFIX)];
+        snprintf(report, sizeof(report), "%s%s", job->output_path, METER_REPORT_SUFFIX);
+        reported = meter_save(report, &meter, NULL, 0) == 0;
+    }
+    if (metered) {
+        meter_free(&meter);
+    }
+    if (!written) {
+        fail_job(farm, message->job, "cannot write output");
+        return;
+    }
+    if (!reported) {
+        fail_job(farm, message->job, "cannot write level report");
+        return;
+    }
+    job->status = JOB_DONE;
+    farm->succeeded++;
+    printf("ok %s %.3f\n", job->output_path, message->seconds);
+    fflush(stdout);
+}
+
+/**
+ * @brief Handles every result that arrives within the timeout.
+ * @return The number of jobs that finished.
+ */
+static int receive_results(Farm* farm, int timeout_ms) {
+    int finished = 0;
+    struct pollfd poller = {farm->results[0], POLLIN, 0};
+    while (poll(&poller, 1, timeout_ms) > 0) {
+        FarmMessage message;
+        if (read(farm->results[0], &message, sizeof(message)) != (ssize_t)sizeof(message)) {
+            break;
+        }
+        complete_job(farm, &message);
+        finished++;
+        timeout_ms = 0;
+    }
+    return finished;
+}
+
+/**
+ * @brief Fails the job an exited worker was rendering and replaces the worker if jobs remain.
+ * @return The number of jobs that failed because of the exit.
+ */
+static int handle_exit(Farm* farm, int index, int status, int* alive) {
+    farm->workers[index].pid = 0;
+    (*alive)--;
+
+    int failed = 0;
+    int job = atomic_load(&farm->current[index]);
+    if (job >= 0 && farm->jobs[job].status == JOB_PENDING) {
+        char reason[64];
+        if (WIFSIGNALED(status)) {
+            snprintf(reason, sizeof(reason), "worker crashed (signal %d)", WTERMSIG(status));
+        } else {
+            snprintf(reason, sizeof(reason), "worker exited with status %d", WEXITSTATUS(status));
+        }
+        fail_job(farm, job, reason);
+        failed = 1;
+    }
+
+    int clean = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    int no_engine = WIFEXITED(status) && WEXITSTATUS(status) == FARM_EXIT_NO_ENGINE;
+    if (!clean && !no_engine && atomic_load(&farm->queue->next) < farm->queue->job_count) {
+        if (spawn_worker(farm, index) == 0) {
+            (*alive)++;
+        }
+    }
+    return failed;
+}
+
+// --- Batch Rendering ---
+
+int farm_run(const EngineProfile* profile, const char* manifest_path, int workers) {
+    signal(SIGPIPE, SIG_IGN);
+    double start = engine_now_seconds();
+
+    Farm farm;
+    memset(&farm, 0, sizeof(farm));
+    farm.profile = profile;
+    farm.job_count = load_manifest(manifest_path, &farm.jobs, &farm.malformed);
+    if (farm.job_count < 0) {
+        return 1;
+    }
+
+    // Measure every score, then queue the most expensive ones first.
+    size_t queue_size = sizeof(FarmQueue) + (farm.job_count + 1) * sizeof(int);
+    JobCost* costs = (JobCost*)malloc((farm.job_count + 1) * sizeof(JobCost));
+    farm.queue = (FarmQueue*)shared_alloc(queue_size);
+    if (costs == NULL || farm.queue == NULL) {
+        fprintf(stderr, "Error: Failed to allocate memory for the job queue.\n");
+        free(costs);
+        free(farm.jobs);
+        return 1;
+    }
+    int queued = 0;
+    double longest = 0.0;
+    for (int j = 0; j < farm.job_count; j++) {
+        if (estimate_job(&farm.jobs[j]) != 0) {
+            fail_job(&farm, j, result_reasons[FARM_LOAD_FAILED]);
+            continue;
+        }
+        costs[queued].cost = farm.jobs[j].cost;
+        costs[queued].job = j;
+        queued++;
+        if (farm.jobs[j].length > longest) {
+            longest = farm.jobs[j].length;
+        }
+    }
+    qsort(costs, queued, sizeof(JobCost), compare_costs);
+    for (int i = 0; i < queued; i++) {
+        farm.queue->order[i] = costs[i].job;
+    }
+    free(costs);
+    atomic_init(&farm.queue->next, 0);
+    farm.queue->job_count = queued;
+
+    // One worker per job at most, each with a slot that can hold the longest piece.
+    if (workers > queued) {
+        workers = queued > 0 ? queued : 1;
+    }
+    farm.worker_count = workers;
+    farm.slot_samples = (long)((longest + FARM_TAIL_SECONDS) * profile->sr) * profile->nchnls;
+    size_t slots_size = (size_t)workers * farm.slot_samples * sizeof(int16_t);
+    int16_t* slots = (int16_t*)shared_alloc(slots_size);
+    farm.current = (atomic_int*)shared_alloc(workers * sizeof(atomic_int));
+    farm.workers = (FarmWorker*)calloc(workers, sizeof(FarmWorker));
+    if (slots == NULL || farm.current == NULL || farm.workers == NULL || pipe(farm.results) != 0) {
+        fprintf(stderr, "Error: Failed to allocate shared memory for %d output slots.\n", workers);
+        free(farm.jobs);
+        free(farm.workers);
+        return 1;
+    }
+
+    int alive = 0;
+    for (int w = 0; w < workers; w++) {
+        farm.workers[w].ack[0] = farm.workers[w].ack[1] = -1;
+        farm.workers[w].slot = slots + (size_t)w * farm.slot_samples;
+    }
+    for (int w = 0; w < workers && queued > 0; w++) {
+        if (spawn_worker(&farm, w) == 0) {
+            alive++;
+        }
+    }
+    fprintf(stderr, "Rendering %d jobs on %d worker processes (profile '%s').\n", queued, alive, profile->name);
+
+    int remaining = queued;
+    while (remaining > 0 && alive > 0) {
+        remaining -= receive_results(&farm, FARM_POLL_MS);
+        int status;
+        pid_t pid;
+        while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+            // Results the worker sent before it exited are handled first.
+            remaining -= receive_results(&farm, 0);
+            for (int w = 0; w < workers; w++) {
+                if (farm.workers[w].pid == pid) {
+                    remaining -= handle_exit(&farm, w, status, &alive);
+                    break;
+                }
+            }
+        }
+    }
+
+    // Jobs no worker finished: every worker failed to start, or one died while claiming a job.
+    for (int i = 0; i < queued; i++) {
+        if (farm.jobs[farm.queue->order[i]].status == JOB_PENDING) {
+            fail_job(&farm, farm.queue->order[i], "no worker rendered it");
+        }
+    }
+    fprintf(stderr, "Batch complete: %d of %d jobs rendered in %.3f seconds.\n",
+        farm.succeeded, farm.job_count + farm.malformed, engine_now_seconds() - start);
+
+    for (int w = 0; w < workers; w++) {
+        if (farm.workers[w].ack[0] >= 0) {
+            close(farm.workers[w].ack[0]);
+            close(farm.workers[w].ack[1]);
+        }
+    }
+    close(farm.results[0]);
+    close(farm.results[1]);
+    munmap(slots, slots_size);
+    munmap(farm.queue, queue_size);
+    munmap(farm.current, workers * sizeof(atomic_int));
+    int result = farm.succeeded == farm.job_count && farm.malformed == 0 ? 0 : 1;
+    free(farm.jobs);
+    free(farm.workers);
+    return result;
+}
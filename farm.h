@@ -0,0 +1,36 @@
+#ifndef FARM_H
+#define FARM_H
+
+#include "engine.h"
+
+// --- Batch Render Farm ---
+//
+// Renders a manifest of independent scores on a pool of worker processes.
+// The manifest has one job per line, in the same form as the render server:
+//
+//   <score_path> <output_path>
+//
+// Blank lines and lines starting with '#' are ignored. The parent measures
+// every score up front and orders the jobs by estimated cost, longest first.
+// Workers are forked with their own Csound instance and take the next job
+// from a shared atomic counter whenever they become idle, so a long piece
+// never holds up a queue of short ones. A worker renders 16-bit PCM into its
+// own shared-memory slot; the parent writes the WAV file and its level report
+// (<output_path>.meter) from that slot and hands it back. A worker that crashes only fails the job it was rendering
+// and is replaced by a fresh process.
+//
+// One line is printed per job as it completes:
+//
+//   ok <output_path> <render_seconds>
+//   error <score_path> <reason>
+
+/**
+ * @brief Renders every job of a manifest.
+ * @param profile The engine profile used by every worker.
+ * @param manifest_path The manifest to read.
+ * @param workers The number of worker processes.
+ * @return 0 if every job succeeded, 1 if any job failed or the farm could not start.
+ */
+int farm_run(const EngineProfile* profile, const char* manifest_path, int workers);
+
+#endif // FARM_H
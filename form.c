@@ -0,0 +1,196 @@
+#include <stdio.h>
+
+#include "form.h"
+
+/**
+ * @brief Reads a section of a track. A track without sections has one implicit section holding every measure.
+ */
+static Section get_section(const Track* track, int index) {
+    if (track->sections == NULL) {
+        Section whole = {{0, track->measure_count, 0}, 1, NULL, 0};
+        return whole;
+    }
+    return track->sections[index];
+}
+
+static int section_count(const Track* track) {
+    return track->sections == NULL ? 1 : track->section_count;
+}
+
+static int section_times(const Section* section) {
+    return section->times < 1 ? 1 : section->times;
+}
+
+/**
+ * @brief Returns the ending played on a pass, or NULL if the section has no endings.
+ */
+static const MeasureRange* section_ending(const Section* section, int pass) {
+    if (section->ending_count <= 0) {
+        return NULL;
+    }
+    return &section->endings[pass < section->ending_count ? pass : section->ending_count - 1];
+}
+
+static int pass_length(const Section* section, int pass) {
+    const MeasureRange* ending = section_ending(section, pass);
+    return section->body.length + (ending != NULL ? ending->length : 0);
+}
+
+/**
+ * @brief Counts the measures of a section over all of its passes.
+ */
+static int section_length(const Section* section) {
+    int times = section_times(section);
+    int counted = section->ending_count < times ? section->ending_count : times;
+    int total = 0;
+    for (int pass = 0; pass < counted; pass++) {
+        total += pass_length(section, pass);
+    }
+    // Every later pass reuses the last ending, so they all have the same length.
+    total += (times - counted) * pass_length(section, times - 1);
+    return total;
+}
+
+/**
+ * @brief Returns the range the cursor is in.
+ */
+static const MeasureRange* cursor_range(const Section* section, const FormCursor* cursor) {
+    return cursor->in_ending ? section_ending(section, cursor->pass) : &section->body;
+}
+
+/**
+ * @brief Moves the cursor forward until it is on a measure, skipping empty ranges.
+ */
+static void settle(const Track* track, FormCursor* cursor) {
+    int count = section_count(track);
+    while (cursor->section < count) {
+        Section section = get_section(track, cursor->section);
+        const MeasureRange* range = cursor_range(&section, cursor);
+        if (range != NULL && cursor->offset < range->length) {
+            cursor->measure = range->start + cursor->offset;
+            return;
+        }
+
+        // The current range is done: body -> ending -> next pass -> next section.
+        cursor->offset = 0;
+        if (!cursor->in_ending && section_ending(&section, cursor->pass) != NULL) {
+            cursor->in_ending = 1;
+        } else if (cursor->pass + 1 < section_times(&section)) {
+            cursor->in_ending = 0;
+            cursor->pass++;
+        } else {
+            cursor->in_ending = 0;
+            cursor->pass = 0;
+            cursor->section++;
+        }
+    }
+    cursor->measure = -1;
+}
+
+static int check_range(const Track* track, const MeasureRange* range, int section, FILE* log) {
+    if (range->start >= 0 && range->length >= 0 && range->start + range->length <= track->measure_count) {
+        return 0;
+    }
+    if (log != NULL) {
+        fprintf(log, "  [WARNING] Track '%s', Section %d: Measures %d-%d are outside the track's %d measures.\n",
+            track->name, section + 1, range->start + 1, range->start + range->length, track->measure_count);
+    }
+    return 1;
+}
+
+int form_check(const Track* track, FILE* log) {
+    int errors = 0;
+    for (int s = 0; track->sections != NULL && s < track->section_count; s++) {
+        const Section* section = &track->sections[s];
+        errors += check_range(track, &section->body, s, log);
+        for (int e = 0; e < section->ending_count; e++) {
+            errors += check_range(track, &section->endings[e], s, log);
+        }
+    }
+    return errors;
+}
+
+int form_length(const Track* track) {
+    int total = 0;
+    for (int s = 0; s < section_count(track); s++) {
+        Section section = get_section(track, s);
+        total += section_length(&section);
+    }
+    return total;
+}
+
+void form_start(const Track* track, FormCursor* cursor) {
+    cursor->section = 0;
+    cursor->pass = 0;
+    cursor->in_ending = 0;
+    cursor->offset = 0;
+    cursor->position = 0;
+    settle(track, cursor);
+}
+
+void form_next(const Track* track, FormCursor* cursor) {
+    if (cursor->measure < 0) {
+        return;
+    }
+    cursor->offset++;
+    cursor->position++;
+    settle(track, cursor);
+}
+
+int form_seek(const Track* track, FormCursor* cursor, int position) {
+    form_start(track, cursor);
+    if (position < 0) {
+        return -1;
+    }
+
+    // Skip whole sections.
+    int remaining = position;
+    int count = section_count(track);
+    int s = 0;
+    Section section;
+    for (; s < count; s++) {
+        section = get_section(track, s);
+        int length = section_length(&section);
+        if (remaining < length) {
+            break;
+        }
+        remaining -= length;
+    }
+    cursor->position = position - remaining;
+    cursor->section = s;
+    if (s == count) {
+        settle(track, cursor);
+        return -1;
+    }
+
+    // Skip whole passes: the passes with their own ending one by one, then the rest arithmetically.
+    int times = section_times(&section);
+    int pass = 0;
+    while (pass < times && pass < section.ending_count && remaining >= pass_length(&section, pass)) {
+        remaining -= pass_length(&section, pass);
+        pass++;
+    }
+    if (pass >= section.ending_count) {
+        int length = pass_length(&section, pass);
+        pass += remaining / length;
+        remaining %= length;
+    }
+
+    cursor->pass = pass;
+    cursor->in_ending = remaining >= section.body.length;
+    cursor->offset = cursor->in_ending ? remaining - section.body.length : remaining;
+    cursor->position = position;
+    settle(track, cursor);
+    return 0;
+}
+
+double form_bpm(const Track* track, const FormCursor* cursor) {
+    if (cursor->offset == 0) {
+        Section section = get_section(track, cursor->section);
+        const MeasureRange* range = cursor_range(&section, cursor);
+        if (range->bpm > 0) {
+            return range->bpm;
+        }
+    }
+    return track->measures[cursor->measure].bpm;
+}
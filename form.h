@@ -0,0 +1,71 @@
+#ifndef FORM_H
+#define FORM_H
+
+#include <stdio.h>
+#include "score.h"
+
+// --- Track Forms ---
+// A track's sections (repeats, volta endings, references to earlier
+// measures) are never expanded into a flat list. A FormCursor walks them
+// lazily, one measure at a time, and can jump to any played measure by
+// arithmetic over the sections instead of stepping through them.
+
+/**
+ * @brief A position in the played order of a track's measures.
+ */
+typedef struct {
+    int section;   /**< Index of the current section. */
+    int pass;      /**< The current pass through the section, counting from 0. */
+    int in_ending; /**< Non-zero while the pass is in its volta ending. */
+    int offset;    /**< Offset of the current measure within the body or ending. */
+    int measure;   /**< Index into Track.measures of the current measure, or -1 once the form has ended. */
+    int position;  /**< The number of measures played before the current one. */
+} FormCursor;
+
+/**
+ * @brief Checks that every range of a track's form lies within its measures.
+ * @param track The track to check.
+ * @param log Where problems are printed, or NULL to stay silent.
+ * @return The number of invalid ranges.
+ */
+int form_check(const Track* track, FILE* log);
+
+/**
+ * @brief Counts the measures a track plays, including repeats, without expanding its form.
+ * @param track The track.
+ * @return The number of played measures.
+ */
+int form_length(const Track* track);
+
+/**
+ * @brief Places a cursor on the first played measure of a track.
+ * @param track The track.
+ * @param cursor The cursor to initialize. Its measure is -1 if the track plays nothing.
+ */
+void form_start(const Track* track, FormCursor* cursor);
+
+/**
+ * @brief Advances a cursor to the next played measure.
+ * @param track The track the cursor belongs to.
+ * @param cursor The cursor to advance. Its measure becomes -1 after the last measure.
+ */
+void form_next(const Track* track, FormCursor* cursor);
+
+/**
+ * @brief Places a cursor on a played measure.
+ * @param track The track.
+ * @param cursor The cursor to move.
+ * @param position The index of the measure in played order.
+ * @return 0 on success, -1 if the track plays fewer measures (the cursor is then at the end).
+ */
+int form_seek(const Track* track, FormCursor* cursor, int position);
+
+/**
+ * @brief Returns the tempo set when the cursor's measure starts.
+ * @param track The track the cursor belongs to.
+ * @param cursor A cursor on a measure.
+ * @return The new tempo in BPM, or 0 if the tempo does not change.
+ */
+double form_bpm(const Track* track, const FormCursor* cursor);
+
+#endif // FORM_H
@@ -1,33 +1,68 @@
 #include <stdio.h> // For NULL
+#include <string.h>
+#include "arena.h"
 #include "instrument_piano.h"
 
+#define CHORD_POOL_ALIGNMENT 16 // Every block taken from the pool arena is rounded up to this size.
+#define CHORD_MAX_NOTES 8       // The most notes a generated chord can have.
+#define CHORD_BASE_KEY C4       // The key of a generated chord's root in root position, for root C.
+
 // --- Variable Definitions ---
 
 double piano_key_frequencies[NUM_PIANO_KEYS];
+ChordPool chord_pool;
+static Arena* chord_pool_arena = NULL;
 
 // --- Chord Definitions (Diatonic to C Major) ---
 // Triads and Seventh chords for each degree of the C Major scale.
 struct Chord chords[] = {
     // --- Triads ---
-    {"C",    {C4, E4, G4, NO_NOTE}}, // I:   C Major
-    {"Dm",   {D4, F4, A4, NO_NOTE}}, // ii:  D Minor
-    {"Em",   {E4, G4, B4, NO_NOTE}}, // iii: E Minor
-    {"F",    {F4, A4, C5, NO_NOTE}}, // IV:  F Major
-    {"G",    {G4, B4, D4, NO_NOTE}}, // V:   G Major
-    {"Am",   {A4, C5, E5, NO_NOTE}}, // vi:  A Minor
-    {"Bdim", {B4, D4, F4, NO_NOTE}}, // vii°:B Diminished
+    {"C",    CHORD_NOTES(C4, E4, G4)}, // I:   C Major
+    {"Dm",   CHORD_NOTES(D4, F4, A4)}, // ii:  D Minor
+    {"Em",   CHORD_NOTES(E4, G4, B4)}, // iii: E Minor
+    {"F",    CHORD_NOTES(F4, A4, C5)}, // IV:  F Major
+    {"G",    CHORD_NOTES(G4, B4, D4)}, // V:   G Major
+    {"Am",   CHORD_NOTES(A4, C5, E5)}, // vi:  A Minor
+    {"Bdim", CHORD_NOTES(B4, D4, F4)}, // vii°:B Diminished
 
     // --- Full Seventh Chords ---
-    {"Cmaj7", {C4, E4, G4, B4}}, // Imaj7: C Major 7th
-    {"Dm7",   {D4, F4, A4, C5}}, // iim7:  D Minor 7th
-    {"Em7",   {E4, G4, B4, D5}}, // iiim7: E Minor 7th
-    {"Fmaj7", {F4, A4, C5, E5}}, // IVmaj7:F Major 7th
-    {"G7",    {G4, B4, D4, F5}}, // V7:    G Dominant 7th
-    {"Am7",   {A4, C5, E5, G5}}, // vim7:  A Minor 7th
-    {"Bm7b5", {B4, D4, F4, A4}}, // viim7(b5): B Half-diminished 7th
+    {"Cmaj7", CHORD_NOTES(C4, E4, G4, B4)}, // Imaj7: C Major 7th
+    {"Dm7",   CHORD_NOTES(D4, F4, A4, C5)}, // iim7:  D Minor 7th
+    {"Em7",   CHORD_NOTES(E4, G4, B4, D5)}, // iiim7: E Minor 7th
+    {"Fmaj7", CHORD_NOTES(F4, A4, C5, E5)}, // IVmaj7:F Major 7th
+    {"G7",    CHORD_NOTES(G4, B4, D4, F5)}, // V7:    G Dominant 7th
+    {"Am7",   CHORD_NOTES(A4, C5, E5, G5)}, // vim7:  A Minor 7th
+    {"Bm7b5", CHORD_NOTES(B4, D4, F4, A4)}, // viim7(b5): B Half-diminished 7th
 };
 const int NUM_CHORDS = sizeof(chords) / sizeof(struct Chord);
 
+// --- Chord Qualities ---
+// Intervals in semitones above the root, indexed by ChordQuality.
+struct ChordShape {
+    const char* suffix;
+    int intervals[CHORD_MAX_NOTES];
+    int count;
+};
+
+static const struct ChordShape chord_shapes[NUM_CHORD_QUALITIES] = {
+    {"",     {0, 4, 7},         3}, // QUALITY_MAJOR
+    {"m",    {0, 3, 7},         3}, // QUALITY_MINOR
+    {"dim",  {0, 3, 6},         3}, // QUALITY_DIMINISHED
+    {"aug",  {0, 4, 8},         3}, // QUALITY_AUGMENTED
+    {"sus2", {0, 2, 7},         3}, // QUALITY_SUS2
+    {"sus4", {0, 5, 7},         3}, // QUALITY_SUS4
+    {"maj7", {0, 4, 7, 11},     4}, // QUALITY_MAJOR7
+    {"m7",   {0, 3, 7, 10},     4}, // QUALITY_MINOR7
+    {"7",    {0, 4, 7, 10},     4}, // QUALITY_DOMINANT7
+    {"m7b5", {0, 3, 6, 10},     4}, // QUALITY_HALF_DIMINISHED7
+    {"dim7", {0, 3, 6, 9},      4}, // QUALITY_DIMINISHED7
+    {"9",    {0, 4, 7, 10, 14}, 5}, // QUALITY_DOMINANT9
+    {"m9",   {0, 3, 7, 10, 14}, 5}, // QUALITY_MINOR9
+};
+
+// Root names, using 's' for sharps as the PianoKey names do ('#' starts a comment in score files).
+static const char* const root_names[12] = {"C", "Cs", "D", "Ds", "E", "F", "Fs", "G", "Gs", "A", "As", "B"};
+
 // --- Function Implementations ---
 
 // --- 88-Key Piano Frequencies ---
@@ -138,6 +173,163 @@ void generate_piano_frequencies() {
     }
 }
 
+// --- Chord Pool ---
+
+/**
+ * @brief Computes the sorted keys of a generated chord.
+ * @return The number of keys written to keys.
+ */
+static int voice_chord(int root, int quality, int inversion, int voicing, PianoKey* keys) {
+    const struct ChordShape* shape = &chord_shapes[quality];
+    int semitones[CHORD_MAX_NOTES];
+    int n = shape->count;
+
+    // Rotate the lowest notes up an octave, so the inverted chord starts on note `inversion`.
+    for (int i = 0; i < n; i++) {
+        int k = (i + inversion) % n;
+        semitones[i] = shape->intervals[k] + (i + inversion >= n ? 12 : 0);
+    }
+    // Intervals above an octave (9ths) can land at or below the new bass: raise them
+    // an octave so the inversion keeps its bass, then keep the upper voices ascending.
+    for (int i = 1; i < n; i++) {
+        if (semitones[i] <= semitones[0]) {
+            semitones[i] += 12;
+        }
+    }
+    for (int i = 2; i < n; i++) {
+        for (int j = i; j > 1 && semitones[j - 1] > semitones[j]; j--) {
+            int tmp = semitones[j];
+            semitones[j] = semitones[j - 1];
+            semitones[j - 1] = tmp;
+        }
+    }
+    if (voicing == VOICING_OPEN && n >= 3) {
+        // Drop 2: the second-highest voice moves down an octave and becomes the bass.
+        int dropped = semitones[n - 2] - 12;
+        for (int j = n - 2; j > 0; j--) {
+            semitones[j] = semitones[j - 1];
+        }
+        semitones[0] = dropped;
+    }
+    for (int i = 0; i < n; i++) {
+        keys[i] = (PianoKey)(CHORD_BASE_KEY + root + semitones[i]);
+    }
+    return n;
+}
+
+static void* pool_alloc(size_t size) {
+    size = (size + CHORD_POOL_ALIGNMENT - 1) / CHORD_POOL_ALIGNMENT * CHORD_POOL_ALIGNMENT;
+    return arena_alloc(chord_pool_arena, size);
+}
+
+int generate_chord_pool() {
+    int generated_notes = 0;
+    for (int q = 0; q < NUM_CHORD_QUALITIES; q++) {
+        // One chord per inversion, each with as many notes as the quality has.
+        generated_notes += chord_shapes[q].count * chord_shapes[q].count;
+    }
+    int count = NUM_CHORDS;
+    int note_count = 0;
+    for (int i = 0; i < NUM_CHORDS; i++) {
+        note_count += chords[i].count;
+    }
+    for (int q = 0; q < NUM_CHORD_QUALITIES; q++) {
+        count += 12 * chord_shapes[q].count * NUM_CHORD_VOICINGS;
+    }
+    note_count += 12 * NUM_CHORD_VOICINGS * generated_notes;
+
+    size_t offsets_size = (size_t)(count + 1) * sizeof(int);
+    size_t keys_size = (size_t)note_count * sizeof(PianoKey);
+    size_t freqs_size = (size_t)note_count * sizeof(double);
+    size_t names_size = (size_t)count * CHORD_NAME_MAX;
+
+    free_chord_pool();
+    chord_pool_arena = arena_create(offsets_size + keys_size + freqs_size + names_size + 4 * CHORD_POOL_ALIGNMENT);
+    if (chord_pool_arena == NULL) {
+        return -1;
+    }
+    chord_pool.offsets = (int*)pool_alloc(offsets_size);
+    chord_pool.keys = (PianoKey*)pool_alloc(keys_size);
+    chord_pool.freqs = (double*)pool_alloc(freqs_size);
+    chord_pool.names = (char (*)[CHORD_NAME_MAX])pool_alloc(names_size);
+
+    // Hand-written chords first, so ChordType values remain valid pool indices.
+    int c = 0;
+    int n = 0;
+    for (int i = 0; i < NUM_CHORDS; i++, c++) {
+        chord_pool.offsets[c] = n;
+        snprintf(chord_pool.names[c], CHORD_NAME_MAX, "%s", chords[i].name);
+        for (int j = 0; j < chords[i].count; j++) {
+            chord_pool.keys[n++] = chords[i].indices[j];
+        }
+    }
+    // Generated chords, in the order chord_index() expects.
+    for (int root = 0; root < 12; root++) {
+        for (int q = 0; q < NUM_CHORD_QUALITIES; q++) {
+            for (int inversion = 0; inversion < chord_shapes[q].count; inversion++) {
+                for (int voicing = 0; voicing < NUM_CHORD_VOICINGS; voicing++, c++) {
+                    chord_pool.offsets[c] = n;
+                    n += voice_chord(root, q, inversion, voicing, chord_pool.keys + n);
+                    // A close-voiced "/k" chord must have interval k of its shape in the bass.
+                    if (voicing == VOICING_CLOSE
+                        && (int)chord_pool.keys[chord_pool.offsets[c]] != CHORD_BASE_KEY + root + chord_shapes[q].intervals[inversion]) {
+                        fprintf(stderr, "Error: Generated chord %s%s/%d does not have its inversion in the bass.\n",
+                                root_names[root], chord_shapes[q].suffix, inversion);
+                        free_chord_pool();
+                        return -1;
+                    }
+
+                    char inversion_name[16] = "";
+                    if (inversion > 0) {
+                        snprintf(inversion_name, sizeof(inversion_name), "/%d", inversion);
+                    }
+                    snprintf(chord_pool.names[c], CHORD_NAME_MAX, "%s%s%s%s", root_names[root],
+                             chord_shapes[q].suffix, inversion_name, voicing == VOICING_OPEN ? "-open" : "");
+                }
+            }
+        }
+    }
+    chord_pool.offsets[c] = n;
+    chord_pool.count = c;
+    chord_pool.note_count = n;
+
+    // Resolve every frequency once, so playing a chord is a single contiguous read.
+    for (int i = 0; i < n; i++) {
+        chord_pool.freqs[i] = get_piano_frequency(chord_pool.keys[i]);
+    }
+    return 0;
+}
+
+void free_chord_pool() {
+    arena_destroy(chord_pool_arena);
+    chord_pool_arena = NULL;
+    memset(&chord_pool, 0, sizeof(chord_pool));
+}
+
+int chord_pool_notes(int index, const double** freqs) {
+    if (index < 0 || index >= chord_pool.count) {
+        return 0;
+    }
+    *freqs = chord_pool.freqs + chord_pool.offsets[index];
+    return chord_pool.offsets[index + 1] - chord_pool.offsets[index];
+}
+
+int chord_index(int root, ChordQuality quality, int inversion, ChordVoicing voicing) {
+    if (root < 0 || root >= 12 || quality < 0 || quality >= NUM_CHORD_QUALITIES ||
+        inversion < 0 || inversion >= chord_shapes[quality].count || voicing < 0 || voicing >= NUM_CHORD_VOICINGS) {
+        return -1;
+    }
+    int per_root = 0;
+    int before = 0;
+    for (int q = 0; q < NUM_CHORD_QUALITIES; q++) {
+        if (q == (int)quality) {
+            before = per_root;
+        }
+        per_root += chord_shapes[q].count * NUM_CHORD_VOICINGS;
+    }
+    return NUM_CHORDS + root * per_root + before + inversion * NUM_CHORD_VOICINGS + voicing;
+}
+
 const struct Chord* get_piano_chord(int index) {
     if (index >= 0 && index < NUM_CHORDS) {
         return &chords[index];
@@ -150,4 +342,43 @@ double get_piano_frequency(PianoKey key) {
         return piano_key_frequencies[key];
     }
     return 0.0; // Return invalid frequency
-}
\ No newline at end of file
+}
+
+int piano_key_from_name(const char* name, int length) {
+    // Semitone offsets of the natural notes from C, indexed by letter A-G.
+    static const int letter_semitones[] = {9, 11, 0, 2, 4, 5, 7};
+
+    if (length < 2 || name[0] < 'A' || name[0] > 'G') {
+        return -1;
+    }
+    int semitone = letter_semitones[name[0] - 'A'];
+    int pos = 1;
+    if (name[pos] == 's' || name[pos] == '#') {
+        semitone++;
+        pos++;
+    } else if (name[pos] == 'b') {
+        semitone--;
+        pos++;
+    }
+    if (pos != length - 1 || name[pos] < '0' || name[pos] > '8') {
+        return -1;
+    }
+    int octave = name[pos] - '0';
+
+    // Key 0 is A0, which is 9 semitones above C0.
+    int key = octave * 12 + semitone - 9;
+    if (key < 0 || key >= NUM_PIANO_KEYS) {
+        return -1;
+    }
+    return key;
+}
+
+int piano_chord_from_name(const char* name, int length) {
+    // The first match wins, so hand-written chords take precedence over generated ones.
+    for (int i = 0; i < chord_pool.count; i++) {
+        if ((int)strlen(chord_pool.names[i]) == length && strncmp(chord_pool.names[i], name, length) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
@@ -28,8 +28,6 @@ typedef enum {
     C8
 } PianoKey; // Total 88 keys, from index 0 (A0) to 87 (C8)
 
-#define NO_NOTE -1 // A sentinel value to indicate an unused note slot in a chord.
-
 // --- Chord Type Enum (corresponds to chords array index) ---
 typedef enum {
     CHORD_C     = 0,  // I
@@ -50,10 +48,60 @@ typedef enum {
 
 // --- Chord Definition ---
 struct Chord {
-    const char *name;      // The standard name of the chord (e.g., "C", "Dm7").
-    PianoKey indices[4];  // The piano keys that make up the chord (up to 4 notes).
+    const char *name;         // The standard name of the chord (e.g., "C", "Dm7").
+    const PianoKey* indices;  // The piano keys that make up the chord, lowest voice first.
+    int count;                // The number of keys in the chord (any size).
 };
 
+// Expands a list of keys into the `indices` and `count` fields of a Chord.
+#define CHORD_NOTES(...) \
+    (const PianoKey[]){__VA_ARGS__}, (int)(sizeof((const PianoKey[]){__VA_ARGS__}) / sizeof(PianoKey))
+
+// --- Generated Chords ---
+// Besides the hand-written chords above, every quality is generated on all 12
+// roots, in every inversion and in two voicings. Generated chords are named
+// <root><suffix>[/<inversion>][-open], e.g. "Fsm7", "G7/1", "Dsmaj7/2-open";
+// sharps are written with 's' as in the PianoKey names.
+
+typedef enum {
+    QUALITY_MAJOR,
+    QUALITY_MINOR,
+    QUALITY_DIMINISHED,
+    QUALITY_AUGMENTED,
+    QUALITY_SUS2,
+    QUALITY_SUS4,
+    QUALITY_MAJOR7,
+    QUALITY_MINOR7,
+    QUALITY_DOMINANT7,
+    QUALITY_HALF_DIMINISHED7,
+    QUALITY_DIMINISHED7,
+    QUALITY_DOMINANT9,
+    QUALITY_MINOR9,
+    NUM_CHORD_QUALITIES
+} ChordQuality;
+
+typedef enum {
+    VOICING_CLOSE, // All notes within one octave above the lowest.
+    VOICING_OPEN,  // "Drop 2": the second-highest note moved down an octave.
+    NUM_CHORD_VOICINGS
+} ChordVoicing;
+
+#define CHORD_NAME_MAX 24
+
+// --- Chord Pool ---
+// All chords, hand-written first (so ChordType values are pool indices), then
+// the generated ones. Notes are stored as a flat structure of arrays: chord i
+// owns entries [offsets[i], offsets[i + 1]) of `keys` and `freqs`, and the
+// frequencies are resolved once when the pool is built.
+typedef struct {
+    int count;                       // The number of chords in the pool.
+    int note_count;                  // The total number of notes of all chords.
+    int* offsets;                    // count + 1 offsets into keys and freqs.
+    PianoKey* keys;                  // The piano key of every note.
+    double* freqs;                   // The frequency of every note in Hz.
+    char (*names)[CHORD_NAME_MAX];   // The name of every chord.
+} ChordPool;
+
 // --- Public Variables ---
 
 // Frequency array for the 88 piano keys
@@ -161,6 +209,9 @@ extern double piano_key_frequencies[NUM_PIANO_KEYS];
 extern struct Chord chords[];
 extern const int NUM_CHORDS;
 
+// Every chord, built by generate_chord_pool()
+extern ChordPool chord_pool;
+
 // --- Public Functions ---
 
 /**
@@ -169,7 +220,43 @@ extern const int NUM_CHORDS;
 void generate_piano_frequencies();
 
 /**
- * @brief Gets a chord definition by its index.
+ * @brief Builds chord_pool from the hand-written chords and all generated chords.
+ *
+ * Must be called after generate_piano_frequencies(), since note frequencies
+ * are resolved while the pool is built.
+ *
+ * Every close-voiced inversion "/k" is checked to have interval k of its
+ * shape in the bass.
+ *
+ * @return 0 on success, -1 if memory allocation or that check fails (an error is printed for the check).
+ */
+int generate_chord_pool();
+
+/**
+ * @brief Frees chord_pool. Safe to call when the pool was never built.
+ */
+void free_chord_pool();
+
+/**
+ * @brief Gets the notes of a chord in the pool.
+ * @param index The index of the chord in chord_pool (e.g., a ChordType value).
+ * @param freqs Receives a pointer to the chord's contiguous frequencies.
+ * @return The number of notes, or 0 if the index is invalid.
+ */
+int chord_pool_notes(int index, const double** freqs);
+
+/**
+ * @brief Computes the pool index of a generated chord.
+ * @param root The root as a semitone above C (0 = C, 11 = B).
+ * @param quality The chord quality.
+ * @param inversion 0 for root position, up to one less than the number of notes.
+ * @param voicing The voicing.
+ * @return The pool index, or -1 if an argument is out of range.
+ */
+int chord_index(int root, ChordQuality quality, int inversion, ChordVoicing voicing);
+
+/**
+ * @brief Gets a hand-written chord definition by its index.
  * @param index The index of the chord in the chords array.
  * @return A pointer to the Chord struct, or NULL if the index is invalid.
  */
@@ -182,5 +269,21 @@ const struct Chord* get_piano_chord(int index);
  */
 double get_piano_frequency(PianoKey key);
 
+/**
+ * @brief Parses a note name such as "C4", "Cs4" or "Bb3".
+ * @param name The note name: a letter A-G, an optional 's'/'#' (sharp) or 'b' (flat), and an octave digit.
+ * @param length The number of characters of name to read.
+ * @return The PianoKey index, or -1 if the name is not a valid key.
+ */
+int piano_key_from_name(const char* name, int length);
+
+/**
+ * @brief Finds a chord by its name (e.g., "C", "Dm7", "Fs7/1-open").
+ * @param name The chord name.
+ * @param length The number of characters of name to read.
+ * @return The index of the chord in chord_pool, or -1 if it is not found.
+ */
+int piano_chord_from_name(const char* name, int length);
+
 
 #endif // INSTRUMENT_PIANO_H
\ No newline at end of file
@@ -30,13 +30,23 @@ typedef struct {
 #define CREATE_INSTRUMENT(n, b) \
     { .name = n, .body = INSTRUMENT_BLOCK(n, b) }
 
-static const char* get_orc_header() {
-    return LINE("sr = 44100")
-        LINE("ksmps = 32")
-        LINE("nchnls = 2")
-        LINE("0dbfs = 1")
-        LINE(""); // Extra newline for separation
-}
+// Every instrument sends its signal to the master output. A note whose p1 has
+// a fractional part (e.g. "i1.003") is also mixed into that stem bus, an
+// audio channel the host reads after each block (see STEM_BUS_FORMAT).
+#define INSTRUMENT_OUTPUT                               \
+    LINE("    outs a_mix, a_mix")                       \
+    LINE("    i_stem = round(frac(p1) * 1000)")         \
+    LINE("    cggoto i_stem == 0, no_stem")             \
+    LINE("    S_bus sprintf \"" STEM_BUS_FORMAT "\", i_stem") \
+    LINE("    chnmix a_mix, S_bus")                     \
+    LINE("no_stem:")
+
+#define ORC_HEADER_FORMAT  \
+    LINE("sr = %d")        \
+    LINE("ksmps = %d")     \
+    LINE("nchnls = %d")    \
+    LINE("0dbfs = 1")      \
+    LINE("") // Extra newline for separation
 
 Instrument piano_instr = CREATE_INSTRUMENT("1",
     LINE("    i_freq = p4")
@@ -49,7 +59,7 @@ Instrument piano_instr = CREATE_INSTRUMENT("1",
     LINE("    a_env3 linsegr 0, 0.01, i_amp*0.3, i_dur*0.4, 0")
     LINE("    a_sig3 oscili a_env3, i_freq*3.01")
     LINE("    a_mix = (a_sig1 + a_sig2 + a_sig3) * 0.5")
-    LINE("    outs a_mix, a_mix")
+    INSTRUMENT_OUTPUT
 );
 
 Instrument violin_instr = CREATE_INSTRUMENT("2",
@@ -64,7 +74,7 @@ Instrument violin_instr = CREATE_INSTRUMENT("2",
     LINE("    k_vib oscili 5, 5.5")
     LINE("    a_vibrato oscili a_env*0.8, i_freq+k_vib")
     LINE("    a_mix = (a_sig1 + a_sig2 + a_sig3 + a_sig4 + a_vibrato) * 0.3")
-    LINE("    outs a_mix, a_mix")
+    INSTRUMENT_OUTPUT
 );
 
 Instrument viola_instr = CREATE_INSTRUMENT("3",
@@ -79,10 +89,22 @@ Instrument viola_instr = CREATE_INSTRUMENT("3",
     LINE("    k_vib oscili 4, 4.8")
     LINE("    a_vibrato oscili a_env*0.7, i_freq+k_vib")
     LINE("    a_mix = (a_sig1 + a_sig2 + a_sig3 + a_sig4 + a_vibrato) * 0.35")
-    LINE("    outs a_mix, a_mix")
+    INSTRUMENT_OUTPUT
 );
 
 
+// The release segments of the envelopes above, as (a multiple of p3) + (a fixed time).
+// The piano's fundamental releases over as long again as the note was held.
+static const double release_scale[NUM_INSTRUMENTS] = {1.0, 0.0, 0.0};
+static const double release_fixed[NUM_INSTRUMENTS] = {0.0, 0.02, 0.02};
+
+double instrument_release_seconds(int instrument, double duration) {
+    if (instrument < 1 || instrument > NUM_INSTRUMENTS) {
+        return 0.0;
+    }
+    return release_scale[instrument - 1] * duration + release_fixed[instrument - 1];
+}
+
 const char* instrument_name(Instrument* instr) {
     return instr->name;
 }
@@ -91,7 +113,7 @@ const char* instrument_body(Instrument* instr) {
     return instr->body;
 }
 
-char* get_orchestra_string() {
+char* get_orchestra_string(int sr, int ksmps, int nchnls) {
     Instrument instruments[] = {
         piano_instr,
         violin_instr,
@@ -99,8 +121,11 @@ char* get_orchestra_string() {
     };
     int num_instruments = sizeof(instruments) / sizeof(instruments[0]);
 
+    char header[128];
+    snprintf(header, sizeof(header), ORC_HEADER_FORMAT, sr, ksmps, nchnls);
+
     // Calculate total length needed
-    size_t total_len = strlen(get_orc_header()) + 1; // +1 for null terminator
+    size_t total_len = strlen(header) + 1; // +1 for null terminator
     for (int i = 0; i < num_instruments; i++) {
         total_len += strlen(instruments[i].body);
     }
@@ -113,7 +138,7 @@ char* get_orchestra_string() {
     }
 
     // Build the string
-    strcpy(orc_string, get_orc_header());
+    strcpy(orc_string, header);
     for (int i = 0; i < num_instruments; i++) {
         strcat(orc_string, instruments[i].body);
     }
@@ -1,15 +1,35 @@
 #ifndef INSTRUMENTS_H
 #define INSTRUMENTS_H
 
+#define NUM_INSTRUMENTS 3 /**< Instruments are numbered 1..NUM_INSTRUMENTS in the orchestra. */
+#define STEM_BUS_MAX 999          /**< Highest stem bus. A note for bus n is sent as instrument "<instr>.<n in 3 digits>". */
+#define STEM_BUS_FORMAT "stem%d"  /**< The name of the audio channel that stem bus n is mixed into. */
+
 /**
  * @brief Assembles the complete Csound orchestra string from individual instrument definitions.
  * 
- * This function concatenates a standard header with all registered instrument
- * ORC code. The caller is responsible for freeing the returned string using free().
+ * This function concatenates a header built from the given engine settings with
+ * all registered instrument ORC code. The caller is responsible for freeing the
+ * returned string using free().
  *
+ * @param sr The audio sample rate in Hz.
+ * @param ksmps The number of samples in one control block.
+ * @param nchnls The number of output channels.
  * @return A dynamically allocated string containing the full orchestra code,
  *         or NULL if memory allocation fails.
  */
-char* get_orchestra_string();
+char* get_orchestra_string(int sr, int ksmps, int nchnls);
+
+/**
+ * @brief Returns how long a note keeps its voice after its duration has ended.
+ *
+ * This is the release of the instrument's linsegr envelope, during which the
+ * voice still costs as much to perform as while it is held.
+ *
+ * @param instrument The instrument number (1..NUM_INSTRUMENTS).
+ * @param duration The note's duration (p3) in seconds.
+ * @return The release time in seconds, or 0 for an unknown instrument.
+ */
+double instrument_release_seconds(int instrument, double duration);
 
 #endif // INSTRUMENTS_H
\ No newline at end of file
@@ -0,0 +1,40 @@
+#include <limits.h>
+#include <string.h>
+
+#include "job_line.h"
+
+int job_line_read(FILE* input, char* line, int size) {
+    if (fgets(line, size, input) == NULL) {
+        return 0;
+    }
+    if (strchr(line, '\n') == NULL && !feof(input)) {
+        // Drain the rest so it is not read as another line.
+        int c;
+        while ((c = fgetc(input)) != EOF && c != '\n') {
+        }
+        return -1;
+    }
+    return 1;
+}
+
+int job_line_split(char* line, char** fields) {
+    static const char* spaces = " \t\n\v\f\r";
+    int count = 0;
+    char* p = line;
+    while (count < JOB_LINE_FIELDS) {
+        p += strspn(p, spaces);
+        if (*p == '\0') {
+            break;
+        }
+        size_t length = strcspn(p, spaces);
+        if (length >= PATH_MAX) {
+            return -1;
+        }
+        fields[count++] = p;
+        p += length;
+        if (*p != '\0') {
+            *p++ = '\0';
+        }
+    }
+    return count;
+}
@@ -0,0 +1,35 @@
+#ifndef JOB_LINE_H
+#define JOB_LINE_H
+
+#include <stdio.h>
+
+// --- Job Lines ---
+// The render server and the batch farm both take jobs as text lines of the
+// form "<score_path> <output_path>". These helpers read and split such
+// lines without fixed-width scanf conversions, so a path can never overrun a
+// PATH_MAX buffer whatever PATH_MAX is on the platform.
+
+#define JOB_LINE_FIELDS 2 // The fields of a job line: the score path and the output path.
+
+/**
+ * @brief Reads one line of a job list.
+ *
+ * A line that does not fit in the buffer is not split into several: the
+ * rest of it is read and discarded, and it is reported as too long.
+ *
+ * @param input The stream to read.
+ * @param line The buffer that receives the line.
+ * @param size The size of the buffer.
+ * @return 1 if a line was read, 0 at the end of the input, -1 if the line was too long.
+ */
+int job_line_read(FILE* input, char* line, int size);
+
+/**
+ * @brief Splits a job line at whitespace into its first JOB_LINE_FIELDS fields, in place.
+ * @param line The line; separators after the fields are overwritten with '\0'.
+ * @param fields Receives a pointer to every field found.
+ * @return The number of fields found, or -1 if a field does not fit in PATH_MAX.
+ */
+int job_line_split(char* line, char** fields);
+
+#endif // JOB_LINE_H
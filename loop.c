@@ -0,0 +1,85 @@
+#include <stdio.h>
+
+#include "loop.h"
+
+int loop_region_build(LoopRegion* region, Track* tracks, int num_tracks, int first_measure, int last_measure) {
+    timeline_init(&region->timeline);
+    region->start = 0.0;
+    region->length = 0.0;
+    if (num_tracks == 0 || first_measure < 0 || last_measure < first_measure) {
+        return -1;
+    }
+
+    // Find where the range starts and ends with the player's seek index.
+    Player player;
+    if (player_init(&player, tracks, num_tracks, 0.0, NULL) != 0) {
+        return -1;
+    }
+    double start = player_measure_time(&player, 0, first_measure);
+    double end = player_measure_time(&player, 0, last_measure + 1);
+    if (end < 0 && start >= 0 && player_measure_time(&player, 0, last_measure) >= 0) {
+        end = player.seek->end_time; // The range runs to the end of the piece.
+    }
+    player_free(&player);
+    if (start < 0 || end <= start) {
+        return -1;
+    }
+
+    if (timeline_build(&region->timeline, tracks, num_tracks, start, end) != 0) {
+        loop_region_free(region);
+        return -1;
+    }
+
+    // Make the notes relative to the range, and stop them at its end so
+    // nothing spills into the next iteration.
+    for (int i = 0; i < region->timeline.count; i++) {
+        PlayerNote* note = &region->timeline.notes[i];
+        note->time -= start;
+        if (note->time + note->duration > end - start) {
+            note->duration = end - start - note->time;
+        }
+    }
+    region->start = start;
+    region->length = end - start;
+    return 0;
+}
+
+void loop_region_free(LoopRegion* region) {
+    timeline_free(&region->timeline);
+}
+
+void looper_start(Looper* looper, const LoopRegion* region, double score_time) {
+    looper->region = region;
+    looper->origin = score_time;
+    looper->iteration = 0;
+    looper->next = 0;
+}
+
+void looper_update(Looper* looper, CSOUND* csound, double score_time, double lookahead) {
+    const LoopRegion* region = looper->region;
+    const Timeline* timeline = &region->timeline;
+    if (timeline->count == 0) {
+        return;
+    }
+
+    double horizon = score_time + lookahead;
+    char score_event[128];
+    for (;;) {
+        // Computed from the iteration count rather than accumulated, so long loops do not drift.
+        double iteration_start = looper->origin + looper->iteration * region->length;
+        const PlayerNote* note = &timeline->notes[looper->next];
+        double due = iteration_start + note->time;
+        if (due >= horizon) {
+            break;
+        }
+
+        double offset = due > score_time ? due - score_time : 0.0;
+        snprintf(score_event, sizeof(score_event), "i%d %.9f %f %f %f", note->instrument, offset, note->duration, note->freq, note->amp);
+        csoundInputMessage(csound, score_event);
+
+        if (++looper->next == timeline->count) {
+            looper->next = 0;
+            looper->iteration++;
+        }
+    }
+}
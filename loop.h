@@ -0,0 +1,71 @@
+#ifndef LOOP_H
+#define LOOP_H
+
+#include <csound.h>
+#include "timeline.h"
+
+// --- Loop Playback ---
+// A measure range is laid out once into a timeline of notes relative to the
+// start of the range. Every iteration replays that list shifted by a whole
+// number of loop lengths, so looping costs no validation, allocation or
+// tempo computation, and iterations join without a gap.
+
+/**
+ * @brief A measure range laid out for looping.
+ */
+typedef struct {
+    Timeline timeline; /**< The notes of the range, with times from its start and durations clipped to its end. */
+    double start;      /**< Where the range starts in the piece, in seconds. */
+    double length;     /**< The length of one iteration in seconds. */
+} LoopRegion;
+
+/**
+ * @brief Replays a loop region on a Csound instance.
+ */
+typedef struct {
+    const LoopRegion* region; /**< The region being looped. */
+    double origin;            /**< The score time at which the first iteration started. */
+    long iteration;           /**< The iteration the next note belongs to, counting from 0. */
+    int next;                 /**< The index of the next note to schedule in the region's timeline. */
+} Looper;
+
+/**
+ * @brief Lays out a range of the first track's measures for looping.
+ * @param region The region to fill.
+ * @param tracks The tracks to play.
+ * @param num_tracks The number of tracks.
+ * @param first_measure The first measure of the range, as a played position of the first track from 0.
+ * @param last_measure The last measure of the range (inclusive).
+ * @return 0 on success, -1 if the range is empty or outside the piece, or memory allocation fails.
+ */
+int loop_region_build(LoopRegion* region, Track* tracks, int num_tracks, int first_measure, int last_measure);
+
+/**
+ * @brief Releases the notes of a loop region.
+ * @param region The region to free.
+ */
+void loop_region_free(LoopRegion* region);
+
+/**
+ * @brief Starts looping a region at the given score time.
+ * @param looper The looper to initialize.
+ * @param region The region to loop. It must outlive the looper.
+ * @param score_time The Csound score time at which the first iteration starts.
+ */
+void looper_start(Looper* looper, const LoopRegion* region, double score_time);
+
+/**
+ * @brief Schedules every note that falls due before score_time + lookahead.
+ *
+ * Each note is sent with its exact offset from score_time as p2, so with a
+ * lookahead of one control block (and Csound's --sample-accurate) notes land
+ * on their exact sample regardless of block boundaries.
+ *
+ * @param looper The looper to advance.
+ * @param csound The Csound instance that receives the notes.
+ * @param score_time The current Csound score time in seconds.
+ * @param lookahead How far ahead to schedule, in seconds.
+ */
+void looper_update(Looper* looper, CSOUND* csound, double score_time, double lookahead);
+
+#endif // LOOP_H
@@ -1,224 +1,680 @@
 #include <csound.h>
+#include <limits.h>
+#include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include "analyze.h"
+#include "engine.h"
+#include "farm.h"
 #include "instrument_piano.h"
-#include "instruments.h"
+#include "loop.h"
+#include "meter.h"
+#include "pcm.h"
+#include "player.h"
+#include "realtime.h"
+#include "regress.h"
+#include "render.h"
+#include "render_cache.h"
 #include "score.h"
+#include "score_file.h"
+#include "score_tables.h"
+#include "server.h"
+#include "stems.h"
+#include "watch.h"
 
-// --- Player Engine Structures ---
+// --- Cleanup Functions ---
+
+void restore_terminal(void) {
+    // Placeholder for potential future terminal state restoration
+}
+
+// --- Command Line ---
 
 /**
- * @brief Holds the real-time playback state for a single track.
- *
- * This structure tracks the current position within the score for a track,
- * allowing the player to know which event to play next and when.
+ * @brief Settings selected on the command line.
  */
 typedef struct {
-    int current_measure;          /**< Index of the current measure being played. */
-    int current_event_in_measure; /**< Index of the current event within the measure. */
-    double next_event_time;       /**< The absolute time in seconds when the next event should be triggered. */
-} TrackState;
+    const EngineProfile* profile; /**< The engine profile to run with. */
+    int threads;                  /**< If > 0, the number of threads Csound performs with, overriding the profile. */
+    const char* output_path;      /**< A sound file to write to, or NULL for the sound card. */
+    const char* score_path;       /**< A score file to play instead of the built-in tracks, or NULL. */
+    const char* piece;            /**< The name of a compiled-in score to play instead of the built-in tracks, or NULL. */
+    const char* render_path;      /**< A WAV file to render to offline, as fast as possible, or NULL. */
+    const char* cache_dir;        /**< With render_path, a directory of cached measures, or NULL. */
+    const char* stems_dir;        /**< A directory to render one stem per track into, or NULL. */
+    const char* remix_dir;        /**< A directory of stems to mix into render_path instead of rendering, or NULL. */
+    const char* mix;              /**< With remix_dir, the gain, pan and mute of each stem, or NULL. */
+    int stream;                   /**< If set, render offline as raw PCM to stream_fd. */
+    PcmFormat stream_format;      /**< The sample encoding of the PCM stream. */
+    int stream_fd;                /**< The descriptor the PCM stream is written to. */
+    int calibrate;                /**< If set, measure block cost and exit instead of playing. */
+    const char* calibrate_costs_path; /**< If set, measure the cost of every instrument's voices, write it here and exit. */
+    int analyze;                  /**< If set, print the predicted cost of the score and exit instead of playing. */
+    const char* costs_path;       /**< With analyze, voice costs to estimate render time and CPU load from, or NULL. */
+    int list_profiles;            /**< If set, print the available profiles and exit. */
+    int serve;                    /**< If set, run the render server instead of playing. */
+    const char* socket_path;      /**< The UNIX socket the server listens on, or NULL for stdin. */
+    const char* manifest_path;    /**< If set, render the jobs of this manifest on worker processes and exit. */
+    int workers;                  /**< The number of concurrent render jobs in server or batch mode. */
+    int start_measure;            /**< If > 0, begin at this measure of the first track (1-based). */
+    double start_time;            /**< If > 0, begin this many seconds into the piece. */
+    int loop_first;               /**< If > 0, loop playback from this measure of the first track (1-based). */
+    int loop_last;                /**< The last measure of the loop (inclusive). */
+    const char* meter_path;       /**< Where to write the level report of the render, or NULL for the default. */
+    int preload;                  /**< If set, load the whole piece into Csound as one score before rendering. */
+    const char* export_sco_path;  /**< A file to write the piece to as a Csound score, or NULL. */
+    const char* sco_path;         /**< A score written by --export-sco to render instead of the tracks, or NULL. */
+    int realtime_safe;            /**< If set, play with everything preallocated and nothing printed or allocated between blocks. */
+    int watch;                    /**< If set, reload score_path whenever it is saved during playback. */
+    int regress;                  /**< If 1, check the bundled scores against golden renders; if 2, record them. */
+    const char* golden_path;      /**< The golden file used by regress. */
+    double time_tolerance;        /**< The slowdown over the golden render time that counts as a regression. */
+} Options;
+
+static void print_usage(const char* program) {
+    printf("Usage: %s [options]\n", program);
+    printf("  --profile NAME     Engine profile: live, balanced or offline (default: %s)\n", DEFAULT_PROFILE_NAME);
+    printf("  --threads N        Perform on N threads (Csound's -j), overriding the profile\n");
+    printf("  --output FILE      Write audio to FILE instead of the sound card\n");
+    printf("  --score FILE       Play the tracks of a score file instead of the built-in tracks\n");
+    printf("  --piece NAME       Play a score compiled into the binary from scores/NAME.score\n");
+    printf("  --render FILE      Render offline to a WAV file as fast as possible\n");
+    printf("  --cache DIR        With --render, reuse measures cached in DIR and only render changed ones\n");
+    printf("  --stems DIR        Render every track offline to its own stem file in DIR\n");
+    printf("  --remix DIR        Mix the stems in DIR into the --render file without synthesizing\n");
+    printf("  --mix SPEC         With --remix, per-stem settings such as 1:-3:0.4,2:mute\n");
+    printf("  --stream FORMAT    Render offline as raw PCM to stdout: native, f32 or s16\n");
+    printf("  --stream-fd N      With --stream, write to descriptor N instead of stdout\n");
+    printf("  --meter FILE       Write the level report of --render or --stream to FILE (default: the WAV file + %s)\n", METER_REPORT_SUFFIX);
+    printf("  --preload          With --render or --stream, hand Csound the whole piece as one score before rendering\n");
+    printf("  --export-sco FILE  Write the piece to FILE as a standalone Csound score\n");
+    printf("  --sco FILE         With --render or --stream, render a score written by --export-sco instead of the tracks\n");
+    printf("  --start-measure N  Begin playback or rendering at measure N of the first track\n");
+    printf("  --start-time SECS  Begin playback or rendering SECS seconds into the piece\n");
+    printf("  --loop A:B         Loop measures A to B of the first track until interrupted\n");
+    printf("  --realtime-safe    Play without allocating, locking or printing on the audio path\n");
+    printf("  --watch            With --score, play edits of the score file as soon as it is saved\n");
+    printf("  --list-profiles    Show the settings of every profile\n");
+    printf("  --calibrate        Measure block cost and recommend the smallest safe ksmps\n");
+    printf("  --calibrate-costs FILE  Measure the render cost of every instrument's voices and write them to FILE\n");
+    printf("  --analyze          Report the note density, voice counts and cost of the score without playing it\n");
+    printf("  --costs FILE       With --analyze, estimate render time and CPU load from measured voice costs\n");
+    printf("  --serve            Run a render server reading '<score> <output.wav>' jobs from stdin\n");
+    printf("  --socket PATH      With --serve, accept jobs on a UNIX socket instead of stdin\n");
+    printf("  --batch MANIFEST   Render every '<score> <output.wav>' line of MANIFEST on worker processes\n");
+    printf("  --workers N        With --serve or --batch, render up to N jobs at once (default: CPU count)\n");
+    printf("  --regress          Render the bundled scores and compare them with golden renders\n");
+    printf("  --regress-update   Record the bundled scores as the new golden renders\n");
+    printf("  --golden FILE      With --regress, the golden file (default: %s)\n", REGRESS_DEFAULT_GOLDEN);
+    printf("  --time-tolerance F With --regress, fail if a render is more than F slower (default: %.2f)\n", REGRESS_DEFAULT_TIME_TOLERANCE);
+    printf("  --help             Show this message\n");
+}
 
 /**
- * @brief Defines the type of a track, which determines how its events are interpreted.
+ * @brief Parses the command line into an Options structure.
+ * @return 0 on success, 1 if the program should exit successfully, -1 on error.
  */
-typedef enum {
-    TRACK_MELODY, /**< A monophonic melody line where each event is a single note. */
-    TRACK_CHORD   /**< A polyphonic chord line where each event represents a full chord. */
-} TrackType;
+static int parse_options(int argc, char** argv, Options* options) {
+    memset(options, 0, sizeof(*options));
+    options->profile = engine_find_profile(DEFAULT_PROFILE_NAME);
+    options->stream_fd = STDOUT_FILENO;
+    options->golden_path = REGRESS_DEFAULT_GOLDEN;
+    options->time_tolerance = REGRESS_DEFAULT_TIME_TOLERANCE;
+    options->workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (options->workers < 1) {
+        options->workers = 1;
+    }
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        if (strcmp(arg, "--profile") == 0 && i + 1 < argc) {
+            options->profile = engine_find_profile(argv[++i]);
+            if (options->profile == NULL) {
+                fprintf(stderr, "Error: Unknown profile '%s'.\n", argv[i]);
+                engine_list_profiles();
+                return -1;
+            }
+        } else if (strcmp(arg, "--threads") == 0 && i + 1 < argc) {
+            options->threads = atoi(argv[++i]);
+            if (options->threads < 1) {
+                fprintf(stderr, "Error: --threads needs a positive number.\n");
+                return -1;
+            }
+        } else if (strcmp(arg, "--output") == 0 && i + 1 < argc) {
+            options->output_path = argv[++i];
+        } else if (strcmp(arg, "--score") == 0 && i + 1 < argc) {
+            options->score_path = argv[++i];
+        } else if (strcmp(arg, "--piece") == 0 && i + 1 < argc) {
+            options->piece = argv[++i];
+        } else if (strcmp(arg, "--render") == 0 && i + 1 < argc) {
+            options->render_path = argv[++i];
+        } else if (strcmp(arg, "--cache") == 0 && i + 1 < argc) {
+            options->cache_dir = argv[++i];
+        } else if (strcmp(arg, "--stems") == 0 && i + 1 < argc) {
+            options->stems_dir = argv[++i];
+        } else if (strcmp(arg, "--remix") == 0 && i + 1 < argc) {
+            options->remix_dir = argv[++i];
+        } else if (strcmp(arg, "--mix") == 0 && i + 1 < argc) {
+            options->mix = argv[++i];
+        } else if (strcmp(arg, "--stream") == 0 && i + 1 < argc) {
+            options->stream = 1;
+            if (pcm_format_from_name(argv[++i], &options->stream_format) != 0) {
+                fprintf(stderr, "Error: Unknown PCM format '%s' (use native, f32 or s16).\n", argv[i]);
+                return -1;
+            }
+        } else if (strcmp(arg, "--stream-fd") == 0 && i + 1 < argc) {
+            options->stream_fd = atoi(argv[++i]);
+        } else if (strcmp(arg, "--meter") == 0 && i + 1 < argc) {
+            options->meter_path = argv[++i];
+        } else if (strcmp(arg, "--preload") == 0) {
+            options->preload = 1;
+        } else if (strcmp(arg, "--export-sco") == 0 && i + 1 < argc) {
+            options->export_sco_path = argv[++i];
+        } else if (strcmp(arg, "--sco") == 0 && i + 1 < argc) {
+            options->sco_path = argv[++i];
+        } else if (strcmp(arg, "--start-measure") == 0 && i + 1 < argc) {
+            options->start_measure = atoi(argv[++i]);
+            if (options->start_measure < 1) {
+                fprintf(stderr, "Error: --start-measure needs a measure number from 1.\n");
+                return -1;
+            }
+        } else if (strcmp(arg, "--start-time") == 0 && i + 1 < argc) {
+            options->start_time = atof(argv[++i]);
+            if (options->start_time < 0) {
+                fprintf(stderr, "Error: --start-time cannot be negative.\n");
+                return -1;
+            }
+        } else if (strcmp(arg, "--loop") == 0 && i + 1 < argc) {
+            if (sscanf(argv[++i], "%d:%d", &options->loop_first, &options->loop_last) != 2
+                || options->loop_first < 1 || options->loop_last < options->loop_first) {
+                fprintf(stderr, "Error: --loop needs a measure range such as 5:8.\n");
+                return -1;
+            }
+        } else if (strcmp(arg, "--list-profiles") == 0) {
+            options->list_profiles = 1;
+        } else if (strcmp(arg, "--calibrate") == 0) {
+            options->calibrate = 1;
+        } else if (strcmp(arg, "--calibrate-costs") == 0 && i + 1 < argc) {
+            options->calibrate_costs_path = argv[++i];
+        } else if (strcmp(arg, "--watch") == 0) {
+            options->watch = 1;
+        } else if (strcmp(arg, "--realtime-safe") == 0) {
+            options->realtime_safe = 1;
+        } else if (strcmp(arg, "--analyze") == 0) {
+            options->analyze = 1;
+        } else if (strcmp(arg, "--costs") == 0 && i + 1 < argc) {
+            options->costs_path = argv[++i];
+        } else if (strcmp(arg, "--serve") == 0) {
+            options->serve = 1;
+        } else if (strcmp(arg, "--socket") == 0 && i + 1 < argc) {
+            options->socket_path = argv[++i];
+        } else if (strcmp(arg, "--batch") == 0 && i + 1 < argc) {
+            options->manifest_path = argv[++i];
+        } else if (strcmp(arg, "--workers") == 0 && i + 1 < argc) {
+            options->workers = atoi(argv[++i]);
+            if (options->workers < 1) {
+                fprintf(stderr, "Error: --workers needs a positive number.\n");
+                return -1;
+            }
+        } else if (strcmp(arg, "--regress") == 0) {
+            options->regress = 1;
+        } else if (strcmp(arg, "--regress-update") == 0) {
+            options->regress = 2;
+        } else if (strcmp(arg, "--golden") == 0 && i + 1 < argc) {
+            options->golden_path = argv[++i];
+        } else if (strcmp(arg, "--time-tolerance") == 0 && i + 1 < argc) {
+            options->time_tolerance = atof(argv[++i]);
+            if (options->time_tolerance < 0) {
+                fprintf(stderr, "Error: --time-tolerance cannot be negative.\n");
+                return -1;
+            }
+        } else if (strcmp(arg, "--help") == 0) {
+            print_usage(argv[0]);
+            return 1;
+        } else {
+            fprintf(stderr, "Error: Unknown or incomplete option '%s'.\n", arg);
+            print_usage(argv[0]);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// --- Start Position ---
 
 /**
- * @brief Represents a complete musical track, including its score and metadata.
- *
- * A track is a sequence of measures played by a specific instrument.
+ * @brief Converts --start-measure or --start-time into seconds from the beginning of the piece.
+ * @return 0 on success, -1 if the measure does not exist.
  */
-typedef struct {
-    const char* name;  /**< The name of the track, used for logging and identification. */
-    TrackType type;    /**< The type of the track (e.g., melody or chord). */
-    int instrument;    /**< The Csound instrument number (from the orchestra) to use for this track. */
-    Measure* measures; /**< A pointer to an array of Measure structures that make up the track's score. */
-    int measure_count; /**< The total number of measures in the track. */
-} Track;
+static int resolve_start(const Options* options, Track* tracks, int num_tracks, double* position) {
+    *position = options->start_time;
+    if (options->start_measure == 0) {
+        return 0;
+    }
+    Player player;
+    if (player_init(&player, tracks, num_tracks, 0.0, NULL) != 0) {
+        fprintf(stderr, "Error: Failed to allocate memory for track states.\n");
+        return -1;
+    }
+    *position = player_measure_time(&player, 0, options->start_measure - 1);
+    player_free(&player);
+    if (*position < 0) {
+        fprintf(stderr, "Error: The first track has no measure %d.\n", options->start_measure);
+        return -1;
+    }
+    return 0;
+}
 
-// --- Cleanup Functions ---
+// --- Loop Playback ---
 
 /**
- * @brief Validates the score to ensure measures have the correct number of beats.
- * @param tracks Array of tracks to validate.
- * @param num_tracks Number of tracks in the array.
+ * @brief Loops the selected measure range on a started instance until Csound stops.
+ * @return The process exit code.
  */
-void validate_score(Track* tracks, int num_tracks) {
-    printf("Validating score...\n");
-    for (int t = 0; t < num_tracks; t++) {
-        for (int m = 0; m < tracks[t].measure_count; m++) {
-            Measure* measure = &tracks[t].measures[m];
-            double total_duration_in_quarter_notes = 0;
-            for (int e = 0; e < measure->event_count; e++) {
-                total_duration_in_quarter_notes += measure->events[e].duration;
-            }
+static int play_loop(const Options* options, CSOUND* csound, Track* tracks, int num_tracks) {
+    LoopRegion region;
+    if (loop_region_build(&region, tracks, num_tracks, options->loop_first - 1, options->loop_last - 1) != 0) {
+        fprintf(stderr, "Error: Cannot loop measures %d-%d of the first track.\n", options->loop_first, options->loop_last);
+        return 1;
+    }
+    printf("Looping measures %d-%d (%.3f seconds, %d notes per pass). Press Ctrl+C to stop.\n",
+        options->loop_first, options->loop_last, region.length, region.timeline.count);
 
-            // Calculate the expected duration of the measure in quarter notes.
-            // e.g., for 3/8 time, this is 3 * (4.0 / 8) = 1.5 quarter notes.
-            // e.g., for 4/4 time, this is 4 * (4.0 / 4) = 4.0 quarter notes.
-            double expected_duration = (double)measure->beats_per_measure * (4.0 / (double)measure->beat_unit);
+    // Schedule one block ahead so every note can be placed on its exact sample.
+    double block = (double)csoundGetKsmps(csound) / csoundGetSr(csound);
+    Looper looper;
+    looper_start(&looper, &region, csoundGetScoreTime(csound));
+    looper_update(&looper, csound, csoundGetScoreTime(csound), block);
+    while (csoundPerformKsmps(csound) == 0) {
+        looper_update(&looper, csound, csoundGetScoreTime(csound), block);
+    }
+    loop_region_free(&region);
+    return 0;
+}
 
-            // Compare with a small tolerance for floating point inaccuracies.
-            if (fabs(total_duration_in_quarter_notes - expected_duration) > 1e-6) {
-                printf("  [WARNING] Track '%s', Measure %d: For %d/%d time, expected total duration of %.2f quarter notes, but found %.2f.\n",
-                    tracks[t].name, m + 1, measure->beats_per_measure, measure->beat_unit, expected_duration, total_duration_in_quarter_notes);
+// --- Offline Rendering ---
+
+/**
+ * @brief Prints the predicted cost of the tracks.
+ * @return The process exit code.
+ */
+static int analyze_offline(const Options* options, Track* tracks, int num_tracks) {
+    VoiceCosts costs;
+    if (options->costs_path != NULL && voice_costs_load(options->costs_path, &costs) != 0) {
+        return 1;
+    }
+    ScoreAnalysis analysis;
+    if (analyze_score(tracks, num_tracks, options->costs_path != NULL ? &costs : NULL, &analysis) != 0) {
+        fprintf(stderr, "Error: Failed to allocate memory for the score analysis.\n");
+        return 1;
+    }
+    if (options->costs_path != NULL && strcmp(costs.profile, options->profile->name) != 0) {
+        printf("Note: the voice costs were measured with profile '%s', not '%s'.\n", costs.profile, options->profile->name);
+    }
+    analysis_print(&analysis, stdout);
+    analysis_free(&analysis);
+    return 0;
+}
+
+/**
+ * @brief Renders the tracks to options->render_path, or streams them as PCM, without real-time pacing.
+ * @param log Where progress is reported (stderr when the audio itself goes to stdout).
+ * @return The process exit code.
+ */
+static int render_offline(const Options* options, Track* tracks, int num_tracks, double start, FILE* log) {
+    char* score = NULL;
+    if (options->sco_path != NULL) {
+        if ((score = render_load_score(options->sco_path)) == NULL) {
+            return 1;
+        }
+    } else if (options->preload || options->export_sco_path != NULL) {
+        int notes = 0;
+        score = render_build_score(tracks, num_tracks, start, options->profile->sr, options->profile->ksmps, &notes);
+        if (score == NULL) {
+            return 1;
+        }
+        if (options->export_sco_path != NULL) {
+            if (render_save_score(score, options->export_sco_path) != 0) {
+                free(score);
+                return 1;
             }
+            fprintf(log, "Score of %d notes written to '%s' for profile '%s'.\n", notes, options->export_sco_path, options->profile->name);
         }
     }
-}
+    if (options->render_path == NULL && !options->stream && options->stems_dir == NULL) {
+        free(score);
+        return 0;
+    }
 
-void restore_terminal(void) {
-    // Placeholder for potential future terminal state restoration
-}
+    // The score has been exported; stems and cached renders lay out the tracks themselves.
+    if (options->stems_dir != NULL || (options->cache_dir != NULL && !options->stream)) {
+        free(score);
+        score = NULL;
+    }
 
-void cleanup(CSOUND* csound) {
-    csoundStop(csound);
-    csoundDestroy(csound);
+    if (options->stems_dir != NULL) {
+        if (start > 0) {
+            fprintf(stderr, "Error: --stems always renders the whole piece and cannot be combined with a start position.\n");
+            return 1;
+        }
+        fprintf(log, "Rendering %d stems to '%s' with profile '%s'...\n", num_tracks, options->stems_dir, options->profile->name);
+    } else if (options->stream) {
+        // A reader that goes away must end the render with an error, not kill the process.
+        signal(SIGPIPE, SIG_IGN);
+        fprintf(log, "Streaming raw PCM to descriptor %d with profile '%s'...\n", options->stream_fd, options->profile->name);
+    } else {
+        fprintf(log, "Rendering to '%s' with profile '%s'...\n", options->render_path, options->profile->name);
+    }
+
+    if (options->cache_dir != NULL && !options->stream && options->stems_dir == NULL && start > 0) {
+        fprintf(stderr, "Error: --cache always renders the whole piece and cannot be combined with a start position.\n");
+        return 1;
+    }
+
+    Meter meter;
+    if (meter_init(&meter, options->profile->nchnls, options->profile->sr) != 0) {
+        fprintf(stderr, "Error: Failed to allocate memory for the level meter.\n");
+        free(score);
+        return 1;
+    }
+    int result = 1;
+    CSOUND* csound = NULL;
+    if (options->cache_dir != NULL && !options->stream && options->stems_dir == NULL) {
+        RenderCacheStats stats;
+        if (render_cache_render(options->profile, tracks, num_tracks, options->cache_dir, options->render_path, &stats, &meter) == 0) {
+            fprintf(log, "Render complete: %d measures, %d from cache, %d rendered.\n", stats.segments, stats.hits, stats.rendered);
+            result = 0;
+        }
+    } else if ((csound = engine_create_offline(options->profile)) != NULL && csoundStart(csound) == 0) {
+        int rendered = options->stems_dir != NULL
+            ? stems_render(csound, tracks, num_tracks, options->stems_dir)
+            : score != NULL && options->stream
+            ? render_score_to_pcm(csound, score, options->stream_fd, options->stream_format, &meter)
+            : score != NULL
+            ? render_score_to_wav(csound, score, options->render_path, WAV_PCM16, &meter)
+            : options->stream
+            ? render_to_pcm(csound, tracks, num_tracks, start, options->stream_fd, options->stream_format, &meter)
+            : render_to_wav(csound, tracks, num_tracks, start, options->render_path, WAV_PCM16, &meter);
+        if (rendered == 0) {
+            fprintf(log, "Render complete.\n");
+            result = 0;
+        }
+    }
+    if (result == 0 && options->stems_dir != NULL) {
+        fprintf(log, "Levels of the mix and every stem written to '%s/%s'.\n", options->stems_dir, STEMS_LEVELS_FILE);
+    } else if (result == 0) {
+        meter_print(&meter, log);
+        char report[PATH_MAX + sizeof(METER_REPORT_SUFFIX)];
+        const char* report_path = options->meter_path;
+        if (report_path == NULL && !options->stream) {
+            snprintf(report, sizeof(report), "%s%s", options->render_path, METER_REPORT_SUFFIX);
+            report_path = report;
+        }
+        if (report_path != NULL && meter_save(report_path, &meter, NULL, 0) != 0) {
+            result = 1;
+        }
+    }
+    meter_free(&meter);
+    engine_destroy(csound);
+    free(score);
+    return result;
 }
 
 // --- Main Program ---
 
-int main() {
-    // 1. Initialization
-    generate_piano_frequencies();
-
-    CSOUND* csound = csoundCreate(NULL);
-    atexit(restore_terminal);
-    if (csound == NULL) {
-        fprintf(stderr, "Error: Failed to create Csound instance.\n");
+int main(int argc, char** argv) {
+    Options options;
+    int parsed = parse_options(argc, argv, &options);
+    if (parsed != 0) {
+        return parsed < 0 ? 1 : 0;
+    }
+    EngineProfile profile = *options.profile;
+    if (options.threads > 0) {
+        profile.threads = options.threads;
+    }
+    options.profile = &profile;
+    if (options.meter_path != NULL && ((options.render_path == NULL && !options.stream) || options.stems_dir != NULL
+            || options.remix_dir != NULL || options.manifest_path != NULL || options.serve)) {
+        fprintf(stderr, "Error: --meter names the level report of --render or --stream; it cannot be combined with --stems, --remix, --serve or --batch.\n");
         return 1;
     }
+    if (options.list_profiles) {
+        engine_list_profiles();
+        return 0;
+    }
+    if (options.calibrate) {
+        return engine_calibrate(options.profile) > 0 ? 0 : 1;
+    }
+    if (options.calibrate_costs_path != NULL) {
+        VoiceCosts costs;
+        if (analyze_measure_costs(options.profile, &costs) != 0 || voice_costs_save(&costs, options.calibrate_costs_path) != 0) {
+            return 1;
+        }
+        printf("Voice costs written to '%s'.\n", options.calibrate_costs_path);
+        return 0;
+    }
+    if (options.remix_dir != NULL) {
+        if (options.render_path == NULL) {
+            fprintf(stderr, "Error: --remix needs --render FILE for the mix.\n");
+            return 1;
+        }
+        return stems_remix(options.remix_dir, options.mix, options.render_path) == 0 ? 0 : 1;
+    }
 
-    // 2. Compile Orchestra
-    // Set output to a WAV file instead of real-time audio.
-    csoundSetOption(csound, "-odac");
-    char* orc = get_orchestra_string();
-    if (orc == NULL) {
-        fprintf(stderr, "Error: Failed to allocate memory for orchestra string.\n");
-        cleanup(csound);
+    // 1. Initialization
+    generate_piano_frequencies();
+    if (generate_chord_pool() != 0) {
+        fprintf(stderr, "Error: Failed to build the chord pool.\n");
         return 1;
     }
+    atexit(free_chord_pool);
+    atexit(restore_terminal);
 
-    if (csoundCompileOrc(csound, orc) != 0) {
-        fprintf(stderr, "Error: Orchestra compilation failed.\n");
-        free(orc);
-        cleanup(csound);
-        return 1;
+    if (options.regress) {
+        return regress_run(options.golden_path, options.regress == 2, options.time_tolerance, stdout) == 0 ? 0 : 1;
+    }
+    if (options.manifest_path != NULL) {
+        return farm_run(options.profile, options.manifest_path, options.workers);
+    }
+    if (options.serve) {
+        return server_run(options.profile, options.socket_path, options.workers);
     }
 
-    // 3. Setup Tracks
+    // 2. Setup Tracks
     Track all_tracks[] = {
-        // {"Piano Melody",  TRACK_MELODY, 1, melody_measures, MELODY_MEASURE_COUNT}, // Instrument 1: Piano
-        // {"Piano Chords",  TRACK_CHORD,  1, chord_measures,  CHORD_MEASURE_COUNT},  // Instrument 1: Piano
-        // {"Viola Chords",  TRACK_CHORD,  3, chord_measures,  CHORD_MEASURE_COUNT}, // Instrument 3: Viola
-        // {"Piano Bass",    TRACK_MELODY, 1, bass_measures,   BASS_MEASURE_COUNT}
-        {"Piano Melody", TRACK_MELODY, 1, north_measures, NORTH_MEASURE_COUNT},
+        // {"Piano Melody",  TRACK_MELODY, 1, melody_measures, MELODY_MEASURE_COUNT, melody_sections, MELODY_SECTION_COUNT, NULL}, // Instrument 1: Piano
+        // {"Piano Chords",  TRACK_CHORD,  1, chord_measures,  CHORD_MEASURE_COUNT,  chord_sections,  CHORD_SECTION_COUNT, NULL},  // Instrument 1: Piano
+        // {"Viola Chords",  TRACK_CHORD,  3, chord_measures,  CHORD_MEASURE_COUNT,  chord_sections,  CHORD_SECTION_COUNT, NULL}, // Instrument 3: Viola
+        // {"Piano Bass",    TRACK_MELODY, 1, bass_measures,   BASS_MEASURE_COUNT,   bass_sections,   BASS_SECTION_COUNT, NULL}
+        {"Piano Melody", TRACK_MELODY, 1, north_measures, NORTH_MEASURE_COUNT, NULL, 0, NULL},
     };
+    Track* tracks = all_tracks;
     int num_tracks = sizeof(all_tracks) / sizeof(Track);
 
-    // Validate score before playing
-    validate_score(all_tracks, num_tracks);
+    if (options.piece != NULL) {
+        if (options.score_path != NULL) {
+            fprintf(stderr, "Error: --piece and --score both choose the score; give only one.\n");
+            return 1;
+        }
+        const CompiledScore* piece = compiled_score_find(options.piece);
+        if (piece == NULL) {
+            fprintf(stderr, "Error: No score named '%s' was compiled in. Available:", options.piece);
+            for (int i = 0; i < COMPILED_SCORE_COUNT; i++) {
+                fprintf(stderr, " %s", compiled_scores[i].name);
+            }
+            fprintf(stderr, "\n");
+            return 1;
+        }
+        tracks = piece->tracks;
+        num_tracks = piece->track_count;
+    }
+
+    ScoreFile score_file = {0};
+    if (options.score_path != NULL) {
+        if (score_file_load(options.score_path, &score_file) != 0) {
+            return 1;
+        }
+        tracks = score_file.tracks;
+        num_tracks = score_file.track_count;
+    }
+
+    // Keep stdout clean when it carries the audio stream.
+    FILE* log = (options.stream && options.stream_fd == STDOUT_FILENO) ? stderr : stdout;
+
+    // Validate score before playing (a --sco score is rendered without the tracks)
+    if (options.sco_path == NULL) {
+        validate_score(tracks, num_tracks, log);
+    }
+
+    if (options.analyze) {
+        int result = analyze_offline(&options, tracks, num_tracks);
+        score_file_free(&score_file);
+        return result;
+    }
+
+    double start = 0.0;
+    if (resolve_start(&options, tracks, num_tracks, &start) != 0) {
+        score_file_free(&score_file);
+        return 1;
+    }
+    if (start > 0) {
+        fprintf(log, "Starting %.3f seconds into the piece.\n", start);
+    }
+
+    int offline = options.render_path != NULL || options.stream || options.stems_dir != NULL || options.export_sco_path != NULL;
+    if (options.loop_first > 0 && offline) {
+        fprintf(stderr, "Error: --loop plays until interrupted and cannot be combined with --render, --stream or --stems.\n");
+        score_file_free(&score_file);
+        return 1;
+    }
+    if ((options.preload || options.sco_path != NULL) && ((options.render_path == NULL && !options.stream)
+            || options.stems_dir != NULL || (options.cache_dir != NULL && !options.stream))) {
+        fprintf(stderr, "Error: --preload and --sco need --render or --stream and cannot be combined with --stems or --cache.\n");
+        score_file_free(&score_file);
+        return 1;
+    }
+    if (options.sco_path != NULL && (options.export_sco_path != NULL || start > 0)) {
+        fprintf(stderr, "Error: --sco renders a score as it was exported; it cannot be combined with --export-sco or a start position.\n");
+        score_file_free(&score_file);
+        return 1;
+    }
+    if (options.realtime_safe && (offline || options.loop_first > 0 || options.watch)) {
+        // A reloaded score can need more voices than were preallocated for the original one.
+        fprintf(stderr, "Error: --realtime-safe applies to live playback and cannot be combined with --render, --stream, --stems, --loop or --watch.\n");
+        score_file_free(&score_file);
+        return 1;
+    }
+    if (options.watch && (options.score_path == NULL || offline || options.loop_first > 0)) {
+        fprintf(stderr, "Error: --watch needs --score and live playback; it cannot be combined with --render, --stream, --stems or --loop.\n");
+        score_file_free(&score_file);
+        return 1;
+    }
+    if (offline) {
+        int result = render_offline(&options, tracks, num_tracks, start, log);
+        score_file_free(&score_file);
+        return result;
+    }
 
-    // 4. Setup Real-time Player State
-    TrackState* track_states = (TrackState*)calloc(num_tracks, sizeof(TrackState));
-    if (track_states == NULL) {
+    // 3. Create Csound and compile the orchestra with the selected profile
+    char output_option[1024];
+    if (options.output_path != NULL) {
+        snprintf(output_option, sizeof(output_option), "-o%s", options.output_path);
+    } else {
+        snprintf(output_option, sizeof(output_option), "-odac");
+    }
+    printf("Using profile '%s' (sr=%d, ksmps=%d, threads=%d).\n",
+        options.profile->name, options.profile->sr, options.profile->ksmps, options.profile->threads);
+    CSOUND* csound = engine_create(options.profile, output_option);
+    if (csound == NULL) {
+        score_file_free(&score_file);
+        return 1;
+    }
+    if (options.loop_first > 0) {
+        // Let looped notes start mid-block instead of at the next block boundary.
+        csoundSetOption(csound, "--sample-accurate");
+        int result = csoundStart(csound) == 0 ? play_loop(&options, csound, tracks, num_tracks) : 1;
+        score_file_free(&score_file);
+        engine_destroy(csound);
+        return result;
+    }
+
+    // 4. Setup Real-time Player State. Everything is allocated before csoundStart(),
+    // which starts at score time 0.
+    Player player;
+    if (player_init(&player, tracks, num_tracks, 0.0, stdout) != 0) {
         fprintf(stderr, "Error: Failed to allocate memory for track states.\n");
-        free(orc);
-        cleanup(csound);
+        score_file_free(&score_file);
+        engine_destroy(csound);
+        return 1;
+    }
+    RtLog* rt_log = NULL;
+    if (options.realtime_safe) {
+        // The seek index is laid out here too, so a start position does not allocate after csoundStart().
+        if ((start > 0 && player_prepare_seek(&player) != 0) || rt_preallocate(csound, tracks, num_tracks) != 0
+            || (rt_log = rt_log_create(RT_LOG_CAPACITY, stdout)) == NULL) {
+            fprintf(stderr, "Error: Failed to prepare realtime-safe playback.\n");
+            player_free(&player);
+            score_file_free(&score_file);
+            engine_destroy(csound);
+            return 1;
+        }
+        player.rt_log = rt_log;
+        player.score_events = 1;
+        printf("Realtime-safe mode: instances preallocated, logging from a separate thread.\n");
+    }
+
+    ScoreWatch* watch = NULL;
+    if (options.watch && (watch = score_watch_start(options.score_path, &score_file, stdout)) == NULL) {
+        player_free(&player);
+        rt_log_destroy(rt_log);
+        score_file_free(&score_file);
+        engine_destroy(csound);
         return 1;
     }
-    double current_bpm = 120.0; // Default starting BPM
-    double max_end_time = 0.0;  // Track the time the very last note will end.
 
     // 5. Real-time Performance Loop
     printf("\nStarting Csound playback...\n");
-    int performance_running = 1;
+    int result = 0;
     if (csoundStart(csound) == 0) {
+        if (options.realtime_safe) {
+            // Playback starts once the warm-up's silent blocks are over.
+            result = rt_warm_up(csound, tracks, num_tracks) == 0 ? 0 : 1;
+            player.start_time = csoundGetScoreTime(csound);
+        }
+        if (result == 0 && start > 0 && player_seek(&player, csound, start) != 0) {
+            fprintf(stderr, "Error: Cannot start at %.3f seconds, which is outside the piece.\n", start);
+            result = 1;
+        }
+
         // The loop continues as long as there are events to schedule OR
         // the score time has not yet reached the end of the last note.
-        while ((performance_running || csoundGetScoreTime(csound) < max_end_time) && csoundPerformKsmps(csound) == 0) {
-            double current_time_sec = csoundGetScoreTime(csound);
-
-            if (performance_running) {
-                performance_running = 0; // Assume finished unless a track is still active
+        while (result == 0 && !player_finished(&player, csoundGetScoreTime(csound)) && csoundPerformKsmps(csound) == 0) {
+            if (options.realtime_safe) {
+                rt_enter();
             }
-            for (int t = 0; t < num_tracks; t++) {
-                Track* track = &all_tracks[t];
-                TrackState* ts = &track_states[t];
-
-                if (ts->current_measure >= track->measure_count) {
-                    continue; // This track is finished
-                }
-                if (performance_running == 0) {
-                    performance_running = 1; // At least one track is still active
-                }
-
-                if (current_time_sec >= ts->next_event_time) {
-                    Measure* measure = &track->measures[ts->current_measure];
-
-                    // Check for BPM change at the start of a measure (only for the first track to avoid conflicts)
-                    if (t == 0 && ts->current_event_in_measure == 0 && measure->bpm > 0 && current_bpm != measure->bpm) {
-                        current_bpm = measure->bpm;
-                        printf("\n--- Tempo Change! New BPM: %.1f ---\n", current_bpm);
-                    }
-
-                    MusicEvent event = measure->events[ts->current_event_in_measure];
-
-                    // Calculate duration in seconds based on CURRENT BPM
-                    double quarter_note_sec = 60.0 / current_bpm;
-                    double duration_in_sec = event.duration * quarter_note_sec;
-
-                    if (event.value != REST) {
-                        char score_event[128];
-                        if (track->type == TRACK_MELODY) {
-                            double freq = get_piano_frequency(event.value);
-                            sprintf(score_event, "i%d %f %f %f %f", track->instrument, 0.0, duration_in_sec, freq, 0.5);
-                            csoundInputMessage(csound, score_event);
-                        }
-                        else if (track->type == TRACK_CHORD) {
-                            const struct Chord* c = get_piano_chord(event.value);
-                            if (c) {
-                                // Loop through up to 4 notes in the chord.
-                                // Stop if a NO_NOTE sentinel is found.
-                                for (int j = 0; j < 4 && c->indices[j] != NO_NOTE; j++) {
-                                    PianoKey key = c->indices[j];
-                                    double freq = get_piano_frequency(key);
-                                    sprintf(score_event, "i%d %f %f %f %f", track->instrument, 0.0, duration_in_sec, freq, 0.2);
-                                    csoundInputMessage(csound, score_event);
-                                }
-                            }
-                        }
-                    }
-
-                    // Schedule the next event for this track
-                    ts->next_event_time += duration_in_sec;
-                    // Update the maximum end time for the entire piece
-                    if (ts->next_event_time > max_end_time) {
-                        max_end_time = ts->next_event_time;
-                    }
-
-                    ts->current_event_in_measure++;
-                    if (ts->current_event_in_measure >= measure->event_count) {
-                        ts->current_event_in_measure = 0;
-                        ts->current_measure++;
-                    }
-                }
+            if (watch != NULL) {
+                score_watch_apply(watch, &player, csoundGetScoreTime(csound));
             }
+            player_update(&player, csound, csoundGetScoreTime(csound));
+            rt_leave();
         }
     }
+    player_free(&player);
+    score_watch_stop(watch);
+    rt_log_destroy(rt_log);
+    if (result != 0) {
+        score_file_free(&score_file);
+        engine_destroy(csound);
+        return result;
+    }
 
     // sleep(2);
     // 6. Clean up resources
     printf("\nPlayback finished. Cleaning up Csound resources.\n");
-    free(orc);
-    free(track_states);
-    cleanup(csound);
+    score_file_free(&score_file);
+    engine_destroy(csound);
 
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,367 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#include "meter.h"
+
+#define METER_BLOCK_STEPS 4          // Steps per loudness block (400 ms).
+#define METER_ABSOLUTE_GATE -70.0    // LUFS below which a block is silence.
+#define METER_RELATIVE_GATE -10.0    // LU under the level of the louder blocks below which a block is left out.
+#define METER_DENORMAL 1e-30         // Filter states smaller than this are flushed to zero between blocks.
+
+// --- K-Weighting ---
+// The two stages of the BS.1770 weighting filter, a high shelf and a
+// high-pass, designed for the sample rate from their analog prototypes (at
+// 48 kHz they give the coefficients listed in the standard).
+
+static void design_filter(double sr, double* filter) {
+    double k = tan(M_PI * 1681.974450955533 / sr);
+    double q = 0.7071752369554196;
+    double vh = pow(10.0, 3.999843853973347 / 20.0);
+    double vb = pow(vh, 0.4996667741545416);
+    double a0 = 1.0 + k / q + k * k;
+    filter[0] = (vh + vb * k / q + k * k) / a0;
+    filter[1] = 2.0 * (k * k - vh) / a0;
+    filter[2] = (vh - vb * k / q + k * k) / a0;
+    filter[3] = 2.0 * (k * k - 1.0) / a0;
+    filter[4] = (1.0 - k / q + k * k) / a0;
+
+    k = tan(M_PI * 38.13547087602444 / sr);
+    q = 0.5003270373238773;
+    a0 = 1.0 + k / q + k * k;
+    filter[5] = 1.0;
+    filter[6] = -2.0;
+    filter[7] = 1.0;
+    filter[8] = 2.0 * (k * k - 1.0) / a0;
+    filter[9] = (1.0 - k / q + k * k) / a0;
+}
+
+// --- Kernels ---
+// Csound is normally built with 64-bit MYFLT (USE_DOUBLE). The vector paths
+// below handle that case; the scalar loops finish the remainder and cover
+// single-precision builds. Stereo is filtered with both channels in the two
+// lanes of one register.
+
+/**
+ * @brief Adds the peak, the sum of squares and the clipped samples of a run of samples to a step.
+ */
+static void measure_levels(const MYFLT* in, size_t count, MeterStep* step) {
+    size_t i = 0;
+    double peak = step->peak;
+    double sum_squares = 0.0;
+    long clips = 0;
+#if defined(USE_DOUBLE) && defined(__SSE2__)
+    const __m128d sign = _mm_set1_pd(-0.0);
+    const __m128d full = _mm_set1_pd(1.0);
+    __m128d peaks = _mm_set1_pd(peak);
+    __m128d sums = _mm_setzero_pd();
+    for (; i + 2 <= count; i += 2) {
+        __m128d v = _mm_loadu_pd(in + i);
+        __m128d magnitude = _mm_andnot_pd(sign, v);
+        peaks = _mm_max_pd(peaks, magnitude);
+        sums = _mm_add_pd(sums, _mm_mul_pd(v, v));
+        clips += __builtin_popcount(_mm_movemask_pd(_mm_cmpge_pd(magnitude, full)));
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, peaks);
+    peak = lanes[0] > lanes[1] ? lanes[0] : lanes[1];
+    _mm_storeu_pd(lanes, sums);
+    sum_squares = lanes[0] + lanes[1];
+#elif defined(USE_DOUBLE) && defined(__ARM_NEON) && defined(__aarch64__)
+    const float64x2_t full = vdupq_n_f64(1.0);
+    float64x2_t peaks = vdupq_n_f64(peak);
+    float64x2_t sums = vdupq_n_f64(0.0);
+    uint64x2_t clipped = vdupq_n_u64(0);
+    for (; i + 2 <= count; i += 2) {
+        float64x2_t v = vld1q_f64(in + i);
+        float64x2_t magnitude = vabsq_f64(v);
+        peaks = vmaxq_f64(peaks, magnitude);
+        sums = vfmaq_f64(sums, v, v);
+        clipped = vsubq_u64(clipped, vcgeq_f64(magnitude, full)); // A true lane is all ones, i.e. -1.
+    }
+    peak = vmaxvq_f64(peaks);
+    sum_squares = vaddvq_f64(sums);
+    clips = (long)(vgetq_lane_u64(clipped, 0) + vgetq_lane_u64(clipped, 1));
+#endif
+    for (; i < count; i++) {
+        double magnitude = fabs(in[i]);
+        if (magnitude > peak) {
+            peak = magnitude;
+        }
+        sum_squares += (double)in[i] * in[i];
+        clips += magnitude >= 1.0;
+    }
+    step->peak = peak;
+    step->sum_squares += sum_squares;
+    step->clips += clips;
+}
+
+/**
+ * @brief K-weights a run of frames, keeping the filter state, and returns the sum of the squared output.
+ *
+ * The state holds, for every channel c, the two states of the shelf at
+ * [c] and [nchnls + c], then those of the high-pass at [2 * nchnls + c]
+ * and [3 * nchnls + c].
+ */
+static double weigh(const double* f, double* state, int nchnls, const MYFLT* in, int frames) {
+    double sum = 0.0;
+#if defined(USE_DOUBLE) && defined(__SSE2__)
+    if (nchnls == 2) {
+        const __m128d b0 = _mm_set1_pd(f[0]), b1 = _mm_set1_pd(f[1]), b2 = _mm_set1_pd(f[2]);
+        const __m128d a1 = _mm_set1_pd(f[3]), a2 = _mm_set1_pd(f[4]);
+        const __m128d c1 = _mm_set1_pd(f[8]), c2 = _mm_set1_pd(f[9]);
+        __m128d s1 = _mm_loadu_pd(state), s2 = _mm_loadu_pd(state + 2);
+        __m128d h1 = _mm_loadu_pd(state + 4), h2 = _mm_loadu_pd(state + 6);
+        __m128d sums = _mm_setzero_pd();
+        for (int i = 0; i < frames; i++) {
+            __m128d x = _mm_loadu_pd(in + 2 * i);
+            __m128d y = _mm_add_pd(_mm_mul_pd(b0, x), s1);
+            s1 = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(b1, x), _mm_mul_pd(a1, y)), s2);
+            s2 = _mm_sub_pd(_mm_mul_pd(b2, x), _mm_mul_pd(a2, y));
+            // The high-pass has b = 1, -2, 1.
+            __m128d z = _mm_add_pd(y, h1);
+            h1 = _mm_sub_pd(_mm_sub_pd(h2, _mm_add_pd(y, y)), _mm_mul_pd(c1, z));
+            h2 = _mm_sub_pd(y, _mm_mul_pd(c2, z));
+            sums = _mm_add_pd(sums, _mm_mul_pd(z, z));
+        }
+        _mm_storeu_pd(state, s1);
+        _mm_storeu_pd(state + 2, s2);
+        _mm_storeu_pd(state + 4, h1);
+        _mm_storeu_pd(state + 6, h2);
+        double lanes[2];
+        _mm_storeu_pd(lanes, sums);
+        return lanes[0] + lanes[1];
+    }
+#endif
+    for (int c = 0; c < nchnls; c++) {
+        double s1 = state[c], s2 = state[nchnls + c];
+        double h1 = state[2 * nchnls + c], h2 = state[3 * nchnls + c];
+        for (int i = 0; i < frames; i++) {
+            double x = in[i * nchnls + c];
+            double y = f[0] * x + s1;
+            s1 = f[1] * x - f[3] * y + s2;
+            s2 = f[2] * x - f[4] * y;
+            double z = f[5] * y + h1;
+            h1 = f[6] * y - f[8] * z + h2;
+            h2 = f[7] * y - f[9] * z;
+            sum += z * z;
+        }
+        state[c] = s1;
+        state[nchnls + c] = s2;
+        state[2 * nchnls + c] = h1;
+        state[3 * nchnls + c] = h2;
+    }
+    return sum;
+}
+
+// --- Metering ---
+
+int meter_init(Meter* meter, int nchnls, double sr) {
+    memset(meter, 0, sizeof(*meter));
+    meter->nchnls = nchnls;
+    meter->sr = sr;
+    meter->step_frames = lround(sr * METER_STEP_SECONDS);
+    if (meter->step_frames < 1) {
+        meter->step_frames = 1;
+    }
+    design_filter(sr, meter->filter);
+    meter->state = (double*)calloc(4 * (size_t)nchnls, sizeof(double));
+    return meter->state != NULL ? 0 : -1;
+}
+
+void meter_free(Meter* meter) {
+    free(meter->state);
+    free(meter->steps);
+    meter->state = NULL;
+    meter->steps = NULL;
+    meter->step_count = 0;
+    meter->step_capacity = 0;
+}
+
+/**
+ * @brief Returns the step that the next frame belongs to, starting a new one if the last is full.
+ */
+static MeterStep* current_step(Meter* meter) {
+    if (meter->step_count > 0 && meter->steps[meter->step_count - 1].frames < meter->step_frames) {
+        return &meter->steps[meter->step_count - 1];
+    }
+    if (meter->step_count == meter->step_capacity) {
+        int capacity = meter->step_capacity == 0 ? 64 : meter->step_capacity * 2;
+        MeterStep* steps = (MeterStep*)realloc(meter->steps, capacity * sizeof(MeterStep));
+        if (steps == NULL) {
+            return NULL;
+        }
+        meter->steps = steps;
+        meter->step_capacity = capacity;
+    }
+    MeterStep* step = &meter->steps[meter->step_count++];
+    memset(step, 0, sizeof(*step));
+    return step;
+}
+
+void meter_process(Meter* meter, const MYFLT* samples, int frames) {
+    while (frames > 0 && !meter->failed) {
+        MeterStep* step = current_step(meter);
+        if (step == NULL) {
+            meter->failed = 1;
+            return;
+        }
+        long room = meter->step_frames - step->frames;
+        int count = frames < room ? frames : (int)room;
+        measure_levels(samples, (size_t)count * meter->nchnls, step);
+        step->weighted += weigh(meter->filter, meter->state, meter->nchnls, samples, count);
+        step->frames += count;
+        samples += (size_t)count * meter->nchnls;
+        frames -= count;
+    }
+    // A decaying filter would otherwise reach denormal values in the silence after a piece.
+    for (int i = 0; i < 4 * meter->nchnls; i++) {
+        if (fabs(meter->state[i]) < METER_DENORMAL) {
+            meter->state[i] = 0.0;
+        }
+    }
+}
+
+// --- Reporting ---
+
+/**
+ * @brief The levels of a run of steps.
+ */
+typedef struct {
+    double peak_db;
+    double rms_db;
+    long clips;
+    double seconds;
+} MeterLevels;
+
+static MeterLevels levels_of(const Meter* meter, int first, int count) {
+    MeterLevels levels = {0.0, 0.0, 0, 0.0};
+    double peak = 0.0, sum_squares = 0.0;
+    long frames = 0;
+    for (int s = first; s < first + count; s++) {
+        const MeterStep* step = &meter->steps[s];
+        if (step->peak > peak) {
+            peak = step->peak;
+        }
+        sum_squares += step->sum_squares;
+        levels.clips += step->clips;
+        frames += step->frames;
+    }
+    levels.peak_db = 20.0 * log10(peak);
+    levels.rms_db = frames > 0 ? 10.0 * log10(sum_squares / ((double)frames * meter->nchnls)) : -INFINITY;
+    levels.seconds = (double)frames / meter->sr;
+    return levels;
+}
+
+/**
+ * @brief Returns the mean square of the K-weighted signal over the loudness block that ends with a step.
+ */
+static double block_power(const Meter* meter, int last) {
+    int first = last - METER_BLOCK_STEPS + 1 > 0 ? last - METER_BLOCK_STEPS + 1 : 0;
+    double weighted = 0.0;
+    long frames = 0;
+    for (int s = first; s <= last; s++) {
+        weighted += meter->steps[s].weighted;
+        frames += meter->steps[s].frames;
+    }
+    return frames > 0 ? weighted / frames : 0.0;
+}
+
+static double loudness(double power) {
+    return -0.691 + 10.0 * log10(power);
+}
+
+/**
+ * @brief Computes the gated integrated loudness and the loudest 400 ms block.
+ */
+static void measure_loudness(const Meter* meter, double* integrated, double* max_momentary) {
+    *integrated = -INFINITY;
+    *max_momentary = -INFINITY;
+    // A render shorter than one block is measured as a single block.
+    int first = meter->step_count >= METER_BLOCK_STEPS ? METER_BLOCK_STEPS - 1 : meter->step_count - 1;
+    double total = 0.0;
+    int count = 0;
+    for (int s = first; s >= 0 && s < meter->step_count; s++) {
+        double power = block_power(meter, s);
+        double level = loudness(power);
+        if (level > *max_momentary) {
+            *max_momentary = level;
+        }
+        if (level > METER_ABSOLUTE_GATE) {
+            total += power;
+            count++;
+        }
+    }
+    if (count == 0) {
+        return;
+    }
+    double gate = loudness(total / count) + METER_RELATIVE_GATE;
+    total = 0.0;
+    count = 0;
+    for (int s = first; s < meter->step_count; s++) {
+        double power = block_power(meter, s);
+        double level = loudness(power);
+        if (level > METER_ABSOLUTE_GATE && level > gate) {
+            total += power;
+            count++;
+        }
+    }
+    if (count > 0) {
+        *integrated = loudness(total / count);
+    }
+}
+
+void meter_print(const Meter* meter, FILE* out) {
+    MeterLevels levels = levels_of(meter, 0, meter->step_count);
+    double integrated, max_momentary;
+    measure_loudness(meter, &integrated, &max_momentary);
+    fprintf(out, "Levels: peak %.2f dBFS, RMS %.2f dBFS, %ld clipped sample%s, loudness %.1f LUFS (loudest 400 ms: %.1f LUFS).\n",
+        levels.peak_db, levels.rms_db, levels.clips, levels.clips == 1 ? "" : "s", integrated, max_momentary);
+}
+
+static void write_summary(FILE* file, const char* name, const Meter* meter) {
+    MeterLevels levels = levels_of(meter, 0, meter->step_count);
+    double integrated, max_momentary;
+    measure_loudness(meter, &integrated, &max_momentary);
+    fprintf(file, "summary %s channels=%d seconds=%.3f peak_db=%.2f rms_db=%.2f clips=%ld loudness_lufs=%.1f max_momentary_lufs=%.1f\n",
+        name, meter->nchnls, levels.seconds, levels.peak_db, levels.rms_db, levels.clips, integrated, max_momentary);
+}
+
+int meter_save(const char* path, const Meter* mix, const Meter* tracks, int num_tracks) {
+    if (mix->failed) {
+        fprintf(stderr, "Error: Failed to allocate memory for the levels of the render.\n");
+        return -1;
+    }
+    FILE* file = fopen(path, "w");
+    if (file == NULL) {
+        perror("Error: Cannot create the level report");
+        return -1;
+    }
+    fprintf(file, "# Levels in dBFS, loudness in LUFS (K-weighted, gated, as in ITU-R BS.1770).\n");
+    write_summary(file, "mix", mix);
+    for (int t = 0; t < num_tracks; t++) {
+        char name[32];
+        snprintf(name, sizeof(name), "track-%03d", t + 1);
+        write_summary(file, name, &tracks[t]);
+    }
+    int steps_per_second = (int)lround(1.0 / METER_STEP_SECONDS);
+    for (int first = 0, second = 0; first < mix->step_count; first += steps_per_second, second++) {
+        int count = mix->step_count - first < steps_per_second ? mix->step_count - first : steps_per_second;
+        MeterLevels levels = levels_of(mix, first, count);
+        fprintf(file, "second %d peak_db=%.2f rms_db=%.2f clips=%ld momentary_lufs=%.1f\n",
+            second, levels.peak_db, levels.rms_db, levels.clips, loudness(block_power(mix, first + count - 1)));
+    }
+    if (fclose(file) != 0) {
+        fprintf(stderr, "Error: Failed to write the level report '%s'.\n", path);
+        return -1;
+    }
+    return 0;
+}
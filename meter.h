@@ -0,0 +1,96 @@
+#ifndef METER_H
+#define METER_H
+
+#include <csound.h>
+#include <stdio.h>
+
+// --- Output Metering ---
+//
+// A meter follows a rendered signal block by block, as it leaves Csound,
+// so a render reports its levels without a second pass over the file:
+//
+//   - the sample peak and the RMS level, in dBFS;
+//   - the number of clipped samples (at or beyond 0 dBFS, i.e. 1.0);
+//   - the integrated loudness in LUFS, estimated as in ITU-R BS.1770: the
+//     signal is K-weighted, measured in 400 ms blocks overlapping by 75%,
+//     and blocks below -70 LUFS or more than 10 LU under the ungated
+//     level are left out. Every channel has weight 1, as for stereo.
+//
+// The levels are kept per 100 ms step, from which the report gives one line
+// per second and the loudness gating is done at the end.
+
+#define METER_REPORT_SUFFIX ".meter" // Appended to a WAV file's name to name its report.
+#define METER_STEP_SECONDS 0.1       // The resolution of the kept levels, and the hop of the loudness blocks.
+
+/**
+ * @brief The levels of one 100 ms step of the signal.
+ */
+typedef struct {
+    double peak;         /**< The highest absolute sample. */
+    double sum_squares;  /**< The sum of the squared samples of every channel. */
+    double weighted;     /**< The sum of the squared K-weighted samples of every channel. */
+    long clips;          /**< The number of samples at or beyond full scale. */
+    long frames;         /**< The number of frames in the step. */
+} MeterStep;
+
+/**
+ * @brief Measures one interleaved signal as it is rendered.
+ */
+typedef struct {
+    int nchnls;          /**< The number of interleaved channels. */
+    double sr;           /**< The sample rate. */
+    long step_frames;    /**< The number of frames in a full step. */
+    double filter[10];   /**< The K-weighting coefficients: b0, b1, b2, a1, a2 of the shelf, then of the high-pass. */
+    double* state;       /**< Four filter states per channel (two per stage). */
+    MeterStep* steps;    /**< The steps so far; the last one may be incomplete. */
+    int step_count;      /**< The number of steps started. */
+    int step_capacity;   /**< The allocated length of steps. */
+    int failed;          /**< Non-zero if a step could not be stored because allocation failed. */
+} Meter;
+
+/**
+ * @brief Prepares a meter.
+ * @param meter The meter to initialize.
+ * @param nchnls The number of interleaved channels of the signal.
+ * @param sr The sample rate of the signal.
+ * @return 0 on success, -1 if memory allocation fails.
+ */
+int meter_init(Meter* meter, int nchnls, double sr);
+
+/**
+ * @brief Measures a block of the signal.
+ * @param meter The meter.
+ * @param samples frames * nchnls interleaved samples.
+ * @param frames The number of frames.
+ */
+void meter_process(Meter* meter, const MYFLT* samples, int frames);
+
+/**
+ * @brief Releases the memory owned by a meter.
+ * @param meter The meter to free.
+ */
+void meter_free(Meter* meter);
+
+/**
+ * @brief Prints a one-line summary of a meter's levels.
+ * @param meter The meter.
+ * @param out Where the line is printed.
+ */
+void meter_print(const Meter* meter, FILE* out);
+
+/**
+ * @brief Writes a report of the levels of a render.
+ *
+ * The report has one "summary <name> key=value ..." line for the mix and
+ * every track, then one "second <n> key=value ..." line per second of the
+ * mix, for scripts to parse.
+ *
+ * @param path The file to write.
+ * @param mix The meter of the mix.
+ * @param tracks The meters of the tracks, or NULL.
+ * @param num_tracks The number of track meters.
+ * @return 0 on success, -1 on failure (an error is printed).
+ */
+int meter_save(const char* path, const Meter* mix, const Meter* tracks, int num_tracks);
+
+#endif // METER_H
@@ -0,0 +1,191 @@
+#include <errno.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__AVX__)
+#include <immintrin.h>
+#endif
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#include "pcm.h"
+
+#define INT16_SCALE 32767.0
+
+// --- Format Conversion ---
+// Csound is normally built with 64-bit MYFLT (USE_DOUBLE). The vector paths
+// below handle that case; the scalar loops finish the remainder and cover
+// single-precision builds.
+
+static int16_t convert_int16_scalar(MYFLT sample) {
+    if (sample > 1.0) sample = 1.0;
+    if (sample < -1.0) sample = -1.0;
+    return (int16_t)lrint(sample * INT16_SCALE);
+}
+
+void pcm_convert_float32(const MYFLT* in, float* out, size_t count) {
+    size_t i = 0;
+#if defined(USE_DOUBLE) && defined(__AVX__)
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_ps(out + i, _mm256_cvtpd_ps(_mm256_loadu_pd(in + i)));
+    }
+#elif defined(USE_DOUBLE) && defined(__SSE2__)
+    for (; i + 4 <= count; i += 4) {
+        __m128 lo = _mm_cvtpd_ps(_mm_loadu_pd(in + i));
+        __m128 hi = _mm_cvtpd_ps(_mm_loadu_pd(in + i + 2));
+        _mm_storeu_ps(out + i, _mm_movelh_ps(lo, hi));
+    }
+#elif defined(USE_DOUBLE) && defined(__ARM_NEON) && defined(__aarch64__)
+    for (; i + 4 <= count; i += 4) {
+        float32x2_t lo = vcvt_f32_f64(vld1q_f64(in + i));
+        float32x2_t hi = vcvt_f32_f64(vld1q_f64(in + i + 2));
+        vst1q_f32(out + i, vcombine_f32(lo, hi));
+    }
+#endif
+    for (; i < count; i++) {
+        out[i] = (float)in[i];
+    }
+}
+
+void pcm_convert_int16(const MYFLT* in, int16_t* out, size_t count) {
+    size_t i = 0;
+#if defined(USE_DOUBLE) && defined(__SSE2__)
+    const __m128d scale = _mm_set1_pd(INT16_SCALE);
+    const __m128d upper = _mm_set1_pd(INT16_SCALE);
+    const __m128d lower = _mm_set1_pd(-INT16_SCALE);
+    for (; i + 8 <= count; i += 8) {
+        __m128i q[4];
+        for (int k = 0; k < 4; k++) {
+            __m128d v = _mm_mul_pd(_mm_loadu_pd(in + i + 2 * k), scale);
+            v = _mm_min_pd(_mm_max_pd(v, lower), upper);
+            q[k] = _mm_cvtpd_epi32(v); // Two int32 in the low half, rounded to nearest.
+        }
+        __m128i a = _mm_unpacklo_epi64(q[0], q[1]);
+        __m128i b = _mm_unpacklo_epi64(q[2], q[3]);
+        _mm_storeu_si128((__m128i*)(out + i), _mm_packs_epi32(a, b));
+    }
+#elif defined(USE_DOUBLE) && defined(__ARM_NEON) && defined(__aarch64__)
+    const float64x2_t upper = vdupq_n_f64(INT16_SCALE);
+    const float64x2_t lower = vdupq_n_f64(-INT16_SCALE);
+    for (; i + 8 <= count; i += 8) {
+        int32x2_t q[4];
+        for (int k = 0; k < 4; k++) {
+            float64x2_t v = vmulq_n_f64(vld1q_f64(in + i + 2 * k), INT16_SCALE);
+            v = vminq_f64(vmaxq_f64(v, lower), upper);
+            q[k] = vmovn_s64(vcvtnq_s64_f64(v));
+        }
+        int16x4_t a = vqmovn_s32(vcombine_s32(q[0], q[1]));
+        int16x4_t b = vqmovn_s32(vcombine_s32(q[2], q[3]));
+        vst1q_s16(out + i, vcombine_s16(a, b));
+    }
+#endif
+    for (; i < count; i++) {
+        out[i] = convert_int16_scalar(in[i]);
+    }
+}
+
+// --- Streams ---
+
+int pcm_format_from_name(const char* name, PcmFormat* format) {
+    if (strcmp(name, "native") == 0) {
+        *format = PCM_NATIVE;
+    } else if (strcmp(name, "f32") == 0) {
+        *format = PCM_FLOAT32;
+    } else if (strcmp(name, "s16") == 0) {
+        *format = PCM_INT16;
+    } else {
+        return -1;
+    }
+    return 0;
+}
+
+size_t pcm_sample_size(PcmFormat format) {
+    switch (format) {
+    case PCM_FLOAT32: return sizeof(float);
+    case PCM_INT16: return sizeof(int16_t);
+    default: return sizeof(MYFLT);
+    }
+}
+
+/**
+ * @brief Writes a whole buffer, retrying after partial writes and signals.
+ */
+static int write_all(int fd, const unsigned char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = write(fd, data, size);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        data += n;
+        size -= (size_t)n;
+    }
+    return 0;
+}
+
+static int flush_batch(PcmStream* stream) {
+    if (stream->used == 0) {
+        return 0;
+    }
+    int result = write_all(stream->fd, stream->buffer, stream->used);
+    stream->used = 0;
+    return result;
+}
+
+int pcm_stream_open(PcmStream* stream, int fd, PcmFormat format, size_t batch_bytes) {
+    size_t sample_size = pcm_sample_size(format);
+    stream->fd = fd;
+    stream->format = format;
+    stream->capacity = (batch_bytes + sample_size - 1) / sample_size * sample_size;
+    stream->used = 0;
+    stream->buffer = (unsigned char*)malloc(stream->capacity);
+    return stream->buffer != NULL ? 0 : -1;
+}
+
+int pcm_stream_write(PcmStream* stream, const MYFLT* samples, size_t count) {
+    size_t sample_size = pcm_sample_size(stream->format);
+
+    // Large native blocks bypass the batch buffer entirely.
+    if (stream->format == PCM_NATIVE && count * sample_size >= stream->capacity) {
+        if (flush_batch(stream) != 0) {
+            return -1;
+        }
+        return write_all(stream->fd, (const unsigned char*)samples, count * sample_size);
+    }
+
+    while (count > 0) {
+        size_t room = (stream->capacity - stream->used) / sample_size;
+        size_t n = count < room ? count : room;
+        void* dest = stream->buffer + stream->used;
+
+        switch (stream->format) {
+        case PCM_FLOAT32: pcm_convert_float32(samples, (float*)dest, n); break;
+        case PCM_INT16: pcm_convert_int16(samples, (int16_t*)dest, n); break;
+        default: memcpy(dest, samples, n * sample_size); break;
+        }
+        stream->used += n * sample_size;
+        samples += n;
+        count -= n;
+
+        if (stream->used == stream->capacity && flush_batch(stream) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int pcm_stream_close(PcmStream* stream) {
+    int result = flush_batch(stream);
+    free(stream->buffer);
+    stream->buffer = NULL;
+    return result;
+}
@@ -0,0 +1,88 @@
+#ifndef PCM_H
+#define PCM_H
+
+#include <csound.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// --- Raw PCM Streaming ---
+
+/**
+ * @brief The sample encoding of a raw PCM stream.
+ */
+typedef enum {
+    PCM_NATIVE,  /**< Csound's own MYFLT samples, written without conversion. */
+    PCM_FLOAT32, /**< 32-bit IEEE float samples. */
+    PCM_INT16    /**< 16-bit signed integer samples, clipped to [-1, 1]. */
+} PcmFormat;
+
+#define PCM_BATCH_BYTES (1 << 16) // Default size of one write() to the stream.
+
+/**
+ * @brief Streams interleaved samples to a file descriptor in large writes.
+ *
+ * Blocks are converted straight into the batch buffer, which is written out
+ * whenever it fills up. In the native format, blocks at least as large as
+ * the batch are written directly from the caller's buffer without a copy.
+ */
+typedef struct {
+    int fd;                 /**< The descriptor written to (e.g., stdout or a pipe). */
+    PcmFormat format;       /**< The sample encoding. */
+    unsigned char* buffer;  /**< The batch buffer. */
+    size_t capacity;        /**< Size of the batch buffer in bytes. */
+    size_t used;            /**< Bytes waiting in the batch buffer. */
+} PcmStream;
+
+/**
+ * @brief Parses a format name: "native", "f32" or "s16".
+ * @param name The format name.
+ * @param format Receives the format.
+ * @return 0 on success, -1 if the name is unknown.
+ */
+int pcm_format_from_name(const char* name, PcmFormat* format);
+
+/**
+ * @brief Returns the size of one sample in bytes.
+ */
+size_t pcm_sample_size(PcmFormat format);
+
+/**
+ * @brief Prepares a stream. The descriptor is not closed by pcm_stream_close().
+ * @param stream The stream to initialize.
+ * @param fd The descriptor to write to.
+ * @param format The sample encoding.
+ * @param batch_bytes The size of the batch buffer (rounded up to a whole sample).
+ * @return 0 on success, -1 if memory allocation fails.
+ */
+int pcm_stream_open(PcmStream* stream, int fd, PcmFormat format, size_t batch_bytes);
+
+/**
+ * @brief Appends interleaved samples to the stream.
+ * @param stream The stream.
+ * @param samples The samples to write.
+ * @param count The number of samples (frames * channels).
+ * A reader that went away is only reported if SIGPIPE is ignored (as
+ * --stream does); otherwise the signal ends the process first.
+ *
+ * @return 0 on success, -1 if the descriptor cannot be written (e.g., the reader went away).
+ */
+int pcm_stream_write(PcmStream* stream, const MYFLT* samples, size_t count);
+
+/**
+ * @brief Writes any batched samples and releases the batch buffer.
+ * @param stream The stream to close.
+ * @return 0 on success, -1 on a write error.
+ */
+int pcm_stream_close(PcmStream* stream);
+
+/**
+ * @brief Converts samples to 32-bit floats (vectorized where the CPU allows).
+ */
+void pcm_convert_float32(const MYFLT* in, float* out, size_t count);
+
+/**
+ * @brief Converts samples to 16-bit integers, clipping to [-1, 1] and rounding to nearest.
+ */
+void pcm_convert_int16(const MYFLT* in, int16_t* out, size_t count);
+
+#endif // PCM_H
@@ -0,0 +1,776 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "player.h"
+
+#define DEFAULT_BPM 120.0 // Tempo used until the first measure sets one.
+#define DUE_TOLERANCE 1e-9 // Events due this close to the current time are played, so rounding in start_time cannot stall them.
+#define FNV_OFFSET_BASIS 1469598103934665603ULL
+#define FNV_PRIME 1099511628211ULL
+
+int validate_score(Track* tracks, int num_tracks, FILE* log) {
+    int warnings = 0;
+    if (log != NULL) {
+        fprintf(log, "Validating score...\n");
+    }
+    for (int t = 0; t < num_tracks; t++) {
+        EventTable table;
+        if (event_table_build(&table, &tracks[t]) != 0) {
+            warnings++;
+            continue;
+        }
+        if (table.inexact_events > 0) {
+            if (log != NULL) {
+                fprintf(log, "  [WARNING] Track '%s': %d event durations are not a multiple of 1/%d quarter note and were rounded.\n",
+                    tracks[t].name, table.inexact_events, TICKS_PER_QUARTER);
+            }
+            warnings++;
+        }
+        for (int m = 0; m < tracks[t].measure_count; m++) {
+            const Measure* measure = &tracks[t].measures[m];
+            uint32_t total_ticks = event_table_measure_ticks(&table, m);
+
+            // The expected length of the measure is beats * (4 / unit) quarter notes.
+            // e.g., for 3/8 time, this is 3 * (4.0 / 8) = 1.5 quarter notes.
+            // e.g., for 4/4 time, this is 4 * (4.0 / 4) = 4.0 quarter notes.
+            // Comparing total * unit with beats * 4 * ticks keeps the check in exact integers.
+            if ((uint64_t)total_ticks * measure->beat_unit != (uint64_t)measure->beats_per_measure * 4 * TICKS_PER_QUARTER) {
+                if (log != NULL) {
+                    double expected_duration = (double)measure->beats_per_measure * (4.0 / (double)measure->beat_unit);
+                    fprintf(log, "  [WARNING] Track '%s', Measure %d: For %d/%d time, expected total duration of %.2f quarter notes, but found %.2f.\n",
+                        tracks[t].name, m + 1, measure->beats_per_measure, measure->beat_unit, expected_duration, (double)total_ticks / TICKS_PER_QUARTER);
+                }
+                warnings++;
+            }
+        }
+        event_table_free(&table);
+        warnings += form_check(&tracks[t], log);
+    }
+    return warnings;
+}
+
+// --- Event Queue ---
+// The tracks that still have events wait in a binary min-heap ordered by the
+// time of their next event, so an update only touches the tracks that are
+// due and finished tracks drop out instead of being checked on every block.
+
+/**
+ * @brief Orders two tracks in the queue: the earlier next event first, then the lower track index.
+ */
+static int queue_before(const Player* player, int a, int b) {
+    double time_a = player->states[a].next_event_time;
+    double time_b = player->states[b].next_event_time;
+    return time_a < time_b || (time_a == time_b && a < b);
+}
+
+static void queue_push(Player* player, int t) {
+    int i = player->queue_count++;
+    while (i > 0) {
+        int parent = (i - 1) / 2;
+        if (!queue_before(player, t, player->queue[parent])) {
+            break;
+        }
+        player->queue[i] = player->queue[parent];
+        i = parent;
+    }
+    player->queue[i] = t;
+}
+
+static int queue_pop(Player* player) {
+    int top = player->queue[0];
+    int last = player->queue[--player->queue_count];
+    int i = 0;
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= player->queue_count) {
+            break;
+        }
+        if (child + 1 < player->queue_count && queue_before(player, player->queue[child + 1], player->queue[child])) {
+            child++;
+        }
+        if (!queue_before(player, player->queue[child], last)) {
+            break;
+        }
+        player->queue[i] = player->queue[child];
+        i = child;
+    }
+    player->queue[i] = last;
+    return top;
+}
+
+/**
+ * @brief Copies the state of the first track of a layer to the other tracks of the layer.
+ */
+static void sync_layer(Player* player, int t) {
+    for (int m = player->layer_next[t]; m >= 0; m = player->layer_next[m]) {
+        player->states[m] = player->states[t];
+    }
+}
+
+/**
+ * @brief Queues every layer that still has events, after the states were set directly.
+ */
+static void queue_rebuild(Player* player) {
+    player->queue_count = 0;
+    for (int t = 0; t < player->num_tracks; t++) {
+        if (player->layer_first[t] != t) {
+            continue;
+        }
+        sync_layer(player, t);
+        if (player->states[t].cursor.measure >= 0) {
+            queue_push(player, t);
+        }
+    }
+}
+
+/**
+ * @brief Moves tracks[i] down a max-heap of track indices until it is in place.
+ */
+static void sift_track(int* tracks, int i, int count) {
+    int value = tracks[i];
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= count) {
+            break;
+        }
+        if (child + 1 < count && tracks[child + 1] > tracks[child]) {
+            child++;
+        }
+        if (tracks[child] <= value) {
+            break;
+        }
+        tracks[i] = tracks[child];
+        i = child;
+    }
+    tracks[i] = value;
+}
+
+/**
+ * @brief Sorts track indices in place (heapsort: no allocation, O(n log n) at worst).
+ */
+static void sort_tracks(int* tracks, int count) {
+    int sorted = 1;
+    for (int i = 1; i < count && sorted; i++) {
+        sorted = tracks[i - 1] < tracks[i];
+    }
+    if (sorted) {
+        return; // The common case: the due tracks share one event time.
+    }
+    for (int i = count / 2 - 1; i >= 0; i--) {
+        sift_track(tracks, i, count);
+    }
+    for (int end = count - 1; end > 0; end--) {
+        int largest = tracks[0];
+        tracks[0] = tracks[end];
+        tracks[end] = largest;
+        sift_track(tracks, 0, end);
+    }
+}
+
+// --- Layers ---
+// Tracks that play the same events in the same form differ only in their
+// instrument. The first of them is stepped for all of them: each of its
+// events is played on every track of the layer and the others' states are
+// copied from it, so a part doubled on several instruments costs the
+// scheduling of one track. A track only joins a layer if no track between
+// the two uses its instrument, so every instrument still receives its notes
+// in track order and the audio does not change.
+
+static uint64_t fnv1a(uint64_t hash, const void* data, size_t size) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+/**
+ * @brief Hashes what a track plays, apart from its instrument.
+ */
+static uint64_t layer_hash(const Track* track, const EventTable* table) {
+    int header[4] = {(int)track->type, table->event_count, table->measure_count, track->section_count};
+    uint64_t hash = fnv1a(FNV_OFFSET_BASIS, header, sizeof(header));
+    hash = fnv1a(hash, table->pitch, table->event_count * sizeof(int16_t));
+    return fnv1a(hash, table->duration, table->event_count * sizeof(uint16_t));
+}
+
+static int same_column(const void* a, const void* b, size_t size) {
+    return size == 0 || a == b || memcmp(a, b, size) == 0;
+}
+
+static int same_range(const MeasureRange* a, const MeasureRange* b) {
+    return a->start == b->start && a->length == b->length && a->bpm == b->bpm;
+}
+
+/**
+ * @brief Checks whether two tracks play the same events in the same form.
+ */
+static int same_events(const Player* player, int a, int b) {
+    const Track* x = &player->tracks[a];
+    const Track* y = &player->tracks[b];
+    const EventTable* p = &player->tables[a];
+    const EventTable* q = &player->tables[b];
+    if (x->type != y->type || p->event_count != q->event_count || p->measure_count != q->measure_count
+        || x->section_count != y->section_count) {
+        return 0;
+    }
+    if (!same_column(p->pitch, q->pitch, p->event_count * sizeof(int16_t))
+        || !same_column(p->duration, q->duration, p->event_count * sizeof(uint16_t))
+        || !same_column(p->measure_first, q->measure_first, (p->measure_count + 1) * sizeof(int))) {
+        return 0;
+    }
+    for (int s = 0; s < x->section_count; s++) {
+        const Section* u = &x->sections[s];
+        const Section* v = &y->sections[s];
+        if (!same_range(&u->body, &v->body) || u->times != v->times || u->ending_count != v->ending_count) {
+            return 0;
+        }
+        for (int e = 0; e < u->ending_count; e++) {
+            if (!same_range(&u->endings[e], &v->endings[e])) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief Groups the tracks into layers, in one pass over the tracks with two hash tables.
+ * @return 0 on success, -1 if memory allocation fails.
+ */
+static int build_layers(Player* player) {
+    int n = player->num_tracks;
+    size_t slots = 1;
+    while (slots < 2 * (size_t)n) {
+        slots <<= 1;
+    }
+    uint64_t* hashes = (uint64_t*)malloc((n > 0 ? n : 1) * sizeof(uint64_t));
+    int* tails = (int*)malloc((n > 0 ? n : 1) * sizeof(int));
+    int* firsts = (int*)malloc(slots * sizeof(int)); // By hash: the first track of the last layer with that hash.
+    int* users = (int*)malloc(slots * sizeof(int));  // By instrument: the last track that uses it.
+    if (hashes == NULL || tails == NULL || firsts == NULL || users == NULL) {
+        free(hashes);
+        free(tails);
+        free(firsts);
+        free(users);
+        return -1;
+    }
+    memset(firsts, -1, slots * sizeof(int));
+    memset(users, -1, slots * sizeof(int));
+
+    for (int t = 0; t < n; t++) {
+        player->layer_first[t] = t;
+        player->layer_next[t] = -1;
+        tails[t] = t;
+        hashes[t] = layer_hash(&player->tracks[t], &player->tables[t]);
+        size_t slot = hashes[t] & (slots - 1);
+        while (firsts[slot] >= 0 && hashes[firsts[slot]] != hashes[t]) {
+            slot = (slot + 1) & (slots - 1);
+        }
+        int instrument = player->tracks[t].instrument;
+        size_t use = ((uint32_t)instrument * 2654435761u) & (slots - 1);
+        while (users[use] >= 0 && player->tracks[users[use]].instrument != instrument) {
+            use = (use + 1) & (slots - 1);
+        }
+
+        int first = firsts[slot];
+        int last_user = users[use];
+        int in_order = last_user < first || (last_user >= 0 && player->layer_first[last_user] == first);
+        if (first >= 0 && in_order && same_events(player, first, t)) {
+            player->layer_first[t] = first;
+            player->layer_next[tails[first]] = t;
+            tails[first] = t;
+        } else {
+            firsts[slot] = t;
+        }
+        users[use] = t;
+    }
+    free(hashes);
+    free(tails);
+    free(firsts);
+    free(users);
+    return 0;
+}
+
+int player_init(Player* player, Track* tracks, int num_tracks, double start_time, FILE* log) {
+    player->states = (TrackState*)calloc(num_tracks, sizeof(TrackState));
+    player->tables = (EventTable*)calloc(num_tracks, sizeof(EventTable));
+    player->queue = (int*)malloc(num_tracks * sizeof(int));
+    player->due = (int*)malloc(num_tracks * sizeof(int));
+    player->layer_first = (int*)malloc(num_tracks * sizeof(int));
+    player->layer_next = (int*)malloc(num_tracks * sizeof(int));
+    player->num_tracks = num_tracks;
+    player->tracks = tracks;
+    if (player->states == NULL || player->tables == NULL || player->queue == NULL || player->due == NULL
+        || player->layer_first == NULL || player->layer_next == NULL) {
+        player_free(player);
+        return -1;
+    }
+    for (int t = 0; t < num_tracks; t++) {
+        if (event_table_build(&player->tables[t], &tracks[t]) != 0) {
+            player_free(player);
+            return -1;
+        }
+        form_start(&tracks[t], &player->states[t].cursor);
+    }
+    if (build_layers(player) != 0) {
+        player_free(player);
+        return -1;
+    }
+    player->current_bpm = DEFAULT_BPM;
+    player->start_time = start_time;
+    player->max_end_time = 0.0;
+    player->running = 1;
+    player->log = log;
+    player->on_note = NULL;
+    player->note_user = NULL;
+    player->seek = NULL;
+    player->stems = 0;
+    player->rt_log = NULL;
+    player->score_events = 0;
+    queue_rebuild(player);
+    return 0;
+}
+
+void player_free(Player* player) {
+    if (player->tables != NULL) {
+        for (int t = 0; t < player->num_tracks; t++) {
+            event_table_free(&player->tables[t]);
+        }
+    }
+    free(player->tables);
+    free(player->states);
+    free(player->queue);
+    free(player->due);
+    free(player->layer_first);
+    free(player->layer_next);
+    player->tables = NULL;
+    player->states = NULL;
+    player->queue = NULL;
+    player->due = NULL;
+    player->layer_first = NULL;
+    player->layer_next = NULL;
+    if (player->seek != NULL && player->seek->complete) {
+        seek_index_free(player->seek);
+        free(player->seek);
+    }
+    player->seek = NULL;
+}
+
+/**
+ * @brief Delivers one note to the note callback, or to Csound as a real-time score event.
+ */
+static void play_note(Player* player, CSOUND* csound, int t, const TrackState* ts, double time, double duration_in_sec, double freq, double amp) {
+    const Track* track = &player->tracks[t];
+    if (player->on_note != NULL) {
+        PlayerNote note = {t, ts->cursor.position, track->instrument, time, duration_in_sec, freq, amp};
+        player->on_note(player->note_user, &note);
+        return;
+    }
+    if (player->score_events) {
+        // The stem bus is selected by the fractional instrument number, as in the text form.
+        MYFLT pfields[5] = {track->instrument + (player->stems ? (t + 1) / 1000.0 : 0.0), 0.0, duration_in_sec, freq, amp};
+        csoundScoreEvent(csound, 'i', pfields, 5);
+        return;
+    }
+    rt_check("csoundInputMessage");
+    char score_event[128];
+    if (player->stems) {
+        sprintf(score_event, "i%d.%03d %f %f %f %f", track->instrument, t + 1, 0.0, duration_in_sec, freq, amp);
+    } else {
+        sprintf(score_event, "i%d %f %f %f %f", track->instrument, 0.0, duration_in_sec, freq, amp);
+    }
+    csoundInputMessage(csound, score_event);
+}
+
+/**
+ * @brief Plays the notes of one event value: a single key on melody tracks, every note of the chord on chord tracks.
+ * @param layer If set, the event is also played on the other tracks of t's layer, one track after the other.
+ */
+static void play_event(Player* player, CSOUND* csound, int t, const TrackState* ts, int value, double time, double duration_in_sec, int layer) {
+    if (value == REST) {
+        return;
+    }
+    if (player->tracks[t].type == TRACK_MELODY) {
+        double freq = get_piano_frequency(value);
+        for (int m = t; m >= 0; m = layer ? player->layer_next[m] : -1) {
+            play_note(player, csound, m, ts, time, duration_in_sec, freq, 0.5);
+        }
+    }
+    else if (player->tracks[t].type == TRACK_CHORD) {
+        // The chord's frequencies are stored contiguously in the pool.
+        const double* freqs = NULL;
+        int count = chord_pool_notes(value, &freqs);
+        for (int m = t; m >= 0; m = layer ? player->layer_next[m] : -1) {
+            for (int j = 0; j < count; j++) {
+                play_note(player, csound, m, ts, time, duration_in_sec, freqs[j], 0.2);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Converts the duration of an event to seconds at a tempo.
+ */
+static double event_seconds(const EventTable* table, int event, double bpm) {
+    double quarter_note_sec = 60.0 / bpm;
+    return table->duration[event] * quarter_note_sec / TICKS_PER_QUARTER;
+}
+
+/**
+ * @brief Plays the next event of a layer that is due, or moves it past an empty measure.
+ *
+ * Only the state of the layer's first track is advanced; see sync_layer().
+ */
+static void advance_track(Player* player, CSOUND* csound, int t) {
+    Track* track = &player->tracks[t];
+    TrackState* ts = &player->states[t];
+    const EventTable* table = &player->tables[t];
+    int first = table->measure_first[ts->cursor.measure];
+    int event_count = table->measure_first[ts->cursor.measure + 1] - first;
+    SeekIndex* recording = (player->seek != NULL && !player->seek->complete) ? player->seek : NULL;
+    if (recording != NULL && ts->current_event_in_measure == 0) {
+        for (int m = t; m >= 0; m = player->layer_next[m]) {
+            recording->measure_starts[m][ts->cursor.position] = ts->next_event_time;
+        }
+    }
+
+    // Check for BPM change at the start of a measure (only for the first track to avoid conflicts)
+    double bpm = form_bpm(track, &ts->cursor);
+    if (t == 0 && ts->current_event_in_measure == 0 && bpm > 0 && player->current_bpm != bpm) {
+        player->current_bpm = bpm;
+        if (player->rt_log != NULL) {
+            rt_log_post(player->rt_log, "\n--- Tempo Change! New BPM: %.1f ---\n", player->current_bpm);
+        } else if (player->log != NULL) {
+            rt_check("fprintf");
+            fprintf(player->log, "\n--- Tempo Change! New BPM: %.1f ---\n", player->current_bpm);
+        }
+        if (recording != NULL) {
+            recording->tempo_times[recording->tempo_count] = ts->next_event_time;
+            recording->tempo_bpms[recording->tempo_count] = bpm;
+            recording->tempo_count++;
+        }
+    }
+
+    if (event_count == 0) {
+        form_next(track, &ts->cursor); // An empty measure takes no time.
+        return;
+    }
+    int e = first + ts->current_event_in_measure;
+    int value = table->pitch[e];
+
+    // Calculate duration in seconds based on CURRENT BPM
+    double duration_in_sec = event_seconds(table, e, player->current_bpm);
+    play_event(player, csound, t, ts, value, ts->next_event_time, duration_in_sec, 1);
+
+    // Schedule the next event for this track
+    ts->next_event_time += duration_in_sec;
+    // Update the maximum end time for the entire piece
+    if (ts->next_event_time > player->max_end_time) {
+        player->max_end_time = ts->next_event_time;
+    }
+
+    ts->current_event_in_measure++;
+    if (ts->current_event_in_measure >= event_count) {
+        ts->current_event_in_measure = 0;
+        form_next(track, &ts->cursor);
+    }
+}
+
+void player_update(Player* player, CSOUND* csound, double score_time) {
+    double current_time_sec = score_time - player->start_time;
+    player->running = player->queue_count > 0;
+
+    // Take every due layer off the queue. Each plays one event per update, in
+    // track order, as a tempo change on the first track applies to the tracks after it.
+    int due_count = 0;
+    while (player->queue_count > 0 && current_time_sec >= player->states[player->queue[0]].next_event_time - DUE_TOLERANCE) {
+        player->due[due_count++] = queue_pop(player);
+    }
+    sort_tracks(player->due, due_count);
+
+    for (int i = 0; i < due_count; i++) {
+        int t = player->due[i];
+        advance_track(player, csound, t);
+        sync_layer(player, t);
+        if (player->states[t].cursor.measure >= 0) {
+            queue_push(player, t); // Finished tracks drop out.
+        }
+    }
+}
+
+double player_next_time(const Player* player) {
+    double next = player->queue_count > 0 ? player->states[player->queue[0]].next_event_time : player->max_end_time;
+    return player->start_time + next;
+}
+
+int player_finished(const Player* player, double score_time) {
+    return !player->running && score_time - player->start_time >= player->max_end_time;
+}
+
+// --- Seeking ---
+
+void seek_index_free(SeekIndex* index) {
+    if (index->measure_starts != NULL) {
+        for (int t = 0; t < index->num_tracks; t++) {
+            free(index->measure_starts[t]);
+        }
+    }
+    free(index->measure_starts);
+    free(index->measure_counts);
+    free(index->tempo_times);
+    free(index->tempo_bpms);
+    memset(index, 0, sizeof(*index));
+}
+
+static void ignore_note(void* user, const PlayerNote* note) {
+    (void)user;
+    (void)note;
+}
+
+/**
+ * @brief Lays the piece out once, silently, recording when every measure starts and every tempo change.
+ * @param laid_out The number of tracks to lay out, from the first. The others are left with no measures.
+ * @return 0 on success, -1 if memory allocation fails.
+ */
+static int build_seek_index(Player* player, int laid_out) {
+    SeekIndex* index = (SeekIndex*)calloc(1, sizeof(SeekIndex));
+    if (index == NULL) {
+        return -1;
+    }
+    index->num_tracks = player->num_tracks;
+    index->measure_counts = (int*)calloc(player->num_tracks, sizeof(int));
+    index->measure_starts = (double**)calloc(player->num_tracks, sizeof(double*));
+    int tempo_capacity = 1 + (player->num_tracks > 0 ? form_length(&player->tracks[0]) : 0);
+    index->tempo_times = (double*)malloc(tempo_capacity * sizeof(double));
+    index->tempo_bpms = (double*)malloc(tempo_capacity * sizeof(double));
+    int failed = index->measure_counts == NULL || index->measure_starts == NULL || index->tempo_times == NULL || index->tempo_bpms == NULL;
+    for (int t = 0; !failed && t < player->num_tracks; t++) {
+        index->measure_counts[t] = form_length(&player->tracks[t]);
+        index->measure_starts[t] = (double*)calloc(index->measure_counts[t] + 1, sizeof(double));
+        failed = index->measure_starts[t] == NULL;
+    }
+
+    Player layout;
+    if (failed || player_init(&layout, player->tracks, laid_out, 0.0, NULL) != 0) {
+        seek_index_free(index);
+        free(index);
+        return -1;
+    }
+    index->tempo_times[0] = 0.0;
+    index->tempo_bpms[0] = layout.current_bpm;
+    index->tempo_count = 1;
+    layout.on_note = ignore_note;
+    layout.seek = index;
+    while (layout.running) {
+        player_update(&layout, NULL, player_next_time(&layout));
+    }
+    layout.seek = NULL;
+    index->end_time = layout.max_end_time;
+    player_free(&layout);
+    for (int t = laid_out; t < player->num_tracks; t++) {
+        index->measure_counts[t] = 0;
+    }
+
+    index->complete = 1;
+    player->seek = index;
+    return 0;
+}
+
+/**
+ * @brief Returns the tempo in effect at a time, including a change at exactly that time.
+ */
+static double tempo_at(const SeekIndex* index, double time) {
+    int lo = 0, hi = index->tempo_count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        if (index->tempo_times[mid] <= time) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return index->tempo_bpms[lo > 0 ? lo - 1 : 0];
+}
+
+double player_measure_time(Player* player, int track, int measure) {
+    if (player->seek == NULL && build_seek_index(player, player->num_tracks) != 0) {
+        return -1.0;
+    }
+    if (track < 0 || track >= player->num_tracks || measure < 0 || measure >= player->seek->measure_counts[track]) {
+        return -1.0;
+    }
+    return player->seek->measure_starts[track][measure];
+}
+
+int player_prepare_seek(Player* player) {
+    if (player->seek == NULL && build_seek_index(player, player->num_tracks) != 0) {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Puts every track at the event that is due at a position, using the seek index.
+ * @param retrigger If set, an event already sounding at the position is replayed for the rest of its duration; otherwise it is skipped.
+ */
+static void place_tracks(Player* player, CSOUND* csound, double position, int retrigger) {
+    const SeekIndex* index = player->seek;
+    player->current_bpm = tempo_at(index, position);
+    player->max_end_time = position;
+    player->running = 0;
+
+    for (int t = 0; t < player->num_tracks; t++) {
+        const Track* track = &player->tracks[t];
+        const EventTable* table = &player->tables[t];
+        TrackState* ts = &player->states[t];
+        const double* starts = index->measure_starts[t];
+
+        // The last measure that starts at or before the position.
+        int lo = 0, hi = index->measure_counts[t];
+        while (lo < hi) {
+            int mid = lo + (hi - lo) / 2;
+            if (starts[mid] <= position + DUE_TOLERANCE) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        if (lo == 0) {
+            form_start(track, &ts->cursor); // An empty track.
+            ts->current_event_in_measure = 0;
+            ts->next_event_time = 0.0;
+            continue;
+        }
+        form_seek(track, &ts->cursor, lo - 1);
+
+        // Walk the events of that measure with the tempo each one was scheduled at.
+        int first = table->measure_first[ts->cursor.measure];
+        int event_count = table->measure_first[ts->cursor.measure + 1] - first;
+        double time = starts[lo - 1];
+        int e = 0;
+        double duration = 0.0;
+        for (; e < event_count; e++) {
+            duration = event_seconds(table, first + e, tempo_at(index, time));
+            if (time + duration > position + DUE_TOLERANCE) {
+                break;
+            }
+            time += duration;
+        }
+        ts->current_event_in_measure = e;
+        ts->next_event_time = time;
+
+        if (e < event_count && time < position - DUE_TOLERANCE) {
+            // The event is already sounding: retrigger it for the rest of its duration.
+            if (retrigger) {
+                play_event(player, csound, t, ts, table->pitch[first + e], position, time + duration - position, 0);
+            }
+            ts->next_event_time = time + duration;
+            ts->current_event_in_measure++;
+        }
+        if (ts->current_event_in_measure >= event_count) {
+            ts->current_event_in_measure = 0;
+            form_next(track, &ts->cursor);
+        }
+        if (ts->next_event_time > player->max_end_time) {
+            player->max_end_time = ts->next_event_time;
+        }
+        player->running |= ts->cursor.measure >= 0;
+    }
+    queue_rebuild(player);
+}
+
+int player_seek(Player* player, CSOUND* csound, double position) {
+    if (player->seek == NULL && build_seek_index(player, player->num_tracks) != 0) {
+        return -1;
+    }
+    if (position < 0 || position >= player->seek->end_time) {
+        return -1;
+    }
+    // Times stay relative to the beginning of the piece; playback starts at the seek position.
+    player->start_time -= position;
+    place_tracks(player, csound, position, 1);
+    return 0;
+}
+
+// --- Reloading ---
+
+/**
+ * @brief Records when every measure of one track starts from the tempo changes already in the index.
+ *
+ * Only the first track changes the tempo, so a track can be laid out on its
+ * own once the first one has been.
+ */
+static void layout_track(Player* player, SeekIndex* index, int t) {
+    const Track* track = &player->tracks[t];
+    const EventTable* table = &player->tables[t];
+    index->measure_counts[t] = form_length(track);
+    FormCursor cursor;
+    double time = 0.0;
+    for (form_start(track, &cursor); cursor.measure >= 0; form_next(track, &cursor)) {
+        index->measure_starts[t][cursor.position] = time;
+        for (int e = table->measure_first[cursor.measure]; e < table->measure_first[cursor.measure + 1]; e++) {
+            // A tempo change due with the event comes first, as the first track is played first.
+            time += event_seconds(table, e, tempo_at(index, time + DUE_TOLERANCE));
+        }
+    }
+    if (time > index->end_time) {
+        index->end_time = time;
+    }
+}
+
+int player_prepare_reload(Player* player, Track* tracks, int num_tracks, const unsigned char* unchanged, int unchanged_count) {
+    if (player_init(player, tracks, num_tracks, 0.0, NULL) != 0) {
+        return -1;
+    }
+    // With the first track unchanged, the tempo is too: only the first track and the changed ones need laying out.
+    int partial = unchanged != NULL && unchanged_count > 0 && unchanged[0];
+    if (build_seek_index(player, partial ? 1 : num_tracks) != 0) {
+        player_free(player);
+        return -1;
+    }
+    for (int t = 1; partial && t < num_tracks; t++) {
+        if (t >= unchanged_count || !unchanged[t]) {
+            layout_track(player, player->seek, t);
+        }
+    }
+    return 0;
+}
+
+void player_reload(Player* player, Player* next, const unsigned char* unchanged, double score_time) {
+    double position = score_time - player->start_time;
+    next->start_time = player->start_time;
+    next->log = player->log;
+    next->rt_log = player->rt_log;
+    next->on_note = player->on_note;
+    next->note_user = player->note_user;
+    next->stems = player->stems;
+    next->score_events = player->score_events;
+
+    // Every track goes to where the edited piece is at this time. Notes that
+    // are sounding were sent before the edit and keep playing.
+    place_tracks(next, NULL, position, 0);
+
+    // Only the first track sets the tempo, so while it is unchanged every
+    // unchanged track is exactly where it was, down to the event.
+    int common = player->num_tracks < next->num_tracks ? player->num_tracks : next->num_tracks;
+    if (unchanged != NULL && common > 0 && unchanged[0]) {
+        next->current_bpm = player->current_bpm;
+        for (int t = 0; t < common; t++) {
+            if (unchanged[t]) {
+                next->states[t] = player->states[t];
+            }
+        }
+        queue_rebuild(next);
+    }
+    if (player->max_end_time > next->max_end_time) {
+        next->max_end_time = player->max_end_time; // The voices still sounding.
+    }
+    next->running = next->queue_count > 0;
+
+    Player previous = *player;
+    *player = *next;
+    *next = previous;
+}
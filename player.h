@@ -0,0 +1,227 @@
+#ifndef PLAYER_H
+#define PLAYER_H
+
+#include <csound.h>
+#include <stdio.h>
+#include "event_table.h"
+#include "form.h"
+#include "realtime.h"
+#include "score.h"
+
+// --- Player Engine Structures ---
+
+/**
+ * @brief Holds the real-time playback state for a single track.
+ *
+ * This structure tracks the current position within the score for a track,
+ * allowing the player to know which event to play next and when.
+ */
+typedef struct {
+    FormCursor cursor;            /**< The measure being played, as a position in the track's form. */
+    int current_event_in_measure; /**< Index of the current event within the measure. */
+    double next_event_time;       /**< The time in seconds, relative to the start of playback, when the next event should be triggered. */
+} TrackState;
+
+/**
+ * @brief A single note produced by the player.
+ */
+typedef struct {
+    int track;       /**< Index of the track that produced the note. */
+    int measure;     /**< Position of the measure in the track's played order (repeats count separately). */
+    int instrument;  /**< The Csound instrument number. */
+    double time;     /**< The scheduled start time in seconds, relative to the start of playback. */
+    double duration; /**< The duration in seconds. */
+    double freq;     /**< The frequency in Hz. */
+    double amp;      /**< The amplitude (0dbfs = 1). */
+} PlayerNote;
+
+/**
+ * @brief Receives notes instead of Csound when set on a player.
+ * @param user The pointer stored in Player.note_user.
+ * @param note The note that is due.
+ */
+typedef void (*PlayerNoteFn)(void* user, const PlayerNote* note);
+
+/**
+ * @brief When every measure of a piece starts and when its tempo changes, for seeking.
+ *
+ * The index is built by laying the piece out once with the player's own
+ * timing, so a seek lands exactly where uninterrupted playback would be.
+ */
+typedef struct {
+    int num_tracks;          /**< The number of tracks. */
+    int* measure_counts;     /**< The number of played measures of every track. */
+    double** measure_starts; /**< Per track, the start time in seconds of every played measure, in ascending order. */
+    int tempo_count;         /**< The number of tempo entries. */
+    double* tempo_times;     /**< The time in seconds of every tempo change, in ascending order (the first is 0). */
+    double* tempo_bpms;      /**< The tempo set by every change. */
+    double end_time;         /**< The time at which the last note of the piece ends. */
+    int complete;            /**< Zero while the index is still being recorded. */
+} SeekIndex;
+
+/**
+ * @brief Schedules the events of a set of tracks onto a Csound instance.
+ *
+ * Times are kept relative to the score time at which playback started, so a
+ * player can run on an instance that has already performed other pieces.
+ * Tracks wait in a priority queue keyed on their next event, so the cost of
+ * an update depends on the tracks that are due, not on how many there are.
+ *
+ * Tracks with the same events and form, such as one part doubled on two
+ * instruments, form a layer: only its first track is queued and stepped,
+ * and each of its events is played on every track of the layer at once.
+ */
+typedef struct {
+    Track* tracks;       /**< The tracks being played. */
+    int num_tracks;      /**< The number of tracks. */
+    TrackState* states;  /**< One playback state per track. */
+    EventTable* tables;  /**< The events of every track in column form, built by player_init(). */
+    int* queue;          /**< The tracks with events left, as a min-heap on their next event time (ties by track index). */
+    int queue_count;     /**< The number of tracks in the queue. */
+    int* due;            /**< Room for every track, to collect the tracks that are due in one update. */
+    int* layer_first;    /**< Per track, the first track of its layer, which schedules the events of the whole layer. */
+    int* layer_next;     /**< Per track, the next track of its layer, or -1. */
+    double current_bpm;  /**< The tempo currently in effect. */
+    double start_time;   /**< The Csound score time at which playback started. */
+    double max_end_time; /**< The relative time at which the last scheduled note ends. */
+    int running;         /**< Non-zero while at least one track still has events to schedule. */
+    FILE* log;           /**< Where tempo changes are reported, or NULL to stay silent. */
+    PlayerNoteFn on_note; /**< If set, due notes are passed here instead of being sent to Csound. */
+    void* note_user;     /**< Passed through to on_note. */
+    SeekIndex* seek;     /**< Built by the first seek, or NULL. */
+    int stems;           /**< If set, every note is also mixed into the stem bus of its track (track index + 1). */
+    RtLog* rt_log;       /**< If set, tempo changes are posted here instead of printed to log (see realtime.h). */
+    int score_events;    /**< If set, notes are sent to Csound as numeric score events instead of text messages. */
+} Player;
+
+/**
+ * @brief Validates the score to ensure measures have the correct number of beats and forms refer to existing measures.
+ * @param tracks Array of tracks to validate.
+ * @param num_tracks Number of tracks in the array.
+ * @param log Where progress and warnings are printed, or NULL to only count them.
+ * @return The number of measures with a wrong total duration plus the number of invalid section ranges.
+ */
+int validate_score(Track* tracks, int num_tracks, FILE* log);
+
+/**
+ * @brief Prepares a player for the given tracks.
+ * @param player The player to initialize.
+ * @param tracks The tracks to play. They must outlive the player.
+ * @param num_tracks The number of tracks.
+ * @param start_time The Csound score time that corresponds to the start of the piece.
+ * @param log Where tempo changes are reported, or NULL to stay silent.
+ * @return 0 on success, -1 if memory allocation fails or a track's events cannot be converted.
+ */
+int player_init(Player* player, Track* tracks, int num_tracks, double start_time, FILE* log);
+
+/**
+ * @brief Releases the memory owned by a player.
+ * @param player The player to free.
+ */
+void player_free(Player* player);
+
+/**
+ * @brief Sends every event that is due at the given score time to Csound.
+ * @param player The player to advance.
+ * @param csound The Csound instance that receives the events (unused if on_note is set).
+ * @param score_time The current Csound score time in seconds.
+ */
+void player_update(Player* player, CSOUND* csound, double score_time);
+
+/**
+ * @brief Returns the earliest time at which a track has an event due.
+ *
+ * Passing this time back to player_update() advances the player event by
+ * event without a Csound instance, which is how a piece is laid out ahead of
+ * rendering.
+ *
+ * @param player The player to inspect.
+ * @return The score time of the next event, or the end time of the piece if no track has events left.
+ */
+double player_next_time(const Player* player);
+
+/**
+ * @brief Returns when a played measure of a track starts.
+ *
+ * The first call lays the piece out once to build the seek index; later
+ * calls are a table lookup.
+ *
+ * @param player The player.
+ * @param track The index of the track.
+ * @param measure The position of the measure in the track's played order, from 0.
+ * @return The start time in seconds from the beginning of the piece, or -1 if there is no such measure (or allocation failed).
+ */
+double player_measure_time(Player* player, int track, int measure);
+
+/**
+ * @brief Builds the seek index now, so that a later player_seek() does not allocate.
+ * @param player The player.
+ * @return 0 on success, -1 if memory allocation fails.
+ */
+int player_prepare_seek(Player* player);
+
+/**
+ * @brief Moves a freshly initialized player to a point in the piece.
+ *
+ * Must be called before the first player_update(). The score time passed to
+ * player_init() then corresponds to the seek position. Each track is found
+ * by binary search over its measure start times, and notes that would still
+ * be sounding at the position are retriggered for the rest of their duration.
+ *
+ * @param player The player to move.
+ * @param csound The Csound instance that receives the retriggered notes (unused if on_note is set).
+ * @param position The time in seconds from the beginning of the piece.
+ * @return 0 on success, -1 if the position is outside the piece or allocation failed.
+ */
+int player_seek(Player* player, CSOUND* csound, double position);
+
+/**
+ * @brief Prepares a player for an edited version of a piece that is playing.
+ *
+ * Builds the player's event tables and the part of its seek index that
+ * player_reload() needs: while the first track (which sets the tempo) is
+ * unchanged, only the changed tracks are laid out, so the time taken grows
+ * with the edit rather than with the score. It does not touch the playing
+ * player, so it can run on another thread while that one keeps playing.
+ *
+ * @param player The player to initialize.
+ * @param tracks The edited tracks. They must outlive the player.
+ * @param num_tracks The number of tracks.
+ * @param unchanged Per track, non-zero if the track is identical to the one playing, or NULL to treat every track as changed.
+ * @param unchanged_count The number of entries in unchanged (tracks beyond it are new).
+ * @return 0 on success, -1 if memory allocation fails or a track's events cannot be converted.
+ */
+int player_prepare_reload(Player* player, Track* tracks, int num_tracks, const unsigned char* unchanged, int unchanged_count);
+
+/**
+ * @brief Switches a playing player over to an edited version of its piece.
+ *
+ * Playback continues from the same time in the edited piece. Notes already
+ * sent to Csound keep sounding, and every track resumes at its next event.
+ * Unchanged tracks keep their exact state as long as the first track (which
+ * sets the tempo) is unchanged. Nothing is allocated or freed, so this can
+ * run between two control blocks.
+ *
+ * @param player The playing player. It takes over the state of next.
+ * @param next A player made by player_prepare_reload(). It receives the previous state of player, to be freed with player_free().
+ * @param unchanged Per track, non-zero if the track is identical in both versions, or NULL to treat every track as changed.
+ *                  It needs as many entries as the shorter of the two track lists.
+ * @param score_time The current Csound score time in seconds.
+ */
+void player_reload(Player* player, Player* next, const unsigned char* unchanged, double score_time);
+
+/**
+ * @brief Releases the memory owned by a seek index.
+ * @param index The index to free.
+ */
+void seek_index_free(SeekIndex* index);
+
+/**
+ * @brief Checks whether all events have been scheduled and the last note has ended.
+ * @param player The player to check.
+ * @param score_time The current Csound score time in seconds.
+ * @return Non-zero when the piece is over.
+ */
+int player_finished(const Player* player, double score_time);
+
+#endif // PLAYER_H
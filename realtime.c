@@ -0,0 +1,248 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "analyze.h"
+#include "instruments.h"
+#include "realtime.h"
+
+#define RT_LOG_DRAIN_NS 10000000L // How long the log's thread sleeps when the queue is empty (10 ms).
+
+// --- Log Ring ---
+
+/**
+ * @brief One queued message: formatted only when it is printed.
+ */
+typedef struct {
+    const char* format;
+    double value;
+} RtLogEntry;
+
+struct RtLog {
+    RtLogEntry* entries; /**< The ring; its size is a power of two. */
+    size_t mask;         /**< The ring size minus one. */
+    atomic_size_t head;  /**< The number of messages posted. Written by the posting thread only. */
+    atomic_size_t tail;  /**< The number of messages printed. Written by the log's thread only. */
+    atomic_int dropped;  /**< Messages dropped because the ring was full. */
+    atomic_int stop;     /**< Set to make the log's thread print what is left and exit. */
+    FILE* out;
+    pthread_t thread;
+};
+
+/**
+ * @brief Prints every message posted so far. Returns the number printed.
+ */
+static size_t drain(RtLog* log) {
+    size_t tail = atomic_load_explicit(&log->tail, memory_order_relaxed);
+    size_t head = atomic_load_explicit(&log->head, memory_order_acquire);
+    for (size_t i = tail; i != head; i++) {
+        const RtLogEntry* entry = &log->entries[i & log->mask];
+        fprintf(log->out, entry->format, entry->value);
+    }
+    // Hand the slots back only once they have been read.
+    atomic_store_explicit(&log->tail, head, memory_order_release);
+    if (head != tail) {
+        fflush(log->out);
+    }
+    return head - tail;
+}
+
+static void* drain_thread(void* arg) {
+    RtLog* log = (RtLog*)arg;
+    struct timespec pause = {0, RT_LOG_DRAIN_NS};
+    while (!atomic_load(&log->stop)) {
+        if (drain(log) == 0) {
+            nanosleep(&pause, NULL);
+        }
+    }
+    drain(log);
+    return NULL;
+}
+
+RtLog* rt_log_create(int capacity, FILE* out) {
+    size_t size = 1;
+    while (size < (size_t)capacity) {
+        size <<= 1;
+    }
+    RtLog* log = (RtLog*)calloc(1, sizeof(RtLog));
+    if (log == NULL) {
+        return NULL;
+    }
+    log->entries = (RtLogEntry*)calloc(size, sizeof(RtLogEntry));
+    if (log->entries == NULL) {
+        free(log);
+        return NULL;
+    }
+    log->mask = size - 1;
+    log->out = out;
+    atomic_init(&log->head, 0);
+    atomic_init(&log->tail, 0);
+    atomic_init(&log->dropped, 0);
+    atomic_init(&log->stop, 0);
+    if (pthread_create(&log->thread, NULL, drain_thread, log) != 0) {
+        free(log->entries);
+        free(log);
+        return NULL;
+    }
+    return log;
+}
+
+int rt_log_post(RtLog* log, const char* format, double value) {
+    size_t head = atomic_load_explicit(&log->head, memory_order_relaxed);
+    size_t tail = atomic_load_explicit(&log->tail, memory_order_acquire);
+    if (head - tail > log->mask) {
+        atomic_fetch_add_explicit(&log->dropped, 1, memory_order_relaxed);
+        return -1;
+    }
+    RtLogEntry* entry = &log->entries[head & log->mask];
+    entry->format = format;
+    entry->value = value;
+    // Publish the entry only once it has been written.
+    atomic_store_explicit(&log->head, head + 1, memory_order_release);
+    return 0;
+}
+
+void rt_log_destroy(RtLog* log) {
+    if (log == NULL) {
+        return;
+    }
+    atomic_store(&log->stop, 1);
+    pthread_join(log->thread, NULL);
+    int dropped = atomic_load(&log->dropped);
+    if (dropped > 0) {
+        fprintf(log->out, "(%d log messages were dropped because the log queue was full.)\n", dropped);
+    }
+    free(log->entries);
+    free(log);
+}
+
+// --- Preallocation ---
+
+static int analyze_voices(Track* tracks, int num_tracks, ScoreAnalysis* analysis) {
+    if (analyze_score(tracks, num_tracks, NULL, analysis) != 0) {
+        fprintf(stderr, "Error: Failed to allocate memory for the score analysis.\n");
+        return -1;
+    }
+    return 0;
+}
+
+int rt_preallocate(CSOUND* csound, Track* tracks, int num_tracks) {
+    ScoreAnalysis analysis;
+    if (analyze_voices(tracks, num_tracks, &analysis) != 0) {
+        return -1;
+    }
+    int result = 0;
+    for (int i = 0; i < analysis.instrument_count && result == 0; i++) {
+        int voices = analysis.instruments[i].peak_voices;
+        if (voices == 0) {
+            continue;
+        }
+        char orc[64];
+        snprintf(orc, sizeof(orc), "prealloc %d, %d\n", i + 1, voices);
+        if (csoundCompileOrc(csound, orc) != 0) {
+            fprintf(stderr, "Error: Failed to preallocate %d instances of instrument %d.\n", voices, i + 1);
+            result = -1;
+        }
+    }
+    analysis_free(&analysis);
+    return result;
+}
+
+int rt_warm_up(CSOUND* csound, Track* tracks, int num_tracks) {
+    ScoreAnalysis analysis;
+    if (analyze_voices(tracks, num_tracks, &analysis) != 0) {
+        return -1;
+    }
+    // Each note lasts one block, so all of them sound at once and then end.
+    double block = (double)csoundGetKsmps(csound) / csoundGetSr(csound);
+    double end = 0.0;
+    int result = 0;
+    for (int i = 0; i < analysis.instrument_count && result == 0; i++) {
+        MYFLT pfields[5] = {(MYFLT)(i + 1), 0.0, (MYFLT)block, 440.0, 0.0};
+        for (int v = 0; v < analysis.instruments[i].peak_voices && result == 0; v++) {
+            result = csoundScoreEvent(csound, 'i', pfields, 5) == 0 ? 0 : -1;
+        }
+        double release = block + instrument_release_seconds(i + 1, block);
+        if (release > end) {
+            end = release;
+        }
+    }
+    analysis_free(&analysis);
+
+    // One block more than the longest release, so every instance is free again.
+    double stop = csoundGetScoreTime(csound) + end + block;
+    while (result == 0 && csoundGetScoreTime(csound) < stop) {
+        result = csoundPerformKsmps(csound) == 0 ? 0 : -1;
+    }
+    if (result != 0) {
+        fprintf(stderr, "Error: Failed to warm up the preallocated instances.\n");
+    }
+    return result;
+}
+
+// --- Audio Path Trap ---
+
+#ifdef RT_DEBUG
+
+static _Thread_local int audio_path;
+
+void rt_enter(void) {
+    audio_path = 1;
+}
+
+void rt_leave(void) {
+    audio_path = 0;
+}
+
+void rt_check(const char* call) {
+    if (!audio_path) {
+        return;
+    }
+    audio_path = 0; // Reporting must not trap again.
+    // write() rather than stdio: stdio may allocate, and the heap may be mid-call.
+    static const char prefix[] = "Error: realtime-safe mode violated: ";
+    static const char suffix[] = " called on the audio path.\n";
+    ssize_t ignored = write(STDERR_FILENO, prefix, sizeof(prefix) - 1);
+    ignored = write(STDERR_FILENO, call, strlen(call));
+    ignored = write(STDERR_FILENO, suffix, sizeof(suffix) - 1);
+    (void)ignored;
+    abort();
+}
+
+#ifdef __GLIBC__
+// Every allocation in the process, Csound's included, goes through these.
+// glibc exports its allocator under the __libc_ names; other C libraries
+// have no such names to forward to, so their allocator is left alone.
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+extern void __libc_free(void* ptr);
+
+void* malloc(size_t size) {
+    rt_check("malloc");
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    rt_check("calloc");
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) {
+    rt_check("realloc");
+    return __libc_realloc(ptr, size);
+}
+
+void free(void* ptr) {
+    if (ptr != NULL) {
+        rt_check("free");
+    }
+    __libc_free(ptr);
+}
+#endif // __GLIBC__
+
+#endif // RT_DEBUG
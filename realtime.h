@@ -0,0 +1,128 @@
+#ifndef REALTIME_H
+#define REALTIME_H
+
+#include <csound.h>
+#include <stdio.h>
+#include "score.h"
+
+// --- Realtime-Safe Playback ---
+//
+// In live playback the host's work between two control blocks runs on the
+// audio path: if it waits on the allocator, a lock or a terminal, the block
+// is late and the sound card underruns. In realtime-safe mode:
+//
+//   - everything is allocated before csoundStart(): the player's state, and
+//     Csound's instrument instances (prealloc'ed to the peak voice count the
+//     score analysis predicts, so Csound never grows its pools mid-piece);
+//   - right after csoundStart(), every preallocated instance plays one
+//     silent note, all at once, which also leaves Csound enough score event
+//     nodes on its free list that the first real notes do not allocate them;
+//   - notes are sent as numeric score events (csoundScoreEvent()) instead of
+//     text messages, which Csound would have to copy and parse;
+//   - log messages are posted to a lock-free ring and printed by a separate
+//     thread, so the audio path never calls printf.
+//
+// Building with RT_DEBUG (make RT_DEBUG=1) arms a trap on the audio path: a
+// blocking call the player would otherwise make (a printf or a text message
+// to Csound) aborts the program with the name of the call. With glibc
+// (Linux), malloc, calloc, realloc and free are trapped too, anywhere in the
+// process; other C libraries do not export their allocator under names the
+// trap can forward to, so elsewhere only the player's own calls are checked.
+// Csound's own perform call blocks on the sound card by design, so the trap
+// covers the host's work between blocks.
+
+#define RT_LOG_CAPACITY 256 // Log messages that can wait to be printed; more are dropped and counted.
+
+/**
+ * @brief A lock-free queue of log messages, printed by its own thread.
+ *
+ * One thread posts (the audio path) and the log's thread prints. The
+ * internal structure is hidden; use the rt_log_* functions.
+ */
+typedef struct RtLog RtLog;
+
+/**
+ * @brief Creates a log and starts the thread that prints it.
+ * @param capacity The number of messages that can wait to be printed (rounded up to a power of two).
+ * @param out Where the messages are printed.
+ * @return The log, or NULL if it could not be allocated or its thread could not be started.
+ */
+RtLog* rt_log_create(int capacity, FILE* out);
+
+/**
+ * @brief Queues a message without allocating, locking or formatting.
+ *
+ * The message is formatted by the log's thread, so the format must stay
+ * valid until then (a string literal).
+ *
+ * @param log The log to post to.
+ * @param format A printf format with exactly one double conversion (e.g., "%.1f").
+ * @param value The value to format.
+ * @return 0 on success, -1 if the queue is full and the message was dropped.
+ */
+int rt_log_post(RtLog* log, const char* format, double value);
+
+/**
+ * @brief Prints the waiting messages, stops the log's thread and frees the log.
+ *
+ * Reports how many messages were dropped, if any.
+ *
+ * @param log The log to destroy (may be NULL).
+ */
+void rt_log_destroy(RtLog* log);
+
+/**
+ * @brief Preallocates Csound's instances of every instrument a score uses.
+ *
+ * Must be called before csoundStart(). Each instrument gets as many
+ * instances as the score sounds at once, releases included.
+ *
+ * @param csound The instance to prepare.
+ * @param tracks The tracks that will be played.
+ * @param num_tracks The number of tracks.
+ * @return 0 on success, -1 on failure (an error is printed).
+ */
+int rt_preallocate(CSOUND* csound, Track* tracks, int num_tracks);
+
+/**
+ * @brief Plays one silent note on every preallocated instance before playback.
+ *
+ * Must be called after csoundStart() and before the audio path starts.
+ * Csound allocates a node for every score event while its free list is
+ * empty and keeps the node for reuse once the event has started. All the
+ * notes are sent at once, so as many nodes are left over as notes can start
+ * in one block, and every instance has run its init pass once. Csound
+ * performs a few blocks of silence meanwhile; the score time moves on.
+ *
+ * @param csound The started instance.
+ * @param tracks The tracks that will be played.
+ * @param num_tracks The number of tracks.
+ * @return 0 on success, -1 on failure (an error is printed).
+ */
+int rt_warm_up(CSOUND* csound, Track* tracks, int num_tracks);
+
+// --- Audio Path Trap ---
+
+#ifdef RT_DEBUG
+/**
+ * @brief Marks the calling thread as being on the audio path until rt_leave().
+ */
+void rt_enter(void);
+
+/**
+ * @brief Ends the audio path section started by rt_enter().
+ */
+void rt_leave(void);
+
+/**
+ * @brief Aborts the program if the calling thread is on the audio path.
+ * @param call The name of the call about to be made, for the report.
+ */
+void rt_check(const char* call);
+#else
+static inline void rt_enter(void) {}
+static inline void rt_leave(void) {}
+static inline void rt_check(const char* call) { (void)call; }
+#endif
+
+#endif // REALTIME_H
@@ -0,0 +1,342 @@
+#include <inttypes.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "engine.h"
+#include "pcm.h"
+#include "regress.h"
+#include "render.h"
+#include "score.h"
+
+#define REGRESS_PROFILE "offline"      // Golden renders always use this profile.
+#define REGRESS_TIMING_RUNS 3          // Renders per score; the fastest one is timed.
+#define REGRESS_WINDOW_SECONDS 1.0     // Length of one RMS window.
+#define REGRESS_RMS_TOLERANCE 1e-3     // Allowed RMS difference per window (about -60 dB of full scale).
+#define REGRESS_TIME_SLACK 0.005       // Seconds of slowdown always allowed, so tiny renders do not fail on noise.
+#define REGRESS_CONVERT_SAMPLES 1024   // Samples converted to 16-bit per hashing step.
+#define REGRESS_NAME_MAX 32
+
+#define FNV_OFFSET_BASIS 1469598103934665603ULL
+#define FNV_PRIME 1099511628211ULL
+
+// --- Results ---
+
+/**
+ * @brief What one render of one score produced.
+ */
+typedef struct {
+    char name[REGRESS_NAME_MAX]; /**< The name of the score. */
+    long frames;                 /**< The length of the render in sample frames. */
+    uint64_t hash;               /**< FNV-1a hash of the 16-bit samples. */
+    double seconds;              /**< The wall-clock render time. */
+    int window_count;            /**< The number of RMS windows. */
+    double* windows;             /**< The RMS level of every window. */
+} RegressResult;
+
+static void result_free(RegressResult* result) {
+    free(result->windows);
+    result->windows = NULL;
+    result->window_count = 0;
+}
+
+static int result_add_window(RegressResult* result, double rms) {
+    double* windows = (double*)realloc(result->windows, (result->window_count + 1) * sizeof(double));
+    if (windows == NULL) {
+        return -1;
+    }
+    windows[result->window_count++] = rms;
+    result->windows = windows;
+    return 0;
+}
+
+// --- Capturing a Render ---
+
+/**
+ * @brief Accumulates the hash and RMS windows of a render block by block.
+ */
+typedef struct {
+    RegressResult* result;
+    long window_frames; /**< Frames in one RMS window. */
+    long window_fill;   /**< Frames accumulated in the current window. */
+    double window_sum;  /**< Sum of squared samples in the current window. */
+    int nchnls;
+} RegressCapture;
+
+static uint64_t fnv1a(uint64_t hash, const void* data, size_t size) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+static int close_window(RegressCapture* capture) {
+    double rms = sqrt(capture->window_sum / ((double)capture->window_fill * capture->nchnls));
+    capture->window_fill = 0;
+    capture->window_sum = 0.0;
+    return result_add_window(capture->result, rms);
+}
+
+static int capture_block(void* user, const MYFLT* samples, int frames, int nchnls) {
+    RegressCapture* capture = (RegressCapture*)user;
+    RegressResult* result = capture->result;
+    capture->nchnls = nchnls;
+
+    // Hash what a 16-bit WAV render would contain.
+    int16_t converted[REGRESS_CONVERT_SAMPLES];
+    size_t count = (size_t)frames * nchnls;
+    for (size_t done = 0; done < count; done += REGRESS_CONVERT_SAMPLES) {
+        size_t n = count - done < REGRESS_CONVERT_SAMPLES ? count - done : REGRESS_CONVERT_SAMPLES;
+        pcm_convert_int16(samples + done, converted, n);
+        result->hash = fnv1a(result->hash, converted, n * sizeof(int16_t));
+    }
+
+    for (int f = 0; f < frames; f++) {
+        for (int c = 0; c < nchnls; c++) {
+            double sample = samples[f * nchnls + c];
+            capture->window_sum += sample * sample;
+        }
+        if (++capture->window_fill == capture->window_frames && close_window(capture) != 0) {
+            return -1;
+        }
+    }
+    result->frames += frames;
+    return 0;
+}
+
+/**
+ * @brief Renders one track on a fresh instance into a result.
+ * @return 0 on success, -1 on failure.
+ */
+static int render_once(const EngineProfile* profile, Track* track, RegressResult* result) {
+    CSOUND* csound = engine_create_offline(profile);
+    if (csound == NULL) {
+        return -1;
+    }
+    csoundSetOption(csound, "-m0");
+    if (csoundStart(csound) != 0) {
+        engine_destroy(csound);
+        return -1;
+    }
+
+    result->frames = 0;
+    result->hash = FNV_OFFSET_BASIS;
+    RegressCapture capture = {result, (long)(REGRESS_WINDOW_SECONDS * profile->sr), 0, 0.0, profile->nchnls};
+
+    double start = engine_now_seconds();
+    int rendered = render_tracks(csound, track, 1, 0.0, capture_block, &capture);
+    result->seconds = engine_now_seconds() - start;
+    engine_destroy(csound);
+
+    if (rendered == 0 && capture.window_fill > 0) {
+        rendered = close_window(&capture);
+    }
+    return rendered;
+}
+
+/**
+ * @brief Renders one track REGRESS_TIMING_RUNS times and keeps the fastest time.
+ * @return 0 on success, -1 on failure or if the runs did not produce identical audio.
+ */
+static int render_case(const EngineProfile* profile, Track* track, RegressResult* result) {
+    memset(result, 0, sizeof(*result));
+    snprintf(result->name, sizeof(result->name), "%s", track->name);
+    if (render_once(profile, track, result) != 0) {
+        fprintf(stderr, "Error: Failed to render '%s'.\n", result->name);
+        return -1;
+    }
+
+    for (int run = 1; run < REGRESS_TIMING_RUNS; run++) {
+        RegressResult again = {0};
+        if (render_once(profile, track, &again) != 0) {
+            fprintf(stderr, "Error: Failed to render '%s'.\n", result->name);
+            result_free(&again);
+            return -1;
+        }
+        int same = again.hash == result->hash && again.frames == result->frames;
+        if (again.seconds < result->seconds) {
+            result->seconds = again.seconds;
+        }
+        result_free(&again);
+        if (!same) {
+            fprintf(stderr, "Error: '%s' renders differently on every run, so it cannot be compared.\n", result->name);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// --- Golden File ---
+
+static int write_golden(const char* path, const EngineProfile* profile, const RegressResult* results, int count) {
+    FILE* file = fopen(path, "w");
+    if (file == NULL) {
+        fprintf(stderr, "Error: Cannot create golden file '%s'.\n", path);
+        return -1;
+    }
+    fprintf(file, "# Golden renders (profile %s, sr=%d, ksmps=%d). Regenerate with --regress-update.\n",
+        profile->name, profile->sr, profile->ksmps);
+    fprintf(file, "# <name> <frames> <hash> <seconds> <windows> <rms per %.1f s window...>\n", REGRESS_WINDOW_SECONDS);
+    for (int i = 0; i < count; i++) {
+        const RegressResult* r = &results[i];
+        fprintf(file, "%s %ld %016" PRIx64 " %.6f %d", r->name, r->frames, r->hash, r->seconds, r->window_count);
+        for (int w = 0; w < r->window_count; w++) {
+            fprintf(file, " %.9g", r->windows[w]);
+        }
+        fprintf(file, "\n");
+    }
+    if (fclose(file) != 0) {
+        fprintf(stderr, "Error: Failed to write golden file '%s'.\n", path);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Finds the golden entry for a score.
+ * @param golden Receives the entry. Its windows must be released with result_free().
+ * @return 0 if found, 1 if the file has no entry for the score, -1 if the file cannot be read.
+ */
+static int read_golden(const char* path, const char* name, RegressResult* golden) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "Error: Cannot open golden file '%s' (create it with --regress-update).\n", path);
+        return -1;
+    }
+
+    int result = 1;
+    char entry[REGRESS_NAME_MAX];
+    while (result == 1 && fscanf(file, "%31s", entry) == 1) {
+        if (entry[0] == '#' || strcmp(entry, name) != 0) {
+            if (fscanf(file, "%*[^\n]") < 0) {
+                break;
+            }
+            continue;
+        }
+
+        memset(golden, 0, sizeof(*golden));
+        snprintf(golden->name, sizeof(golden->name), "%s", entry);
+        int windows = 0;
+        if (fscanf(file, "%ld %" SCNx64 " %lf %d", &golden->frames, &golden->hash, &golden->seconds, &windows) != 4 || windows < 0) {
+            fprintf(stderr, "Error: Malformed entry for '%s' in golden file '%s'.\n", name, path);
+            result = -1;
+            break;
+        }
+        result = 0;
+        for (int w = 0; w < windows; w++) {
+            double rms;
+            if (fscanf(file, "%lf", &rms) != 1 || result_add_window(golden, rms) != 0) {
+                fprintf(stderr, "Error: Malformed entry for '%s' in golden file '%s'.\n", name, path);
+                result_free(golden);
+                result = -1;
+                break;
+            }
+        }
+    }
+    fclose(file);
+    return result;
+}
+
+// --- Checking ---
+
+/**
+ * @brief Compares a render with its golden entry and reports the verdict.
+ * @return 0 if the render passed, -1 on an audio or performance regression.
+ */
+static int compare_result(const RegressResult* golden, const RegressResult* current, double time_tolerance, FILE* log) {
+    const char* audio = "identical";
+    int passed = 1;
+    if (current->hash != golden->hash) {
+        audio = "within tolerance";
+        if (current->frames != golden->frames || current->window_count != golden->window_count) {
+            audio = "CHANGED length";
+            passed = 0;
+        }
+        for (int w = 0; passed && w < current->window_count; w++) {
+            if (fabs(current->windows[w] - golden->windows[w]) > REGRESS_RMS_TOLERANCE) {
+                audio = "CHANGED level";
+                passed = 0;
+            }
+        }
+    }
+
+    double limit = golden->seconds * (1.0 + time_tolerance) + REGRESS_TIME_SLACK;
+    int fast_enough = current->seconds <= limit;
+    double change = golden->seconds > 0 ? (current->seconds / golden->seconds - 1.0) * 100.0 : 0.0;
+    fprintf(log, "  %-14s %-17s %8.3fs (golden %.3fs, %+.0f%%)%s\n", current->name, audio,
+        current->seconds, golden->seconds, change, fast_enough ? "" : "  SLOWER");
+    return passed && fast_enough ? 0 : -1;
+}
+
+int regress_run(const char* golden_path, int update, double time_tolerance, FILE* log) {
+    const EngineProfile* found = engine_find_profile(REGRESS_PROFILE);
+    if (found == NULL) {
+        return -1;
+    }
+    EngineProfile profile = *found;
+    profile.threads = 1; // Thread scheduling must not change the timing baseline.
+
+    // allKeys is a bare event list; it is played as one long measure of quarter notes.
+    Measure all_keys_measure[] = {{allKeys, ALL_KEYS_EVENT_COUNT, ALL_KEYS_EVENT_COUNT, 4, 120.0}};
+    Track cases[] = {
+        {"melody",   TRACK_MELODY, 1, melody_measures, MELODY_MEASURE_COUNT, melody_sections, MELODY_SECTION_COUNT, NULL},
+        {"chords",   TRACK_CHORD,  3, chord_measures,  CHORD_MEASURE_COUNT,  chord_sections,  CHORD_SECTION_COUNT, NULL},
+        {"bass",     TRACK_MELODY, 1, bass_measures,   BASS_MEASURE_COUNT,   bass_sections,   BASS_SECTION_COUNT, NULL},
+        {"north",    TRACK_MELODY, 2, north_measures,  NORTH_MEASURE_COUNT,  NULL, 0, NULL},
+        {"all_keys", TRACK_MELODY, 1, all_keys_measure, 1,                   NULL, 0, NULL},
+    };
+    int count = sizeof(cases) / sizeof(Track);
+
+    RegressResult results[sizeof(cases) / sizeof(Track)];
+    memset(results, 0, sizeof(results));
+    fprintf(log, "Rendering %d scores with profile '%s' (best of %d runs)...\n", count, profile.name, REGRESS_TIMING_RUNS);
+
+    int status = 0;
+    int failures = 0;
+    for (int i = 0; i < count && status == 0; i++) {
+        if (render_case(&profile, &cases[i], &results[i]) != 0) {
+            status = -1;
+            break;
+        }
+        if (update) {
+            fprintf(log, "  %-14s %ld frames %8.3fs\n", results[i].name, results[i].frames, results[i].seconds);
+            continue;
+        }
+
+        RegressResult golden;
+        int found_entry = read_golden(golden_path, results[i].name, &golden);
+        if (found_entry < 0) {
+            status = -1;
+        } else if (found_entry > 0) {
+            fprintf(log, "  %-14s MISSING from '%s'\n", results[i].name, golden_path);
+            failures++;
+        } else {
+            if (compare_result(&golden, &results[i], time_tolerance, log) != 0) {
+                failures++;
+            }
+            result_free(&golden);
+        }
+    }
+
+    if (status == 0 && update) {
+        status = write_golden(golden_path, &profile, results, count);
+        if (status == 0) {
+            fprintf(log, "Wrote golden file '%s'.\n", golden_path);
+        }
+    } else if (status == 0) {
+        if (failures > 0) {
+            fprintf(log, "%d of %d scores regressed.\n", failures, count);
+            status = -1;
+        } else {
+            fprintf(log, "All %d scores match '%s'.\n", count, golden_path);
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        result_free(&results[i]);
+    }
+    return status;
+}
@@ -0,0 +1,35 @@
+#ifndef REGRESS_H
+#define REGRESS_H
+
+#include <stdio.h>
+
+// --- Golden-Output Regression Checks ---
+//
+// Every bundled score (melody_measures, chord_measures, bass_measures,
+// north_measures and allKeys) is rendered offline to memory with the
+// "offline" profile on a single thread, and compared with a golden file:
+//
+//   <name> <frames> <hash> <seconds> <windows> <rms> <rms> ...
+//
+// The hash covers the 16-bit samples a WAV render would contain. When it
+// differs, the render still passes if it has the same length and the RMS
+// level of every window stays within a small tolerance of the golden level,
+// so harmless rounding differences between machines are not reported. The
+// render time (the best of several runs) fails the check when it exceeds
+// the golden time by more than the allowed fraction.
+
+#define REGRESS_DEFAULT_GOLDEN "regress.golden" /**< The golden file used by `make regress`. */
+#define REGRESS_DEFAULT_TIME_TOLERANCE 0.25     /**< Allowed slowdown over the golden render time (25%). */
+
+/**
+ * @brief Renders every bundled score and checks it against a golden file.
+ *
+ * @param golden_path The golden file to read, or to write when updating.
+ * @param update If non-zero, record the current renders as the new golden file instead of checking.
+ * @param time_tolerance The allowed slowdown as a fraction of the golden render time.
+ * @param log Where per-score results are reported.
+ * @return 0 if every score passed (or the golden file was written), -1 on a regression or error.
+ */
+int regress_run(const char* golden_path, int update, double time_tolerance, FILE* log);
+
+#endif // REGRESS_H
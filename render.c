@@ -0,0 +1,523 @@
+#include <limits.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "engine.h"
+#include "render.h"
+
+#define RENDER_MAX_TAIL_SECONDS 2.0   // Longest release tail waited for after the last note.
+#define RENDER_SILENCE_THRESHOLD 1e-5 // Peak level below which a block counts as silent.
+
+static int block_is_silent(const MYFLT* samples, int count) {
+    for (int i = 0; i < count; i++) {
+        if (fabs(samples[i]) > RENDER_SILENCE_THRESHOLD) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int render_player(CSOUND* csound, Player* player, RenderBlockFn on_block, void* user) {
+    int frames = (int)csoundGetKsmps(csound);
+    int nchnls = (int)csoundGetNchnls(csound);
+    const MYFLT* spout = csoundGetSpout(csound);
+
+    // Schedule and render every note.
+    while (!player_finished(player, csoundGetScoreTime(csound))) {
+        if (csoundPerformKsmps(csound) != 0) {
+            return -1;
+        }
+        if (on_block(user, spout, frames, nchnls) != 0) {
+            return -1;
+        }
+        player_update(player, csound, csoundGetScoreTime(csound));
+    }
+
+    // Keep rendering until the release tails have faded out.
+    double tail_end = csoundGetScoreTime(csound) + RENDER_MAX_TAIL_SECONDS;
+    while (csoundGetScoreTime(csound) < tail_end) {
+        if (csoundPerformKsmps(csound) != 0) {
+            return -1;
+        }
+        if (on_block(user, spout, frames, nchnls) != 0) {
+            return -1;
+        }
+        if (block_is_silent(spout, frames * nchnls)) {
+            break;
+        }
+    }
+    return 0;
+}
+
+// --- Buffered Rendering ---
+// On an instance created by engine_create_offline(), the player is stepped
+// ahead of Csound, only at the blocks in which something is due, and every
+// note is sent with a p2 offset that starts it in the block where the
+// per-block loop above would have started it. Csound then performs a whole
+// software buffer per call, so rests and sustained notes cost no host work,
+// and the audio is sample-identical to render_player().
+
+/**
+ * @brief A note waiting to be sent, with the block it starts in.
+ */
+typedef struct {
+    long block;      /**< The block in which the note starts, counted from the start of the render. */
+    PlayerNote note; /**< The note. */
+} QueuedNote;
+
+/**
+ * @brief The notes produced by the player but not yet sent to Csound, in order of their blocks.
+ */
+typedef struct {
+    QueuedNote* notes; /**< The queued notes; notes[head..count) are waiting. */
+    int head;          /**< The index of the next note to send. */
+    int count;         /**< The number of notes stored. */
+    int capacity;      /**< The allocated length of notes. */
+    long block;        /**< The block of the player update in progress. */
+    int failed;        /**< Non-zero if a note could not be stored because allocation failed. */
+} NoteQueue;
+
+/**
+ * @brief The player's schedule, laid out ahead of the blocks Csound has performed.
+ */
+typedef struct {
+    Player* player;        /**< The player being stepped. */
+    NoteQueue* queue;      /**< Receives the player's notes. */
+    int64_t start_samples; /**< The instance's sample count when the render started. */
+    int ksmps;             /**< The block size in samples. */
+    double sr;             /**< The sample rate. */
+    long next_update;      /**< The next block at which the player must be updated. */
+    long finish_block;     /**< The block at which the player finished, or -1 while it is still running. */
+} Schedule;
+
+static void queue_note(void* user, const PlayerNote* note) {
+    NoteQueue* queue = (NoteQueue*)user;
+    if (queue->count == queue->capacity) {
+        int capacity = queue->capacity == 0 ? 64 : queue->capacity * 2;
+        QueuedNote* notes = (QueuedNote*)realloc(queue->notes, capacity * sizeof(QueuedNote));
+        if (notes == NULL) {
+            queue->failed = 1;
+            return;
+        }
+        queue->notes = notes;
+        queue->capacity = capacity;
+    }
+    queue->notes[queue->count].block = queue->block;
+    queue->notes[queue->count].note = *note;
+    queue->count++;
+}
+
+/**
+ * @brief Returns the score time at the start of a block, as csoundGetScoreTime() reports it there.
+ */
+static double block_time(const Schedule* schedule, long block) {
+    return (double)(schedule->start_samples + block * schedule->ksmps) / schedule->sr;
+}
+
+/**
+ * @brief Steps the player through every update that falls before a block.
+ *
+ * The per-block loop updates the player after every block; an update in
+ * which nothing is due changes nothing, so only the blocks where a note can
+ * be due are visited. They are estimated one block early, which at worst
+ * costs one update that does nothing.
+ */
+static void schedule_until(Schedule* schedule, long end) {
+    Player* player = schedule->player;
+    while (schedule->finish_block < 0 && schedule->next_update < end) {
+        long block = schedule->next_update;
+        double time = block_time(schedule, block);
+        schedule->queue->block = block;
+        player_update(player, NULL, time);
+        if (player_finished(player, time)) {
+            schedule->finish_block = block;
+            break;
+        }
+        double next = player_next_time(player) - block_time(schedule, 0);
+        long due = (long)floor(next * schedule->sr / schedule->ksmps) - 1;
+        schedule->next_update = due > block + 1 ? due : block + 1;
+    }
+}
+
+/**
+ * @brief Sends the queued notes that start before a block, timed from the first block about to be performed.
+ */
+static void send_notes(CSOUND* csound, const Schedule* schedule, long first, long end) {
+    NoteQueue* queue = schedule->queue;
+    char score_event[128];
+    while (queue->head < queue->count && queue->notes[queue->head].block < end) {
+        const QueuedNote* queued = &queue->notes[queue->head++];
+        double offset = (double)((queued->block - first) * schedule->ksmps) / schedule->sr;
+        snprintf(score_event, sizeof(score_event), "i%d %.9f %f %f %f",
+            queued->note.instrument, offset, queued->note.duration, queued->note.freq, queued->note.amp);
+        csoundInputMessage(csound, score_event);
+    }
+    if (queue->head == queue->count) {
+        queue->head = 0;
+        queue->count = 0;
+    }
+}
+
+/**
+ * @brief Counts the blocks of a performed buffer that the per-block loop would have rendered.
+ *
+ * The tail after the finish block ends the same way: at tail_end, or after
+ * the first silent block.
+ *
+ * @param done Set to 1 if the render ends within the buffer.
+ */
+static long rendered_blocks(const Schedule* schedule, const MYFLT* buffer, long first, long span, int nchnls, double tail_end, int* done) {
+    int ksmps = schedule->ksmps;
+    long blocks = 0;
+    while (blocks < span) {
+        long block = first + blocks;
+        if (schedule->finish_block >= 0 && block >= schedule->finish_block) {
+            if (block_time(schedule, block) >= tail_end) {
+                *done = 1;
+                break;
+            }
+            blocks++;
+            if (block_is_silent(buffer + (block - first) * ksmps * nchnls, ksmps * nchnls)) {
+                *done = 1;
+                break;
+            }
+        } else {
+            blocks++;
+        }
+    }
+    return blocks;
+}
+
+/**
+ * @brief Runs a player whose notes go to a queue, one software buffer per Csound call.
+ * @return 0 on success, -1 if Csound stopped early, on_block aborted or allocation failed.
+ */
+static int render_buffered(CSOUND* csound, Player* player, NoteQueue* queue, RenderBlockFn on_block, void* user) {
+    int ksmps = (int)csoundGetKsmps(csound);
+    int nchnls = (int)csoundGetNchnls(csound);
+    const MYFLT* buffer = csoundGetOutputBuffer(csound);
+    long span = csoundGetOutputBufferSize(csound) / ((long)ksmps * nchnls);
+
+    // The per-block loop first updates the player after block 0.
+    Schedule schedule = {player, queue, csoundGetCurrentTimeSamples(csound), ksmps, csoundGetSr(csound), 1, -1};
+    double tail_end = 0.0;
+    int done = 0;
+    for (long first = 0; !done; first += span) {
+        schedule_until(&schedule, first + span);
+        if (queue->failed) {
+            fprintf(stderr, "Error: Failed to allocate memory for the note queue.\n");
+            return -1;
+        }
+        if (schedule.finish_block >= 0) {
+            tail_end = block_time(&schedule, schedule.finish_block) + RENDER_MAX_TAIL_SECONDS;
+        }
+        send_notes(csound, &schedule, first, first + span);
+        if (csoundPerformBuffer(csound) != 0) {
+            return -1;
+        }
+
+        long blocks = rendered_blocks(&schedule, buffer, first, span, nchnls, tail_end, &done);
+        if (blocks > 0 && on_block(user, buffer, (int)(blocks * ksmps), nchnls) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int render_tracks(CSOUND* csound, Track* tracks, int num_tracks, double start, RenderBlockFn on_block, void* user) {
+    Player player;
+    if (player_init(&player, tracks, num_tracks, csoundGetScoreTime(csound), NULL) != 0) {
+        fprintf(stderr, "Error: Failed to allocate memory for track states.\n");
+        return -1;
+    }
+    NoteQueue queue = {NULL, 0, 0, 0, 0, 0};
+    int buffered = engine_has_host_output(csound) && csoundGetOutputBufferSize(csound) >= (long)csoundGetKsmps(csound) * csoundGetNchnls(csound);
+    if (buffered) {
+        // Retriggered notes of a seek land in the queue too, in block 0.
+        player.on_note = queue_note;
+        player.note_user = &queue;
+    }
+    if (start > 0 && player_seek(&player, csound, start) != 0) {
+        fprintf(stderr, "Error: Cannot start at %.3f seconds, which is outside the piece.\n", start);
+        player_free(&player);
+        free(queue.notes);
+        return -1;
+    }
+
+    int result = buffered
+        ? render_buffered(csound, &player, &queue, on_block, user)
+        : render_player(csound, &player, on_block, user);
+    player_free(&player);
+    free(queue.notes);
+    return result;
+}
+
+// --- Preloaded Scores ---
+// The whole piece can also be laid out before the render as one Csound
+// score: the player is stepped to its end exactly as above, and every note
+// becomes an i statement timed at the start of the block it would have been
+// sent in. Csound reads the score once, before it performs, so the render
+// costs no host work per note, and the audio is the same as render_tracks().
+
+/**
+ * @brief Score text being built.
+ */
+typedef struct {
+    char* text;
+    size_t length;
+    size_t capacity;
+    int failed; /**< Non-zero if the text could not grow. */
+} ScoreText;
+
+static void score_append(ScoreText* score, const char* format, ...) {
+    while (!score->failed) {
+        size_t room = score->capacity - score->length;
+        va_list args;
+        va_start(args, format);
+        int needed = vsnprintf(score->text + score->length, room, format, args);
+        va_end(args);
+        if (needed >= 0 && (size_t)needed < room) {
+            score->length += needed;
+            return;
+        }
+        size_t capacity = score->capacity * 2 + (needed > 0 ? needed : 0);
+        char* text = needed >= 0 ? (char*)realloc(score->text, capacity) : NULL;
+        if (text == NULL) {
+            score->failed = 1;
+            return;
+        }
+        score->text = text;
+        score->capacity = capacity;
+    }
+}
+
+char* render_build_score(Track* tracks, int num_tracks, double start, double sr, int ksmps, int* note_count) {
+    Player player;
+    if (player_init(&player, tracks, num_tracks, 0.0, NULL) != 0) {
+        fprintf(stderr, "Error: Failed to allocate memory for track states.\n");
+        return NULL;
+    }
+    NoteQueue queue = {NULL, 0, 0, 0, 0, 0};
+    player.on_note = queue_note;
+    player.note_user = &queue;
+    if (start > 0 && player_seek(&player, NULL, start) != 0) {
+        fprintf(stderr, "Error: Cannot start at %.3f seconds, which is outside the piece.\n", start);
+        player_free(&player);
+        free(queue.notes);
+        return NULL;
+    }
+    Schedule schedule = {&player, &queue, 0, ksmps, sr, 1, -1};
+    schedule_until(&schedule, LONG_MAX);
+    player_free(&player);
+
+    // About 48 bytes per i statement; the text grows if that is not enough.
+    ScoreText score = {NULL, 0, 256 + (size_t)queue.count * 48, queue.failed};
+    score.text = score.failed ? NULL : (char*)malloc(score.capacity);
+    score.failed = score.text == NULL;
+    score_append(&score, "; %d notes, timed for sr=%g and ksmps=%d.\n", queue.count, sr, ksmps);
+    for (int i = 0; i < queue.count; i++) {
+        const QueuedNote* queued = &queue.notes[i];
+        score_append(&score, "i%d %.9f %f %f %f\n", queued->note.instrument, block_time(&schedule, queued->block),
+            queued->note.duration, queued->note.freq, queued->note.amp);
+    }
+    // The end of the piece plus the longest release tail, as render_score() reads it back.
+    score_append(&score, "e %.9f\n", block_time(&schedule, schedule.finish_block) + RENDER_MAX_TAIL_SECONDS);
+    free(queue.notes);
+    if (score.failed) {
+        fprintf(stderr, "Error: Failed to allocate memory for the score.\n");
+        free(score.text);
+        return NULL;
+    }
+    if (note_count != NULL) {
+        *note_count = queue.count;
+    }
+    return score.text;
+}
+
+int render_score(CSOUND* csound, const char* score, RenderBlockFn on_block, void* user) {
+    int ksmps = (int)csoundGetKsmps(csound);
+    int nchnls = (int)csoundGetNchnls(csound);
+    if (!engine_has_host_output(csound) || csoundGetOutputBufferSize(csound) < (long)ksmps * nchnls) {
+        fprintf(stderr, "Error: A preloaded score can only be rendered on an instance from engine_create_offline().\n");
+        return -1;
+    }
+    if (csoundGetCurrentTimeSamples(csound) != 0) {
+        fprintf(stderr, "Error: A preloaded score must be rendered before the instance has performed.\n");
+        return -1;
+    }
+
+    // Csound would stop at the e statement; the render ends the tail itself, as render_tracks() does.
+    char* events = (char*)malloc(strlen(score) + 1);
+    if (events == NULL) {
+        fprintf(stderr, "Error: Failed to allocate memory for the score.\n");
+        return -1;
+    }
+    size_t length = 0;
+    double end = -1.0;
+    for (const char* line = score; *line != '\0';) {
+        const char* next = strchr(line, '\n');
+        size_t size = next != NULL ? (size_t)(next - line) + 1 : strlen(line);
+        const char* statement = line + strspn(line, " \t");
+        if (*statement == 'e') {
+            sscanf(statement + 1, "%lf", &end);
+        } else {
+            memcpy(events + length, line, size);
+            length += size;
+        }
+        line += size;
+    }
+    events[length] = '\0';
+    if (end < RENDER_MAX_TAIL_SECONDS) {
+        fprintf(stderr, "Error: The score has no 'e' statement marking the end of the piece.\n");
+        free(events);
+        return -1;
+    }
+    double sr = csoundGetSr(csound);
+    Schedule schedule = {NULL, NULL, 0, ksmps, sr, 0, lround((end - RENDER_MAX_TAIL_SECONDS) * sr / ksmps)};
+    int loaded = csoundReadScore(csound, events);
+    free(events);
+    if (loaded != 0) {
+        fprintf(stderr, "Error: Csound could not read the score.\n");
+        return -1;
+    }
+
+    const MYFLT* buffer = csoundGetOutputBuffer(csound);
+    long span = csoundGetOutputBufferSize(csound) / ((long)ksmps * nchnls);
+    double tail_end = block_time(&schedule, schedule.finish_block) + RENDER_MAX_TAIL_SECONDS;
+    int done = 0;
+    for (long first = 0; !done; first += span) {
+        if (csoundPerformBuffer(csound) != 0) {
+            return -1;
+        }
+        long blocks = rendered_blocks(&schedule, buffer, first, span, nchnls, tail_end, &done);
+        if (blocks > 0 && on_block(user, buffer, (int)(blocks * ksmps), nchnls) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int render_save_score(const char* score, const char* path) {
+    FILE* file = fopen(path, "w");
+    if (file == NULL) {
+        perror("Error: Cannot create the score file");
+        return -1;
+    }
+    int result = fputs(score, file) < 0 ? -1 : 0;
+    if (fclose(file) != 0) {
+        result = -1;
+    }
+    if (result != 0) {
+        fprintf(stderr, "Error: Failed to write score file '%s'.\n", path);
+    }
+    return result;
+}
+
+char* render_load_score(const char* path) {
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        perror("Error: Cannot open the score file");
+        return NULL;
+    }
+    char* text = NULL;
+    long size = -1;
+    if (fseek(file, 0, SEEK_END) == 0 && (size = ftell(file)) >= 0 && fseek(file, 0, SEEK_SET) == 0) {
+        text = (char*)malloc((size_t)size + 1);
+    }
+    if (text == NULL || fread(text, 1, (size_t)size, file) != (size_t)size) {
+        fprintf(stderr, "Error: Failed to read score file '%s'.\n", path);
+        free(text);
+        fclose(file);
+        return NULL;
+    }
+    text[size] = '\0';
+    fclose(file);
+    return text;
+}
+
+/**
+ * @brief Renders a preloaded score if there is one, the tracks otherwise.
+ */
+static int render_source(CSOUND* csound, Track* tracks, int num_tracks, double start, const char* score, RenderBlockFn on_block, void* user) {
+    return score != NULL
+        ? render_score(csound, score, on_block, user)
+        : render_tracks(csound, tracks, num_tracks, start, on_block, user);
+}
+
+/**
+ * @brief Where a render's blocks are written, and the meter that measures them on the way.
+ */
+typedef struct {
+    RenderBlockFn write;
+    void* user;
+    Meter* meter; /**< May be NULL. */
+} MeteredOutput;
+
+static int write_metered_block(void* user, const MYFLT* samples, int frames, int nchnls) {
+    MeteredOutput* output = (MeteredOutput*)user;
+    if (output->meter != NULL) {
+        meter_process(output->meter, samples, frames);
+    }
+    return output->write(output->user, samples, frames, nchnls);
+}
+
+static int write_wav_block(void* user, const MYFLT* samples, int frames, int nchnls) {
+    (void)nchnls;
+    return wav_write((WavWriter*)user, samples, frames);
+}
+
+static int wav_render(CSOUND* csound, Track* tracks, int num_tracks, double start, const char* score, const char* path, WavFormat format, Meter* meter) {
+    WavWriter writer;
+    if (wav_open(&writer, path, format, (int)csoundGetSr(csound), (int)csoundGetNchnls(csound)) != 0) {
+        return -1;
+    }
+
+    MeteredOutput output = {write_wav_block, &writer, meter};
+    int result = render_source(csound, tracks, num_tracks, start, score, write_metered_block, &output);
+    if (wav_close(&writer) != 0 && result == 0) {
+        fprintf(stderr, "Error: Failed to write WAV file '%s'.\n", path);
+        result = -1;
+    }
+    return result;
+}
+
+static int write_pcm_block(void* user, const MYFLT* samples, int frames, int nchnls) {
+    return pcm_stream_write((PcmStream*)user, samples, (size_t)frames * nchnls);
+}
+
+static int pcm_render(CSOUND* csound, Track* tracks, int num_tracks, double start, const char* score, int fd, PcmFormat format, Meter* meter) {
+    PcmStream stream;
+    if (pcm_stream_open(&stream, fd, format, PCM_BATCH_BYTES) != 0) {
+        fprintf(stderr, "Error: Failed to allocate memory for the PCM stream.\n");
+        return -1;
+    }
+
+    MeteredOutput output = {write_pcm_block, &stream, meter};
+    int result = render_source(csound, tracks, num_tracks, start, score, write_metered_block, &output);
+    if (pcm_stream_close(&stream) != 0) {
+        result = -1;
+    }
+    if (result != 0) {
+        fprintf(stderr, "Error: PCM stream on descriptor %d ended early.\n", fd);
+    }
+    return result;
+}
+
+int render_to_wav(CSOUND* csound, Track* tracks, int num_tracks, double start, const char* path, WavFormat format, Meter* meter) {
+    return wav_render(csound, tracks, num_tracks, start, NULL, path, format, meter);
+}
+
+int render_score_to_wav(CSOUND* csound, const char* score, const char* path, WavFormat format, Meter* meter) {
+    return wav_render(csound, NULL, 0, 0.0, score, path, format, meter);
+}
+
+int render_to_pcm(CSOUND* csound, Track* tracks, int num_tracks, double start, int fd, PcmFormat format, Meter* meter) {
+    return pcm_render(csound, tracks, num_tracks, start, NULL, fd, format, meter);
+}
+
+int render_score_to_pcm(CSOUND* csound, const char* score, int fd, PcmFormat format, Meter* meter) {
+    return pcm_render(csound, NULL, 0, 0.0, score, fd, format, meter);
+}
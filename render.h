@@ -0,0 +1,160 @@
+#ifndef RENDER_H
+#define RENDER_H
+
+#include <csound.h>
+#include "meter.h"
+#include "pcm.h"
+#include "player.h"
+#include "score.h"
+#include "wav.h"
+
+// --- Offline Rendering ---
+
+/**
+ * @brief Receives each block of rendered audio.
+ * @param user The pointer passed to render_tracks().
+ * @param samples Interleaved samples of the block, frames * nchnls values.
+ * @param frames The number of sample frames in the block.
+ * @param nchnls The number of channels.
+ * @return 0 to continue, non-zero to abort the render.
+ */
+typedef int (*RenderBlockFn)(void* user, const MYFLT* samples, int frames, int nchnls);
+
+/**
+ * @brief Runs a prepared player on a started Csound instance as fast as possible.
+ *
+ * Rendering continues until the player has finished and the release tails
+ * have died away. render_tracks() is built on this; it is exposed for
+ * renders that need a player configured differently, such as stems.
+ *
+ * @param csound A started Csound instance created without audio output.
+ * @param player A player initialized at the instance's current score time.
+ * @param on_block Called with every block of audio.
+ * @param user Passed through to on_block.
+ * @return 0 on success, -1 if Csound stopped early or on_block aborted.
+ */
+int render_player(CSOUND* csound, Player* player, RenderBlockFn on_block, void* user);
+
+/**
+ * @brief Renders tracks on a started Csound instance as fast as possible.
+ *
+ * The instance must have been created without audio output ("-n") or by
+ * engine_create_offline(). Rendering starts at the current score time and
+ * continues until the last note and its release tail have died away, so the
+ * instance is silent afterwards and can be reused for the next piece without
+ * being recreated.
+ *
+ * On an instance from engine_create_offline(), notes are scheduled ahead
+ * with p2 offsets and Csound performs a whole software buffer per call
+ * instead of returning to the host after every control block; blocks are
+ * then passed to on_block in runs of up to a buffer. The audio is the same
+ * either way.
+ *
+ * @param csound A started Csound instance.
+ * @param tracks The tracks to render.
+ * @param num_tracks The number of tracks.
+ * @param start Where in the piece to begin, in seconds (0 for the beginning). Notes sounding there are retriggered.
+ * @param on_block Called with every block of audio.
+ * @param user Passed through to on_block.
+ * @return 0 on success, -1 if Csound stopped early, on_block aborted or start is outside the piece.
+ */
+int render_tracks(CSOUND* csound, Track* tracks, int num_tracks, double start, RenderBlockFn on_block, void* user);
+
+/**
+ * @brief Renders tracks into a WAV file.
+ * @param csound A started Csound instance created without audio output.
+ * @param tracks The tracks to render.
+ * @param num_tracks The number of tracks.
+ * @param start Where in the piece to begin, in seconds.
+ * @param path The WAV file to create.
+ * @param format The sample encoding of the file.
+ * @param meter If not NULL, measures every block as it is written (see meter.h).
+ * @return 0 on success, -1 on failure.
+ */
+int render_to_wav(CSOUND* csound, Track* tracks, int num_tracks, double start, const char* path, WavFormat format, Meter* meter);
+
+/**
+ * @brief Renders tracks as raw interleaved PCM to a file descriptor, such as stdout or a pipe.
+ * @param csound A started Csound instance created without audio output.
+ * @param tracks The tracks to render.
+ * @param num_tracks The number of tracks.
+ * @param start Where in the piece to begin, in seconds.
+ * @param fd The descriptor to write to. It is not closed.
+ * @param format The sample encoding of the stream.
+ * @param meter If not NULL, measures every block as it is written (see meter.h).
+ * @return 0 on success, -1 on failure (including the reader closing the pipe, if SIGPIPE is ignored).
+ */
+int render_to_pcm(CSOUND* csound, Track* tracks, int num_tracks, double start, int fd, PcmFormat format, Meter* meter);
+
+// --- Preloaded Scores ---
+//
+// Instead of being fed to Csound as the render goes, a piece can be laid
+// out beforehand as one Csound score and loaded in a single call. The score
+// is plain text: it can be saved and rendered again later without the
+// tracks. Its i statements are timed to the control blocks of the sample
+// rate and ksmps it was built for, and its e statement marks the end of the
+// piece plus the longest release tail, so it also plays in a standalone
+// Csound run with the same orchestra.
+
+/**
+ * @brief Lays out tracks as a Csound score.
+ * @param tracks The tracks to lay out.
+ * @param num_tracks The number of tracks.
+ * @param start Where in the piece to begin, in seconds. Notes sounding there are retriggered at time 0.
+ * @param sr The sample rate the score will be rendered at.
+ * @param ksmps The block size the score will be rendered with.
+ * @param note_count If not NULL, receives the number of notes in the score.
+ * @return The score text, to be freed by the caller, or NULL on failure (an error is printed).
+ */
+char* render_build_score(Track* tracks, int num_tracks, double start, double sr, int ksmps, int* note_count);
+
+/**
+ * @brief Renders a score from render_build_score() as fast as possible.
+ *
+ * The whole score is read by Csound before the first block, then Csound
+ * performs a software buffer per call until the end of the piece and its
+ * release tail, which ends the same way as in render_tracks().
+ *
+ * @param csound A started instance from engine_create_offline() that has not performed yet.
+ * @param score The score text.
+ * @param on_block Called with every block of audio.
+ * @param user Passed through to on_block.
+ * @return 0 on success, -1 if the instance or the score cannot be used, Csound stopped early or on_block aborted.
+ */
+int render_score(CSOUND* csound, const char* score, RenderBlockFn on_block, void* user);
+
+/**
+ * @brief Writes a score to a .sco file.
+ * @return 0 on success, -1 on failure (an error is printed).
+ */
+int render_save_score(const char* score, const char* path);
+
+/**
+ * @brief Reads a .sco file written by render_save_score().
+ * @return The score text, to be freed by the caller, or NULL on failure (an error is printed).
+ */
+char* render_load_score(const char* path);
+
+/**
+ * @brief Renders a preloaded score into a WAV file.
+ * @param csound A started instance from engine_create_offline() that has not performed yet.
+ * @param score The score text.
+ * @param path The WAV file to create.
+ * @param format The sample encoding of the file.
+ * @param meter If not NULL, measures every block as it is written (see meter.h).
+ * @return 0 on success, -1 on failure.
+ */
+int render_score_to_wav(CSOUND* csound, const char* score, const char* path, WavFormat format, Meter* meter);
+
+/**
+ * @brief Renders a preloaded score as raw interleaved PCM to a file descriptor.
+ * @param csound A started instance from engine_create_offline() that has not performed yet.
+ * @param score The score text.
+ * @param fd The descriptor to write to. It is not closed.
+ * @param format The sample encoding of the stream.
+ * @param meter If not NULL, measures every block as it is written (see meter.h).
+ * @return 0 on success, -1 on failure (including the reader closing the pipe, if SIGPIPE is ignored).
+ */
+int render_score_to_pcm(CSOUND* csound, const char* score, int fd, PcmFormat format, Meter* meter);
+
+#endif // RENDER_H
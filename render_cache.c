@@ -0,0 +1,443 @@
+#include <limits.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "instruments.h"
+#include "player.h"
+#include "render_cache.h"
+#include "timeline.h"
+#include "wav.h"
+
+#define CACHE_MAGIC "RCM1"              // Identifies a cached measure file.
+#define CACHE_MAX_TAIL_SECONDS 2.0      // Longest time kept after a measure's releases should have ended.
+#define CACHE_DUE_TOLERANCE 1e-9        // As the player's: notes due this close to a block start in it.
+#define CACHE_SILENCE_THRESHOLD 1e-5    // Peak level below which a block counts as silent.
+#define CACHE_ZERO_FRAMES 1024          // Frames of silence written per call for gaps.
+
+#define FNV_OFFSET_BASIS 1469598103934665603ULL
+#define FNV_PRIME 1099511628211ULL
+
+// --- Cache Structures ---
+
+/**
+ * @brief The header at the start of every cached measure file.
+ *
+ * It is followed by frames * nchnls interleaved float samples.
+ */
+typedef struct {
+    char magic[4];
+    uint32_t nchnls;
+    uint32_t sr;
+    uint32_t reserved;
+    uint64_t frames;
+} CacheHeader;
+
+/**
+ * @brief One measure of one track: the unit that is cached.
+ */
+typedef struct {
+    int first_note;   /**< Index of the segment's first note in the sorted note list. */
+    int note_count;   /**< Number of notes in the segment. */
+    long block;       /**< The block in which the earliest note starts; cached audio begins here. */
+    long offset;      /**< block in sample frames. */
+    uint64_t key;     /**< Content hash naming the cache file. */
+} Segment;
+
+// --- Hashing ---
+
+static uint64_t fnv1a(uint64_t hash, const void* data, size_t size) {
+    const unsigned char* bytes = (const unsigned char*)data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+/**
+ * @brief Hashes everything about the engine that changes the sound of a note.
+ */
+static uint64_t orchestra_version(const EngineProfile* profile) {
+    char* orc = get_orchestra_string(profile->sr, profile->ksmps, profile->nchnls);
+    if (orc == NULL) {
+        return 0;
+    }
+    uint64_t hash = fnv1a(FNV_OFFSET_BASIS, orc, strlen(orc));
+    free(orc);
+    return hash;
+}
+
+/**
+ * @brief Returns the block in which --render starts a note.
+ *
+ * The player is updated at the start of every block after block 0 and plays
+ * the notes that are due by then, so a note sounds from the first such block
+ * at or after its time. Placing cached notes on the same grid keeps a cached
+ * render sample-aligned with an uncached one.
+ */
+static long note_block(double time, double sr, int ksmps) {
+    long block = (long)ceil((time - CACHE_DUE_TOLERANCE) * sr / ksmps);
+    if (block < 1) {
+        return 1;
+    }
+    // Settle floating-point rounding the way the player's comparison does.
+    while (block > 1 && (double)((block - 1) * ksmps) / sr >= time - CACHE_DUE_TOLERANCE) {
+        block--;
+    }
+    while ((double)(block * ksmps) / sr < time - CACHE_DUE_TOLERANCE) {
+        block++;
+    }
+    return block;
+}
+
+static uint64_t segment_key(uint64_t version, const PlayerNote* notes, int count, long block, double sr, int ksmps) {
+    uint64_t hash = version;
+    for (int i = 0; i < count; i++) {
+        int64_t onset = note_block(notes[i].time, sr, ksmps) - block;
+        double fields[3] = {notes[i].duration, notes[i].freq, notes[i].amp};
+        int instrument = notes[i].instrument;
+        hash = fnv1a(hash, &instrument, sizeof(instrument));
+        hash = fnv1a(hash, &onset, sizeof(onset));
+        hash = fnv1a(hash, fields, sizeof(fields));
+    }
+    return hash;
+}
+
+// --- Planning ---
+
+static int compare_notes(const void* a, const void* b) {
+    const PlayerNote* x = (const PlayerNote*)a;
+    const PlayerNote* y = (const PlayerNote*)b;
+    if (x->track != y->track) return x->track - y->track;
+    if (x->measure != y->measure) return x->measure - y->measure;
+    if (x->time != y->time) return x->time < y->time ? -1 : 1;
+    return 0;
+}
+
+static int compare_segments(const void* a, const void* b) {
+    const Segment* x = (const Segment*)a;
+    const Segment* y = (const Segment*)b;
+    return (x->offset > y->offset) - (x->offset < y->offset);
+}
+
+/**
+ * @brief Lays the piece out with the player's own timing and splits it into segments.
+ * @return The number of segments, or -1 on allocation failure.
+ */
+static int plan_segments(Track* tracks, int num_tracks, int sr, int ksmps, uint64_t version, Timeline* list, Segment** segments_out) {
+    if (timeline_build(list, tracks, num_tracks, 0.0, -1.0) != 0) {
+        return -1;
+    }
+
+    qsort(list->notes, list->count, sizeof(PlayerNote), compare_notes);
+
+    Segment* segments = (Segment*)malloc((list->count > 0 ? list->count : 1) * sizeof(Segment));
+    if (segments == NULL) {
+        return -1;
+    }
+    int count = 0;
+    for (int i = 0; i < list->count;) {
+        int j = i + 1;
+        while (j < list->count && list->notes[j].track == list->notes[i].track && list->notes[j].measure == list->notes[i].measure) {
+            j++;
+        }
+        Segment* segment = &segments[count++];
+        segment->first_note = i;
+        segment->note_count = j - i;
+        segment->block = note_block(list->notes[i].time, sr, ksmps);
+        segment->offset = segment->block * ksmps;
+        segment->key = segment_key(version, &list->notes[i], j - i, segment->block, sr, ksmps);
+        i = j;
+    }
+    qsort(segments, count, sizeof(Segment), compare_segments);
+
+    *segments_out = segments;
+    return count;
+}
+
+// --- Cache Files ---
+
+static void segment_path(char* path, size_t size, const char* cache_dir, uint64_t key) {
+    snprintf(path, size, "%s/%016llx.pcm", cache_dir, (unsigned long long)key);
+}
+
+/**
+ * @brief Synthesizes one segment on a started instance and stores it in the cache.
+ *
+ * The segment is rendered until every note's release has ended, so its
+ * whole tail is cached with it, and the instance is rewound afterwards so
+ * the next segment starts from silence.
+ *
+ * @return 0 on success, -1 on failure.
+ */
+static int render_segment(CSOUND* csound, const PlayerNote* notes, int count, long block, const char* path) {
+    int ksmps = (int)csoundGetKsmps(csound);
+    int nchnls = (int)csoundGetNchnls(csound);
+    double sr = csoundGetSr(csound);
+    const MYFLT* spout = csoundGetSpout(csound);
+
+    double end = 0.0;
+    char score_event[128];
+    for (int i = 0; i < count; i++) {
+        // Onsets are whole blocks from the segment's start, as --render sends them.
+        double onset = (double)((note_block(notes[i].time, sr, ksmps) - block) * ksmps) / sr;
+        snprintf(score_event, sizeof(score_event), "i%d %.9f %f %f %f",
+            notes[i].instrument, onset, notes[i].duration, notes[i].freq, notes[i].amp);
+        csoundInputMessage(csound, score_event);
+        double release = onset + notes[i].duration + instrument_release_seconds(notes[i].instrument, notes[i].duration);
+        if (release > end) {
+            end = release;
+        }
+    }
+
+    float* samples = NULL;
+    long frames = 0;
+    long capacity = 0;
+    double t0 = csoundGetScoreTime(csound);
+    double tail_end = t0 + end + CACHE_MAX_TAIL_SECONDS;
+    int result = 0;
+
+    for (;;) {
+        double elapsed = csoundGetScoreTime(csound) - t0;
+        if (csoundGetScoreTime(csound) >= tail_end || csoundPerformKsmps(csound) != 0) {
+            break;
+        }
+        if (frames + ksmps > capacity) {
+            long new_capacity = capacity == 0 ? 65536 : capacity * 2;
+            float* grown = (float*)realloc(samples, new_capacity * nchnls * sizeof(float));
+            if (grown == NULL) {
+                result = -1;
+                break;
+            }
+            samples = grown;
+            capacity = new_capacity;
+        }
+        int silent = 1;
+        for (int i = 0; i < ksmps * nchnls; i++) {
+            samples[frames * nchnls + i] = (float)spout[i];
+            if (fabs(spout[i]) > CACHE_SILENCE_THRESHOLD) {
+                silent = 0;
+            }
+        }
+        frames += ksmps;
+        if (elapsed >= end && silent) {
+            break; // The notes are over and their tails have faded out.
+        }
+    }
+    csoundRewindScore(csound);
+
+    if (result == 0) {
+        // Write under a temporary name first so readers never see a partial file.
+        char temp_path[PATH_MAX + 16];
+        snprintf(temp_path, sizeof(temp_path), "%s.%ld.tmp", path, (long)getpid());
+        FILE* file = fopen(temp_path, "wb");
+        CacheHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, CACHE_MAGIC, 4);
+        header.nchnls = (uint32_t)nchnls;
+        header.sr = (uint32_t)csoundGetSr(csound);
+        header.frames = (uint64_t)frames;
+        if (file == NULL
+            || fwrite(&header, sizeof(header), 1, file) != 1
+            || fwrite(samples, sizeof(float) * nchnls, (size_t)frames, file) != (size_t)frames
+            || fclose(file) != 0
+            || rename(temp_path, path) != 0) {
+            fprintf(stderr, "Error: Cannot write cache file '%s'.\n", path);
+            result = -1;
+        }
+    }
+
+    free(samples);
+    return result;
+}
+
+/**
+ * @brief Reads a cached segment.
+ * @return The samples (caller frees), or NULL if the file is missing or does not match the engine.
+ */
+static float* read_segment(const char* path, int nchnls, int sr, long* frames) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        return NULL;
+    }
+    CacheHeader header;
+    float* samples = NULL;
+    if (fread(&header, sizeof(header), 1, file) == 1
+        && memcmp(header.magic, CACHE_MAGIC, 4) == 0
+        && header.nchnls == (uint32_t)nchnls
+        && header.sr == (uint32_t)sr) {
+        samples = (float*)malloc((header.frames > 0 ? header.frames : 1) * nchnls * sizeof(float));
+        if (samples != NULL && fread(samples, sizeof(float) * nchnls, header.frames, file) != header.frames) {
+            free(samples);
+            samples = NULL;
+        }
+        *frames = (long)header.frames;
+    }
+    fclose(file);
+    return samples;
+}
+
+// --- Mixing ---
+
+/**
+ * @brief Meters and writes frames of audio to the output.
+ */
+static int write_frames(WavWriter* writer, const MYFLT* samples, int frames, Meter* meter) {
+    if (meter != NULL) {
+        meter_process(meter, samples, frames);
+    }
+    return wav_write(writer, samples, frames);
+}
+
+/**
+ * @brief Writes frames of silence to the output.
+ */
+static int write_silence(WavWriter* writer, long frames, Meter* meter) {
+    static const MYFLT zeros[CACHE_ZERO_FRAMES * 8] = {0};
+    int per_call = CACHE_ZERO_FRAMES * 8 / writer->nchnls;
+    while (frames > 0) {
+        int n = frames > per_call ? per_call : (int)frames;
+        if (write_frames(writer, zeros, n, meter) != 0) {
+            return -1;
+        }
+        frames -= n;
+    }
+    return 0;
+}
+
+/**
+ * @brief Overlap-adds every cached segment into the WAV file in time order.
+ *
+ * Only a window as long as the longest segment is held in memory: audio
+ * before the next segment's start can no longer change and is written out.
+ */
+static int mix_segments(const Segment* segments, int count, const char* cache_dir, WavWriter* writer, Meter* meter) {
+    int nchnls = writer->nchnls;
+    MYFLT* window = NULL; // Mixed audio starting at window_start.
+    long window_start = 0;
+    long window_frames = 0;
+    long window_capacity = 0;
+    int result = 0;
+
+    for (int s = 0; s <= count && result == 0; s++) {
+        // Everything before the next segment (or the whole window at the end) is final.
+        long flush = (s < count) ? segments[s].offset - window_start : window_frames;
+        if (flush > 0) {
+            long mixed = flush < window_frames ? flush : window_frames;
+            if (write_frames(writer, window, (int)mixed, meter) != 0 || write_silence(writer, flush - mixed, meter) != 0) {
+                result = -1;
+                break;
+            }
+            if (mixed > 0) {
+                memmove(window, window + mixed * nchnls, (window_frames - mixed) * nchnls * sizeof(MYFLT));
+                memset(window + (window_frames - mixed) * nchnls, 0, mixed * nchnls * sizeof(MYFLT));
+            }
+            window_frames -= mixed;
+            window_start += flush;
+        }
+        if (s == count) {
+            break;
+        }
+
+        char path[PATH_MAX];
+        long frames = 0;
+        segment_path(path, sizeof(path), cache_dir, segments[s].key);
+        float* samples = read_segment(path, nchnls, writer->sr, &frames);
+        if (samples == NULL) {
+            fprintf(stderr, "Error: Cached measure '%s' is missing or invalid.\n", path);
+            result = -1;
+            break;
+        }
+
+        if (frames > window_capacity) {
+            MYFLT* grown = (MYFLT*)realloc(window, frames * nchnls * sizeof(MYFLT));
+            if (grown == NULL) {
+                free(samples);
+                result = -1;
+                break;
+            }
+            memset(grown + window_capacity * nchnls, 0, (frames - window_capacity) * nchnls * sizeof(MYFLT));
+            window = grown;
+            window_capacity = frames;
+        }
+        for (long i = 0; i < frames * nchnls; i++) {
+            window[i] += samples[i];
+        }
+        if (frames > window_frames) {
+            window_frames = frames;
+        }
+        free(samples);
+    }
+
+    free(window);
+    return result;
+}
+
+// --- Public API ---
+
+int render_cache_render(const EngineProfile* profile, Track* tracks, int num_tracks,
+    const char* cache_dir, const char* output_path, RenderCacheStats* stats, Meter* meter) {
+    RenderCacheStats counters = {0, 0, 0};
+    uint64_t version = orchestra_version(profile);
+    if (version == 0) {
+        fprintf(stderr, "Error: Failed to allocate memory for orchestra string.\n");
+        return -1;
+    }
+
+    Timeline list;
+    timeline_init(&list);
+    Segment* segments = NULL;
+    int count = plan_segments(tracks, num_tracks, profile->sr, profile->ksmps, version, &list, &segments);
+    if (count < 0) {
+        fprintf(stderr, "Error: Failed to allocate memory for the render plan.\n");
+        timeline_free(&list);
+        return -1;
+    }
+    counters.segments = count;
+
+    // Synthesize the segments that are not cached yet. Repeated measures share
+    // a key, so each distinct measure is rendered at most once.
+    CSOUND* csound = NULL;
+    int result = 0;
+    for (int s = 0; s < count && result == 0; s++) {
+        char path[PATH_MAX];
+        segment_path(path, sizeof(path), cache_dir, segments[s].key);
+        if (access(path, R_OK) == 0) {
+            counters.hits++;
+            continue;
+        }
+        if (csound == NULL) {
+            csound = engine_create(profile, "-n");
+            if (csound == NULL || csoundStart(csound) != 0) {
+                result = -1;
+                break;
+            }
+        }
+        const Segment* segment = &segments[s];
+        result = render_segment(csound, &list.notes[segment->first_note], segment->note_count, segment->block, path);
+        counters.rendered++;
+    }
+    engine_destroy(csound);
+
+    if (result == 0) {
+        WavWriter writer;
+        result = wav_open(&writer, output_path, WAV_PCM16, profile->sr, profile->nchnls);
+        if (result == 0) {
+            result = mix_segments(segments, count, cache_dir, &writer, meter);
+            if (wav_close(&writer) != 0) {
+                result = -1;
+            }
+        }
+    }
+
+    free(segments);
+    timeline_free(&list);
+    if (stats != NULL) {
+        *stats = counters;
+    }
+    return result;
+}
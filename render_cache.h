@@ -0,0 +1,46 @@
+#ifndef RENDER_CACHE_H
+#define RENDER_CACHE_H
+
+#include "engine.h"
+#include "meter.h"
+#include "score.h"
+
+// --- Incremental Render Cache ---
+//
+// Every measure of every track is rendered on its own, including its release
+// tail, with its notes on the same ksmps block grid as an uncached render,
+// and stored on disk under a hash of its content: the orchestra and
+// engine settings, the instrument, and each note's onset, duration,
+// frequency and amplitude (the tempo is part of the durations in seconds).
+// A render reuses every measure whose hash is already in the cache and
+// overlap-adds all measures into the output, so an edit only re-synthesizes
+// the measures it touched.
+
+/**
+ * @brief Counters describing one cached render.
+ */
+typedef struct {
+    int segments; /**< Measures with audible notes in the piece. */
+    int hits;     /**< Measures taken from the cache. */
+    int rendered; /**< Measures synthesized by this render. */
+} RenderCacheStats;
+
+/**
+ * @brief Renders tracks into a WAV file, reusing cached measures.
+ *
+ * A Csound instance is only created if at least one measure is missing from
+ * the cache, so a fully cached piece is assembled without starting Csound.
+ *
+ * @param profile The engine profile (part of every cache key).
+ * @param tracks The tracks to render.
+ * @param num_tracks The number of tracks.
+ * @param cache_dir An existing directory holding the cached measures.
+ * @param output_path The WAV file to create.
+ * @param stats Receives the cache counters. May be NULL.
+ * @param meter Measures the mix as it is spliced, or NULL.
+ * @return 0 on success, -1 on failure.
+ */
+int render_cache_render(const EngineProfile* profile, Track* tracks, int num_tracks,
+    const char* cache_dir, const char* output_path, RenderCacheStats* stats, Meter* meter);
+
+#endif // RENDER_CACHE_H
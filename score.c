@@ -1,3 +1,4 @@
+#include <stddef.h> // For NULL
 #include "score.h"
 
 // --- "Twinkle, Twinkle, Little Star" Score Definition ---
@@ -26,21 +27,27 @@ MusicEvent melody_m4[] = { {D4, QUARTER_NOTE}, {D4, QUARTER_NOTE}, {C4, HALF_NOT
 MusicEvent melody_m5[] = { {G4, QUARTER_NOTE}, {G4, QUARTER_NOTE}, {F4, QUARTER_NOTE}, {F4, QUARTER_NOTE} };
 MusicEvent melody_m6[] = { {E4, QUARTER_NOTE}, {E4, QUARTER_NOTE}, {D4, HALF_NOTE} };
 
+// Each distinct measure appears once; melody_sections below decides the order.
 Measure melody_measures[] = {
-    {melody_m1, sizeof(melody_m1) / sizeof(MusicEvent), 4, 4, 100.0}, // 4/4 Time, Start at 100 BPM
+    {melody_m1, sizeof(melody_m1) / sizeof(MusicEvent), 4, 4, 0},
     {melody_m2, sizeof(melody_m2) / sizeof(MusicEvent), 4, 4, 0},
     {melody_m3, sizeof(melody_m3) / sizeof(MusicEvent), 4, 4, 0},
-    {melody_m4, sizeof(melody_m4) / sizeof(MusicEvent), 4, 4, 160.0}, // Speed up to 160 BPM!
+    {melody_m4, sizeof(melody_m4) / sizeof(MusicEvent), 4, 4, 0},
     {melody_m5, sizeof(melody_m5) / sizeof(MusicEvent), 4, 4, 0},
     {melody_m6, sizeof(melody_m6) / sizeof(MusicEvent), 4, 4, 0},
-    // Repeat
-    {melody_m1, sizeof(melody_m1) / sizeof(MusicEvent), 4, 4, 100.0}, // Back to 100 BPM
-    {melody_m2, sizeof(melody_m2) / sizeof(MusicEvent), 4, 4, 0},
-    {melody_m3, sizeof(melody_m3) / sizeof(MusicEvent), 4, 4, 0},
-    {melody_m4, sizeof(melody_m4) / sizeof(MusicEvent), 4, 4, 0},
 };
 const int MELODY_MEASURE_COUNT = sizeof(melody_measures) / sizeof(Measure);
 
+// m1-m3 twice, with m4-m6 as the first ending and m4 alone as the second.
+static const MeasureRange melody_endings[] = {
+    {3, 3, 160.0}, // 1st time: m4-m6, speed up to 160 BPM!
+    {3, 1, 0},     // 2nd time: m4 only
+};
+const Section melody_sections[] = {
+    {{0, 3, 100.0}, 2, melody_endings, 2}, // 4/4 Time, 100 BPM on every pass
+};
+const int MELODY_SECTION_COUNT = sizeof(melody_sections) / sizeof(Section);
+
 // --- Chord Track Data ---
 // Chord indices correspond to the `chords` array in instrument_piano.c
 // Triads: 0=C, 1=Dm, 2=Em, 3=F, 4=G, 5=Am, 6=Bdim
@@ -58,24 +65,27 @@ MusicEvent chord_m_V7[] = { {CHORD_G7,    WHOLE_NOTE} }; // G7  (V)
 MusicEvent chord_m_I7[] = { {CHORD_Cmaj7, WHOLE_NOTE} }; // Cmaj7 (I)
 
 Measure chord_measures[] = {
-    {chord_m1, 1, 4, 4, 100.0}, // 4/4 Time, Start at 100 BPM
-    {chord_m2, 1, 4, 4, 0},
-    {chord_m3, 1, 4, 4, 0},
-    {chord_m4, 1, 4, 4, 160.0}, // Speed up to 160 BPM!
-    {chord_m1, 1, 4, 4, 0},
-    {chord_m2, 1, 4, 4, 0},
+    {chord_m1,    1, 4, 4, 0}, // 0: C
+    {chord_m2,    1, 4, 4, 0}, // 1: G
+    {chord_m3,    1, 4, 4, 0}, // 2: C
+    {chord_m4,    1, 4, 4, 0}, // 3: F
+    {chord_m_ii7, 1, 4, 4, 0}, // 4: Dm7 (ii)
+    {chord_m_V7,  1, 4, 4, 0}, // 5: G7  (V)
+    {chord_m_I7,  1, 4, 4, 0}, // 6: Cmaj7 (I)
+};
+const int CHORD_MEASURE_COUNT = sizeof(chord_measures) / sizeof(Measure);
+
+const Section chord_sections[] = {
+    {{0, 3, 100.0}, 1, NULL, 0}, // C G C, 4/4 Time, Start at 100 BPM
+    {{3, 1, 160.0}, 1, NULL, 0}, // F, Speed up to 160 BPM!
+    {{0, 2, 0},     1, NULL, 0}, // C G
     // Repeat
-    {chord_m1, 1, 4, 4, 100.0}, // Back to 100 BPM
-    {chord_m2, 1, 4, 4, 0},
-    {chord_m3, 1, 4, 4, 0},
-    {chord_m4, 1, 4, 4, 0},
+    {{0, 4, 100.0}, 1, NULL, 0}, // C G C F, Back to 100 BPM
     // --- Part 2: Seventh Chord Progression (ii-V-I) ---
-    {chord_m_ii7, 1, 4, 4, 100.0}, // Dm7 (ii)
-    {chord_m_V7,  1, 4, 4, 0},     // G7  (V)
-    {chord_m_I7,  1, 4, 4, 0},     // Cmaj7 (I)
-    {chord_m_I7,  1, 4, 4, 0},     // Cmaj7 (I)
+    {{4, 2, 100.0}, 1, NULL, 0}, // Dm7 G7
+    {{6, 1, 0},     2, NULL, 0}, // Cmaj7 twice
 };
-const int CHORD_MEASURE_COUNT = sizeof(chord_measures) / sizeof(Measure);
+const int CHORD_SECTION_COUNT = sizeof(chord_sections) / sizeof(Section);
 
 // --- Bassline Track Data ---
 MusicEvent bass_m1[] = { {C3, WHOLE_NOTE} }; // C
@@ -84,12 +94,16 @@ MusicEvent bass_m3[] = { {C3, WHOLE_NOTE} }; // C
 MusicEvent bass_m4[] = { {F2, WHOLE_NOTE} }; // F
 
 Measure bass_measures[] = {
-    {bass_m1, 1, 4, 4, 100.0}, {bass_m2, 1, 4, 4, 0}, {bass_m3, 1, 4, 4, 0}, {bass_m4, 1, 4, 4, 160.0},
-    {bass_m1, 1, 4, 4, 0},     {bass_m2, 1, 4, 4, 0}, {bass_m1, 1, 4, 4, 100.0}, {bass_m2, 1, 4, 4, 0},
-    {bass_m3, 1, 4, 4, 0},     {bass_m4, 1, 4, 4, 0},
+    {bass_m1, 1, 4, 4, 0}, {bass_m2, 1, 4, 4, 0}, {bass_m3, 1, 4, 4, 0}, {bass_m4, 1, 4, 4, 0},
 };
 const int BASS_MEASURE_COUNT = sizeof(bass_measures) / sizeof(Measure);
 
+// The same form as the first half of the chord track.
+const Section bass_sections[] = {
+    {{0, 3, 100.0}, 1, NULL, 0}, {{3, 1, 160.0}, 1, NULL, 0}, {{0, 2, 0}, 1, NULL, 0}, {{0, 4, 100.0}, 1, NULL, 0},
+};
+const int BASS_SECTION_COUNT = sizeof(bass_sections) / sizeof(Section);
+
 // --- Test/Example Score Data ---
 
 // A scale run of all piano keys
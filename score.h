@@ -24,13 +24,64 @@ typedef struct {
  * and tempo for that segment of music.
  */
 typedef struct {
-    MusicEvent* events;          /**< A pointer to an array of MusicEvent structures. */
+    const MusicEvent* events;    /**< A pointer to an array of MusicEvent structures. */
     int event_count;             /**< The number of events in this measure. */
     int beats_per_measure;       /**< The numerator of the time signature (e.g., 4 for 4/4 time). */
     int beat_unit;               /**< The denominator of the time signature (e.g., 4 for a quarter-note beat). */
     double bpm;                  /**< The tempo (Beats Per Minute) for this measure. If 0, the tempo from the previous measure is used. */
 } Measure;
 
+/**
+ * @brief A run of consecutive measures in a track's measure array.
+ */
+typedef struct {
+    int start;  /**< The index of the first measure in Track.measures. */
+    int length; /**< The number of measures in the range. */
+    double bpm; /**< If > 0, the tempo set when the range starts, overriding the first measure's bpm. */
+} MeasureRange;
+
+/**
+ * @brief A repeated section of a track's form, with optional volta endings.
+ *
+ * Every pass plays the body followed by the ending for that pass. Pass i
+ * uses endings[i], and passes beyond the last ending reuse the last one.
+ * A section without endings simply repeats its body.
+ */
+typedef struct {
+    MeasureRange body;           /**< The measures played on every pass. */
+    int times;                   /**< The number of passes. Values below 1 are treated as 1. */
+    const MeasureRange* endings; /**< The volta endings, or NULL if the section has none. */
+    int ending_count;            /**< The number of endings. */
+} Section;
+
+/**
+ * @brief Defines the type of a track, which determines how its events are interpreted.
+ */
+typedef enum {
+    TRACK_MELODY, /**< A monophonic melody line where each event is a single note. */
+    TRACK_CHORD   /**< A polyphonic chord line where each event represents a full chord. */
+} TrackType;
+
+/**
+ * @brief Represents a complete musical track, including its score and metadata.
+ *
+ * A track is a sequence of measures played by a specific instrument. The
+ * measures array holds each distinct measure once; the sections describe the
+ * order they are played in (repeats, voltas, references to earlier material)
+ * and are walked lazily, so memory scales with unique material rather than
+ * playing time. A track without sections plays its measures once in order.
+ */
+typedef struct {
+    const char* name;        /**< The name of the track, used for logging and identification. */
+    TrackType type;          /**< The type of the track (e.g., melody or chord). */
+    int instrument;          /**< The Csound instrument number (from the orchestra) to use for this track. */
+    const Measure* measures; /**< A pointer to an array of Measure structures that make up the track's score. */
+    int measure_count;       /**< The total number of measures in the track. */
+    const Section* sections; /**< The form of the track, or NULL to play the measures once in order. */
+    int section_count;       /**< The number of sections. */
+    const struct EventTable* table; /**< The measures already converted by the score compiler, or NULL to convert them at playback. */
+} Track;
+
 // --- Note Duration Constants (in beats) ---
 extern const double QUARTER_NOTE;   // 1.0 beats
 extern const double HALF_NOTE;      // 2.0 beats
@@ -51,12 +102,18 @@ extern const double DOTTED_SIXTEENTH_NOTE; // 0.375 beats
 
 extern Measure melody_measures[];
 extern const int MELODY_MEASURE_COUNT;
+extern const Section melody_sections[];
+extern const int MELODY_SECTION_COUNT;
 
 extern Measure chord_measures[];
 extern const int CHORD_MEASURE_COUNT;
+extern const Section chord_sections[];
+extern const int CHORD_SECTION_COUNT;
 
 extern Measure bass_measures[];
 extern const int BASS_MEASURE_COUNT;
+extern const Section bass_sections[];
+extern const int BASS_SECTION_COUNT;
 
 // --- Test/Example Score Data ---
 extern MusicEvent allKeys[];
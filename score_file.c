@@ -0,0 +1,523 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "form.h"
+#include "score_file.h"
+
+#define ARENA_ALIGNMENT 16 // Every block taken from the arena is rounded up to this size.
+
+/**
+ * @brief Totals gathered by the counting pass, used to size the arena.
+ */
+typedef struct {
+    int tracks;
+    int measures;
+    int events;
+    int sections;
+    int endings;
+    size_t name_bytes;
+} ScoreCounts;
+
+/**
+ * @brief Parser state shared by the counting and filling passes.
+ *
+ * During the counting pass `score` is NULL and only `counts` is updated.
+ */
+typedef struct {
+    const char* source; // Name used in error messages.
+    int line_number;
+    ScoreCounts counts;
+    int track_measures; // Measures seen so far in the current track.
+    ScoreFile* score;
+    MusicEvent* events; // Event storage for all measures (filling pass only).
+    Measure* measures;  // Measure storage for all tracks (filling pass only).
+    Section* sections;  // Section storage for all tracks (filling pass only).
+    MeasureRange* endings; // Volta ending storage for all sections (filling pass only).
+    char* names;        // Storage for all track names (filling pass only).
+} Parser;
+
+static size_t align_size(size_t size) {
+    return (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+}
+
+static void parse_error(const Parser* parser, const char* message, const char* token, int length) {
+    fprintf(stderr, "Error: %s:%d: %s", parser->source, parser->line_number, message);
+    if (token != NULL) {
+        fprintf(stderr, " '%.*s'", length, token);
+    }
+    fprintf(stderr, "\n");
+}
+
+/**
+ * @brief Reads the next whitespace-separated token of a line.
+ * @return 1 if a token was found, 0 at the end of the line.
+ */
+static int next_token(const char** cursor, const char* line_end, const char** token, int* length) {
+    const char* p = *cursor;
+    while (p < line_end && (*p == ' ' || *p == '\t' || *p == '\r')) {
+        p++;
+    }
+    if (p >= line_end) {
+        *cursor = p;
+        return 0;
+    }
+    const char* start = p;
+    while (p < line_end && *p != ' ' && *p != '\t' && *p != '\r') {
+        p++;
+    }
+    *token = start;
+    *length = (int)(p - start);
+    *cursor = p;
+    return 1;
+}
+
+static int token_equals(const char* token, int length, const char* word) {
+    return (int)strlen(word) == length && strncmp(token, word, length) == 0;
+}
+
+/**
+ * @brief Parses an integer token.
+ * @return 0 on success, -1 if the token is not a whole number.
+ */
+static int parse_int(const char* token, int length, int* value) {
+    char buffer[32];
+    if (length <= 0 || length >= (int)sizeof(buffer)) {
+        return -1;
+    }
+    memcpy(buffer, token, length);
+    buffer[length] = '\0';
+    char* end;
+    long result = strtol(buffer, &end, 10);
+    if (*end != '\0') {
+        return -1;
+    }
+    *value = (int)result;
+    return 0;
+}
+
+/**
+ * @brief Parses a positive decimal number token.
+ * @return 0 on success, -1 if the token is not a positive number.
+ */
+static int parse_number(const char* token, int length, double* value) {
+    char buffer[32];
+    if (length <= 0 || length >= (int)sizeof(buffer)) {
+        return -1;
+    }
+    memcpy(buffer, token, length);
+    buffer[length] = '\0';
+    char* end;
+    double result = strtod(buffer, &end);
+    if (*end != '\0' || result <= 0) {
+        return -1;
+    }
+    *value = result;
+    return 0;
+}
+
+/**
+ * @brief Parses a duration such as "q", "h.", "0.75".
+ * @return The duration in beats, or a negative value if the token is invalid.
+ */
+static double parse_duration(const char* token, int length) {
+    if (length == 1 || (length == 2 && token[1] == '.')) {
+        double beats;
+        switch (token[0]) {
+        case 'w': beats = WHOLE_NOTE; break;
+        case 'h': beats = HALF_NOTE; break;
+        case 'q': beats = QUARTER_NOTE; break;
+        case 'e': beats = EIGHTH_NOTE; break;
+        case 's': beats = SIXTEENTH_NOTE; break;
+        case 't': beats = THIRTY_SECOND_NOTE; break;
+        case 'x': beats = SIXTY_FOURTH_NOTE; break;
+        default: beats = -1.0; break;
+        }
+        if (beats > 0) {
+            return length == 2 ? beats * 1.5 : beats;
+        }
+    }
+
+    double beats;
+    if (parse_number(token, length, &beats) != 0) {
+        return -1.0;
+    }
+    return beats;
+}
+
+static int parse_track_line(Parser* parser, const char* cursor, const char* line_end) {
+    const char* token;
+    int length;
+    TrackType type;
+    int instrument;
+
+    if (!next_token(&cursor, line_end, &token, &length)) {
+        parse_error(parser, "Missing track type", NULL, 0);
+        return -1;
+    }
+    if (token_equals(token, length, "melody")) {
+        type = TRACK_MELODY;
+    } else if (token_equals(token, length, "chord")) {
+        type = TRACK_CHORD;
+    } else {
+        parse_error(parser, "Unknown track type", token, length);
+        return -1;
+    }
+
+    if (!next_token(&cursor, line_end, &token, &length) || parse_int(token, length, &instrument) != 0 || instrument <= 0) {
+        parse_error(parser, "Expected an instrument number", NULL, 0);
+        return -1;
+    }
+
+    // The rest of the line is the track name.
+    while (cursor < line_end && (*cursor == ' ' || *cursor == '\t')) {
+        cursor++;
+    }
+    const char* name_end = line_end;
+    while (name_end > cursor && (name_end[-1] == ' ' || name_end[-1] == '\t' || name_end[-1] == '\r')) {
+        name_end--;
+    }
+    size_t name_length = (size_t)(name_end - cursor);
+
+    if (parser->score != NULL) {
+        Track* track = &parser->score->tracks[parser->counts.tracks];
+        char* name = parser->names + parser->counts.name_bytes;
+        memcpy(name, cursor, name_length);
+        name[name_length] = '\0';
+        track->name = name;
+        track->type = type;
+        track->instrument = instrument;
+        track->measures = parser->measures + parser->counts.measures;
+        track->measure_count = 0;
+        track->sections = NULL;
+        track->section_count = 0;
+        track->table = NULL;
+    }
+    parser->counts.name_bytes += name_length + 1;
+    parser->counts.tracks++;
+    parser->track_measures = 0;
+    return 0;
+}
+
+static int parse_measure_line(Parser* parser, const char* cursor, const char* line_end) {
+    const char* token;
+    int length;
+    int beats = 0, unit = 0;
+    double bpm = 0;
+
+    if (parser->counts.tracks == 0) {
+        parse_error(parser, "Measure appears before the first track", NULL, 0);
+        return -1;
+    }
+
+    if (!next_token(&cursor, line_end, &token, &length)) {
+        parse_error(parser, "Missing time signature", NULL, 0);
+        return -1;
+    }
+    const char* slash = memchr(token, '/', length);
+    if (slash == NULL
+        || parse_int(token, (int)(slash - token), &beats) != 0
+        || parse_int(slash + 1, length - (int)(slash - token) - 1, &unit) != 0
+        || beats <= 0 || unit <= 0) {
+        parse_error(parser, "Invalid time signature", token, length);
+        return -1;
+    }
+
+    if (next_token(&cursor, line_end, &token, &length)) {
+        if (parse_number(token, length, &bpm) != 0) {
+            parse_error(parser, "Invalid tempo", token, length);
+            return -1;
+        }
+    }
+
+    if (parser->score != NULL) {
+        Track* track = &parser->score->tracks[parser->counts.tracks - 1];
+        Measure* measure = &parser->measures[parser->counts.measures];
+        track->measure_count++;
+        measure->events = parser->events + parser->counts.events;
+        measure->event_count = 0;
+        measure->beats_per_measure = beats;
+        measure->beat_unit = unit;
+        measure->bpm = bpm;
+    }
+    parser->counts.measures++;
+    parser->track_measures++;
+    return 0;
+}
+
+/**
+ * @brief Parses a measure range such as "3", "1-4" or "5-8@160" (1-based, inclusive).
+ * @return 0 on success, -1 if the token is not a range.
+ */
+static int parse_range(const char* token, int length, MeasureRange* range) {
+    double bpm = 0;
+    const char* at = memchr(token, '@', length);
+    if (at != NULL) {
+        if (parse_number(at + 1, length - (int)(at - token) - 1, &bpm) != 0) {
+            return -1;
+        }
+        length = (int)(at - token);
+    }
+
+    int first, last;
+    const char* dash = memchr(token, '-', length);
+    if (dash == NULL) {
+        if (parse_int(token, length, &first) != 0) {
+            return -1;
+        }
+        last = first;
+    } else if (parse_int(token, (int)(dash - token), &first) != 0
+        || parse_int(dash + 1, length - (int)(dash - token) - 1, &last) != 0) {
+        return -1;
+    }
+    if (first < 1 || last < first) {
+        return -1;
+    }
+    range->start = first - 1;
+    range->length = last - first + 1;
+    range->bpm = bpm;
+    return 0;
+}
+
+static int parse_play_line(Parser* parser, const char* cursor, const char* line_end) {
+    const char* token;
+    int length;
+    MeasureRange body;
+    int times = 1;
+
+    if (parser->counts.tracks == 0) {
+        parse_error(parser, "Play appears before the first track", NULL, 0);
+        return -1;
+    }
+    if (!next_token(&cursor, line_end, &token, &length) || parse_range(token, length, &body) != 0) {
+        parse_error(parser, "Expected a measure range such as 1-4 or 1-4@120", NULL, 0);
+        return -1;
+    }
+
+    Section* section = NULL;
+    if (parser->score != NULL) {
+        Track* track = &parser->score->tracks[parser->counts.tracks - 1];
+        if (track->sections == NULL) {
+            track->sections = parser->sections + parser->counts.sections;
+        }
+        section = &parser->sections[parser->counts.sections];
+        section->body = body;
+        section->endings = parser->endings + parser->counts.endings;
+        section->ending_count = 0;
+        track->section_count++;
+    }
+    parser->counts.sections++;
+
+    const char* tail = cursor;
+    if (next_token(&tail, line_end, &token, &length) && token[0] == 'x') {
+        if (parse_int(token + 1, length - 1, &times) != 0 || times < 1) {
+            parse_error(parser, "Invalid repeat count", token, length);
+            return -1;
+        }
+        cursor = tail;
+    }
+
+    // Anything left is a volta ending per pass.
+    while (next_token(&cursor, line_end, &token, &length)) {
+        MeasureRange ending;
+        if (parse_range(token, length, &ending) != 0) {
+            parse_error(parser, "Invalid ending", token, length);
+            return -1;
+        }
+        if (section != NULL) {
+            parser->endings[parser->counts.endings] = ending;
+            section->ending_count++;
+        }
+        parser->counts.endings++;
+    }
+    if (section != NULL) {
+        section->times = times;
+    }
+    return 0;
+}
+
+static int parse_event_line(Parser* parser, const char* cursor, const char* line_end) {
+    const char* token;
+    int length;
+
+    if (parser->track_measures == 0) {
+        parse_error(parser, "Events appear before the first measure of the track", NULL, 0);
+        return -1;
+    }
+
+    while (next_token(&cursor, line_end, &token, &length)) {
+        const char* colon = memchr(token, ':', length);
+        if (colon == NULL) {
+            parse_error(parser, "Expected <value>:<duration>, found", token, length);
+            return -1;
+        }
+        int value_length = (int)(colon - token);
+        double duration = parse_duration(colon + 1, length - value_length - 1);
+        if (duration <= 0) {
+            parse_error(parser, "Invalid duration in", token, length);
+            return -1;
+        }
+
+        if (parser->score != NULL) {
+            Track* track = &parser->score->tracks[parser->counts.tracks - 1];
+            int value;
+            if (token_equals(token, value_length, "R")) {
+                value = REST;
+            } else if (track->type == TRACK_CHORD) {
+                value = piano_chord_from_name(token, value_length);
+            } else {
+                value = piano_key_from_name(token, value_length);
+            }
+            if (value == -1 && !token_equals(token, value_length, "R")) {
+                parse_error(parser, track->type == TRACK_CHORD ? "Unknown chord" : "Unknown note", token, value_length);
+                return -1;
+            }
+
+            // Measures and events are stored contiguously, so the current measure is the
+            // last one stored and its events continue at the next free event slot.
+            Measure* measure = &parser->measures[parser->counts.measures - 1];
+            MusicEvent* event = &parser->events[parser->counts.events];
+            measure->event_count++;
+            event->value = value;
+            event->duration = duration;
+        }
+        parser->counts.events++;
+    }
+    return 0;
+}
+
+/**
+ * @brief Runs one pass over the score text.
+ * @return 0 on success, -1 on a syntax error.
+ */
+static int parse_pass(Parser* parser, const char* text) {
+    const char* line = text;
+    parser->line_number = 0;
+    parser->track_measures = 0;
+    memset(&parser->counts, 0, sizeof(parser->counts));
+
+    while (*line != '\0') {
+        const char* line_end = strchr(line, '\n');
+        if (line_end == NULL) {
+            line_end = line + strlen(line);
+        }
+        parser->line_number++;
+
+        const char* comment = memchr(line, '#', (size_t)(line_end - line));
+        const char* content_end = comment != NULL ? comment : line_end;
+
+        const char* cursor = line;
+        const char* token;
+        int length;
+        if (next_token(&cursor, content_end, &token, &length)) {
+            int result;
+            if (token_equals(token, length, "track")) {
+                result = parse_track_line(parser, cursor, content_end);
+            } else if (token_equals(token, length, "measure")) {
+                result = parse_measure_line(parser, cursor, content_end);
+            } else if (token_equals(token, length, "play")) {
+                result = parse_play_line(parser, cursor, content_end);
+            } else {
+                result = parse_event_line(parser, line, content_end);
+            }
+            if (result != 0) {
+                return -1;
+            }
+        }
+
+        line = *line_end == '\n' ? line_end + 1 : line_end;
+    }
+    return 0;
+}
+
+int score_file_parse(const char* text, const char* name, ScoreFile* score) {
+    Parser parser;
+    memset(&parser, 0, sizeof(parser));
+    parser.source = name;
+
+    // First pass: validate the syntax and count everything that needs storage.
+    if (parse_pass(&parser, text) != 0) {
+        return -1;
+    }
+    if (parser.counts.tracks == 0) {
+        fprintf(stderr, "Error: %s: The score contains no tracks.\n", name);
+        return -1;
+    }
+    ScoreCounts counts = parser.counts;
+
+    size_t tracks_size = align_size(counts.tracks * sizeof(Track));
+    size_t measures_size = align_size(counts.measures * sizeof(Measure));
+    size_t events_size = align_size(counts.events * sizeof(MusicEvent));
+    size_t sections_size = align_size(counts.sections * sizeof(Section));
+    size_t endings_size = align_size(counts.endings * sizeof(MeasureRange));
+    size_t names_size = align_size(counts.name_bytes);
+
+    score->arena = arena_create(tracks_size + measures_size + events_size + sections_size + endings_size + names_size + ARENA_ALIGNMENT);
+    if (score->arena == NULL) {
+        fprintf(stderr, "Error: Failed to allocate memory for score '%s'.\n", name);
+        return -1;
+    }
+    score->tracks = (Track*)arena_alloc(score->arena, tracks_size);
+    parser.measures = (Measure*)arena_alloc(score->arena, measures_size);
+    parser.events = (MusicEvent*)arena_alloc(score->arena, events_size);
+    parser.sections = (Section*)arena_alloc(score->arena, sections_size);
+    parser.endings = (MeasureRange*)arena_alloc(score->arena, endings_size);
+    parser.names = (char*)arena_alloc(score->arena, names_size);
+    score->track_count = counts.tracks;
+
+    // Second pass: fill the arena. Values (note and chord names) are resolved here.
+    parser.score = score;
+    if (parse_pass(&parser, text) != 0) {
+        score_file_free(score);
+        return -1;
+    }
+
+    // Play lines may refer to measures defined further down, so their ranges are checked last.
+    for (int t = 0; t < score->track_count; t++) {
+        if (form_check(&score->tracks[t], NULL) != 0) {
+            fprintf(stderr, "Error: %s: Track '%s' plays measures it does not define:\n", name, score->tracks[t].name);
+            form_check(&score->tracks[t], stderr);
+            score_file_free(score);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int score_file_load(const char* path, ScoreFile* score) {
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "Error: Cannot open score file '%s'.\n", path);
+        return -1;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size < 0) {
+        fprintf(stderr, "Error: Cannot read score file '%s'.\n", path);
+        fclose(file);
+        return -1;
+    }
+
+    char* text = (char*)malloc((size_t)size + 1);
+    if (text == NULL) {
+        fprintf(stderr, "Error: Failed to allocate memory for score file '%s'.\n", path);
+        fclose(file);
+        return -1;
+    }
+    size_t read = fread(text, 1, (size_t)size, file);
+    text[read] = '\0';
+    fclose(file);
+
+    int result = score_file_parse(text, path, score);
+    free(text);
+    return result;
+}
+
+void score_file_free(ScoreFile* score) {
+    arena_destroy(score->arena);
+    score->arena = NULL;
+    score->tracks = NULL;
+    score->track_count = 0;
+}
@@ -0,0 +1,70 @@
+#ifndef SCORE_FILE_H
+#define SCORE_FILE_H
+
+#include "arena.h"
+#include "score.h"
+
+// --- Score Text Format ---
+//
+// A score file is plain text. '#' starts a comment that runs to the end of the line.
+//
+//   track <melody|chord> <instrument> <name...>
+//   measure <beats>/<unit> [bpm]
+//   <value>:<duration> <value>:<duration> ...
+//   play <range> [x<times>] [<ending range> ...]
+//
+// A value is a piano key name (e.g., C4, Cs4, Bb3), a chord name from the
+// chords array (e.g., C, Dm7) or "R" for a rest. A duration is a number of
+// beats (1 = quarter note) or one of w, h, q, e, s, t, x (whole down to
+// 64th note), optionally followed by '.' for a dotted note.
+//
+//   track melody 1 Piano Melody
+//   measure 4/4 100
+//   C4:q C4:q G4:q G4:q
+//   measure 4/4
+//   A4:q A4:q G4:h
+//
+// By default a track plays its measures once in order. A track with "play"
+// lines plays them instead, in order: each is a section whose range of
+// measures (1-based, e.g. "3", "1-4", or "1-4@120" to set the tempo when it
+// starts) is repeated <times> times. Each pass is followed by the matching
+// volta ending, and passes beyond the last ending reuse it:
+//
+//   play 1-3@100 x2 4-6@160 4   # 1 2 3 4 5 6 1 2 3 4
+
+/**
+ * @brief A set of tracks loaded from a score file.
+ *
+ * All tracks, measures, events, sections and names live in a single arena, so the
+ * whole score is released with one call to score_file_free().
+ */
+typedef struct {
+    Arena* arena;    /**< The arena that owns every allocation of this score. */
+    Track* tracks;   /**< The loaded tracks. */
+    int track_count; /**< The number of loaded tracks. */
+} ScoreFile;
+
+/**
+ * @brief Parses a score file.
+ * @param path The path of the score file.
+ * @param score Receives the loaded tracks.
+ * @return 0 on success, -1 on failure (an error with the offending line is printed to stderr).
+ */
+int score_file_load(const char* path, ScoreFile* score);
+
+/**
+ * @brief Parses a score held in memory.
+ * @param text The score text. It does not need to outlive the loaded score.
+ * @param name A name for the text used in error messages (e.g., the file path).
+ * @param score Receives the loaded tracks.
+ * @return 0 on success, -1 on failure.
+ */
+int score_file_parse(const char* text, const char* name, ScoreFile* score);
+
+/**
+ * @brief Releases a loaded score and every track in it.
+ * @param score The score to free.
+ */
+void score_file_free(ScoreFile* score);
+
+#endif // SCORE_FILE_H
@@ -0,0 +1,33 @@
+#ifndef SCORE_TABLES_H
+#define SCORE_TABLES_H
+
+#include "score.h"
+
+// --- Compiled Scores ---
+// The score files in scores/ are compiled at build time by tools/scorec into
+// score_tables.c, which make generates and links into the binary. Their
+// events, measures, sections and event tables (with every start time already
+// in ticks) are static const data, so playing one needs no file, no parsing
+// and no conversion at startup, and a score that does not validate fails the
+// build rather than warning at runtime.
+
+/**
+ * @brief A score compiled into the binary.
+ */
+typedef struct {
+    const char* name; /**< The score file's name without directory or extension (e.g., "twinkle"). */
+    Track* tracks;    /**< The tracks of the score. */
+    int track_count;  /**< The number of tracks. */
+} CompiledScore;
+
+extern const CompiledScore compiled_scores[];
+extern const int COMPILED_SCORE_COUNT;
+
+/**
+ * @brief Looks up a compiled score by name.
+ * @param name The score's name (e.g., "twinkle").
+ * @return The score, or NULL if no score of that name was compiled in.
+ */
+const CompiledScore* compiled_score_find(const char* name);
+
+#endif // SCORE_TABLES_H
@@ -0,0 +1,414 @@
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "engine.h"
+#include "job_line.h"
+#include "player.h"
+#include "render.h"
+#include "score_file.h"
+#include "server.h"
+
+#define SERVER_LINE_MAX (2 * PATH_MAX + 16) // Longest accepted job line.
+#define SERVER_BACKLOG 16                    // Pending connections allowed on the socket.
+
+// --- Server Structures ---
+
+/**
+ * @brief A client that submits jobs and receives their replies.
+ *
+ * A connection stays alive until its input has ended and every job it
+ * submitted has been answered.
+ */
+typedef struct {
+    int reply_fd;          /**< Where replies are written. */
+    int owns_fd;           /**< Non-zero if reply_fd is closed when the connection is released. */
+    int pending;           /**< Jobs submitted but not yet answered. */
+    int reading;           /**< Non-zero while more jobs may still arrive. */
+    pthread_mutex_t lock;  /**< Guards the counters and serializes replies. */
+} Connection;
+
+/**
+ * @brief One render request waiting in the queue.
+ */
+typedef struct RenderJob {
+    char score_path[PATH_MAX];
+    char output_path[PATH_MAX];
+    Connection* connection;
+    struct RenderJob* next;
+} RenderJob;
+
+/**
+ * @brief A FIFO of jobs shared by all workers.
+ */
+typedef struct {
+    RenderJob* head;
+    RenderJob* tail;
+    int closed;            /**< Set when no more jobs will be added. */
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+} JobQueue;
+
+/**
+ * @brief A worker thread and the warm Csound instance it owns.
+ */
+typedef struct {
+    pthread_t thread;
+    CSOUND* csound;
+    JobQueue* queue;
+} Worker;
+
+/**
+ * @brief Arguments of a thread that reads jobs from one socket client.
+ */
+typedef struct {
+    Connection* connection;
+    int input_fd;
+    JobQueue* queue;
+} ReaderArgs;
+
+// --- Connections ---
+
+static Connection* connection_create(int reply_fd, int owns_fd) {
+    Connection* connection = (Connection*)calloc(1, sizeof(Connection));
+    if (connection == NULL) {
+        return NULL;
+    }
+    connection->reply_fd = reply_fd;
+    connection->owns_fd = owns_fd;
+    connection->reading = 1;
+    pthread_mutex_init(&connection->lock, NULL);
+    return connection;
+}
+
+/**
+ * @brief Frees a connection if it can receive no more jobs or replies.
+ *
+ * Must be called with the connection's lock held; the lock is released.
+ */
+static void connection_release_locked(Connection* connection) {
+    int done = !connection->reading && connection->pending == 0;
+    pthread_mutex_unlock(&connection->lock);
+    if (done) {
+        if (connection->owns_fd) {
+            close(connection->reply_fd);
+        }
+        pthread_mutex_destroy(&connection->lock);
+        free(connection);
+    }
+}
+
+static void connection_reply(Connection* connection, const char* reply) {
+    pthread_mutex_lock(&connection->lock);
+    size_t length = strlen(reply);
+    size_t written = 0;
+    while (written < length) {
+        ssize_t n = write(connection->reply_fd, reply + written, length - written);
+        if (n <= 0) {
+            break; // The client went away; the job is still complete.
+        }
+        written += (size_t)n;
+    }
+    connection->pending--;
+    connection_release_locked(connection);
+}
+
+// --- Job Queue ---
+
+static void queue_init(JobQueue* queue) {
+    queue->head = NULL;
+    queue->tail = NULL;
+    queue->closed = 0;
+    pthread_mutex_init(&queue->lock, NULL);
+    pthread_cond_init(&queue->ready, NULL);
+}
+
+static void queue_destroy(JobQueue* queue) {
+    pthread_mutex_destroy(&queue->lock);
+    pthread_cond_destroy(&queue->ready);
+}
+
+static void queue_push(JobQueue* queue, RenderJob* job) {
+    pthread_mutex_lock(&queue->lock);
+    job->next = NULL;
+    if (queue->tail != NULL) {
+        queue->tail->next = job;
+    } else {
+        queue->head = job;
+    }
+    queue->tail = job;
+    pthread_cond_signal(&queue->ready);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+/**
+ * @brief Waits for the next job.
+ * @return The job, or NULL once the queue is closed and empty.
+ */
+static RenderJob* queue_pop(JobQueue* queue) {
+    pthread_mutex_lock(&queue->lock);
+    while (queue->head == NULL && !queue->closed) {
+        pthread_cond_wait(&queue->ready, &queue->lock);
+    }
+    RenderJob* job = queue->head;
+    if (job != NULL) {
+        queue->head = job->next;
+        if (queue->head == NULL) {
+            queue->tail = NULL;
+        }
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return job;
+}
+
+static void queue_close(JobQueue* queue) {
+    pthread_mutex_lock(&queue->lock);
+    queue->closed = 1;
+    pthread_cond_broadcast(&queue->ready);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+// --- Workers ---
+
+/**
+ * @brief Renders one job on a warm instance and formats the reply line.
+ */
+static void run_job(CSOUND* csound, const RenderJob* job, char* reply, size_t reply_size) {
+    double start = engine_now_seconds();
+
+    ScoreFile score;
+    if (score_file_load(job->score_path, &score) != 0) {
+        snprintf(reply, reply_size, "error %s cannot load score\n", job->score_path);
+        return;
+    }
+    validate_score(score.tracks, score.track_count, NULL);
+
+    Meter meter;
+    int result = meter_init(&meter, (int)csoundGetNchnls(csound), csoundGetSr(csound));
+    if (result == 0) {
+        result = render_to_wav(csound, score.tracks, score.track_count, 0.0, job->output_path, WAV_PCM16, &meter);
+    }
+    if (result == 0) {
+        // The level report goes next to the output, as for --render.
+        char report[PATH_MAX + sizeof(METER_REPORT_SUFFIX)];
+        snprintf(report, sizeof(report), "%s%s", job->output_path, METER_REPORT_SUFFIX);
+        result = meter_save(report, &meter, NULL, 0);
+    }
+    meter_free(&meter);
+    score_file_free(&score);
+
+    // Reset the instance for the next job instead of recreating it.
+    csoundRewindScore(csound);
+
+    if (result != 0) {
+        snprintf(reply, reply_size, "error %s render failed\n", job->score_path);
+    } else {
+        snprintf(reply, reply_size, "ok %s %.3f\n", job->output_path, engine_now_seconds() - start);
+    }
+}
+
+static void* worker_main(void* arg) {
+    Worker* worker = (Worker*)arg;
+    char reply[SERVER_LINE_MAX];
+    RenderJob* job;
+
+    while ((job = queue_pop(worker->queue)) != NULL) {
+        run_job(worker->csound, job, reply, sizeof(reply));
+        connection_reply(job->connection, reply);
+        free(job);
+    }
+    return NULL;
+}
+
+// --- Job Input ---
+
+/**
+ * @brief Reads job lines from a stream and queues them for a connection.
+ * @return 0 when the input ends, 1 if a "quit" line was read.
+ */
+static int read_jobs(FILE* input, Connection* connection, JobQueue* queue) {
+    char line[SERVER_LINE_MAX];
+    int status;
+    while ((status = job_line_read(input, line, sizeof(line))) != 0) {
+        char* field[JOB_LINE_FIELDS];
+        // A line too long to be a job is rejected whole rather than as several lines.
+        int fields = status < 0 ? -1 : job_line_split(line, field);
+        if (fields == 0) {
+            continue; // Blank line
+        }
+        if (fields == 1 && strcmp(field[0], "quit") == 0) {
+            return 1;
+        }
+
+        pthread_mutex_lock(&connection->lock);
+        connection->pending++;
+        pthread_mutex_unlock(&connection->lock);
+
+        if (fields < 0) {
+            connection_reply(connection, "error - job line too long\n");
+            continue;
+        }
+        if (fields != JOB_LINE_FIELDS) {
+            connection_reply(connection, "error - expected <score_path> <output_path>\n");
+            continue;
+        }
+        RenderJob* job = (RenderJob*)malloc(sizeof(RenderJob));
+        if (job == NULL) {
+            connection_reply(connection, "error - out of memory\n");
+            continue;
+        }
+        snprintf(job->score_path, sizeof(job->score_path), "%s", field[0]);
+        snprintf(job->output_path, sizeof(job->output_path), "%s", field[1]);
+        job->connection = connection;
+        queue_push(queue, job);
+    }
+    return 0;
+}
+
+static void* reader_main(void* arg) {
+    ReaderArgs* args = (ReaderArgs*)arg;
+    FILE* input = fdopen(args->input_fd, "r");
+    if (input != NULL) {
+        read_jobs(input, args->connection, args->queue);
+        fclose(input);
+    } else {
+        close(args->input_fd);
+    }
+
+    pthread_mutex_lock(&args->connection->lock);
+    args->connection->reading = 0;
+    connection_release_locked(args->connection);
+    free(args);
+    return NULL;
+}
+
+/**
+ * @brief Accepts socket clients forever, starting one reader thread per client.
+ * @return 1 if the socket cannot be set up.
+ */
+static int serve_socket(const char* socket_path, JobQueue* queue) {
+    struct sockaddr_un address;
+    if (strlen(socket_path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "Error: Socket path '%s' is too long.\n", socket_path);
+        return 1;
+    }
+
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listen_fd < 0) {
+        perror("Failed to create socket");
+        return 1;
+    }
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, socket_path);
+    unlink(socket_path);
+    if (bind(listen_fd, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(listen_fd, SERVER_BACKLOG) != 0) {
+        perror("Failed to listen on socket");
+        close(listen_fd);
+        return 1;
+    }
+    fprintf(stderr, "Render server listening on %s\n", socket_path);
+
+    for (;;) {
+        int client_fd = accept(listen_fd, NULL, NULL);
+        if (client_fd < 0) {
+            continue;
+        }
+
+        // The reader owns a duplicate of the descriptor so that closing its
+        // stream does not cut off replies that are still being rendered.
+        int input_fd = dup(client_fd);
+        Connection* connection = connection_create(client_fd, 1);
+        ReaderArgs* args = (ReaderArgs*)malloc(sizeof(ReaderArgs));
+        pthread_t reader;
+        if (input_fd < 0 || connection == NULL || args == NULL) {
+            if (input_fd >= 0) close(input_fd);
+            close(client_fd);
+            free(connection);
+            free(args);
+            continue;
+        }
+        args->connection = connection;
+        args->input_fd = input_fd;
+        args->queue = queue;
+        if (pthread_create(&reader, NULL, reader_main, args) != 0) {
+            close(input_fd);
+            close(client_fd);
+            free(connection);
+            free(args);
+            continue;
+        }
+        pthread_detach(reader);
+    }
+}
+
+int server_run(const EngineProfile* profile, const char* socket_path, int workers) {
+    signal(SIGPIPE, SIG_IGN); // A client hanging up must not kill the server.
+    csoundInitialize(CSOUNDINIT_NO_SIGNAL_HANDLER);
+
+    Worker* pool = (Worker*)calloc(workers, sizeof(Worker));
+    if (pool == NULL) {
+        fprintf(stderr, "Error: Failed to allocate memory for workers.\n");
+        return 1;
+    }
+    JobQueue queue;
+    queue_init(&queue);
+
+    // Warm up every instance before accepting jobs: this is the cost that
+    // each job no longer pays.
+    int started = 0;
+    for (; started < workers; started++) {
+        Worker* worker = &pool[started];
+        worker->csound = engine_create_offline(profile);
+        if (worker->csound == NULL) {
+            break;
+        }
+        csoundSetMessageLevel(worker->csound, 0);
+        if (csoundStart(worker->csound) != 0) {
+            engine_destroy(worker->csound);
+            break;
+        }
+        worker->queue = &queue;
+        if (pthread_create(&worker->thread, NULL, worker_main, worker) != 0) {
+            engine_destroy(worker->csound);
+            break;
+        }
+    }
+
+    int result = 0;
+    if (started < workers) {
+        fprintf(stderr, "Error: Only %d of %d workers could be started.\n", started, workers);
+        result = 1;
+    } else {
+        fprintf(stderr, "Render server ready with %d warm workers (profile '%s').\n", workers, profile->name);
+        if (socket_path != NULL) {
+            result = serve_socket(socket_path, &queue);
+        } else {
+            Connection* connection = connection_create(STDOUT_FILENO, 0);
+            if (connection == NULL) {
+                result = 1;
+            } else {
+                read_jobs(stdin, connection, &queue);
+                pthread_mutex_lock(&connection->lock);
+                connection->reading = 0;
+                connection_release_locked(connection);
+            }
+        }
+    }
+
+    // Let the workers finish the queued jobs, then shut down.
+    queue_close(&queue);
+    for (int i = 0; i < started; i++) {
+        pthread_join(pool[i].thread, NULL);
+        engine_destroy(pool[i].csound);
+    }
+    queue_destroy(&queue);
+    free(pool);
+    return result;
+}
@@ -0,0 +1,37 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include "engine.h"
+
+// --- Render Server ---
+//
+// The server keeps a pool of warm Csound instances, one per worker thread,
+// and renders jobs as they arrive. Each job is one line of text:
+//
+//   <score_path> <output_path>
+//
+// and is answered with one line once the render is complete:
+//
+//   ok <output_path> <render_seconds>
+//   error <score_path> <reason>
+//
+// Jobs run concurrently up to the number of workers, so replies may arrive
+// in a different order than the requests. Paths must not contain whitespace.
+
+/**
+ * @brief Runs the render server until its input ends.
+ *
+ * With a socket path, the server listens on a local UNIX socket and serves
+ * every client that connects, answering on the same connection; it does not
+ * return unless the socket cannot be created. Without a socket path, jobs
+ * are read from stdin and answered on stdout until end of input or a line
+ * containing "quit".
+ *
+ * @param profile The engine profile used by every worker instance.
+ * @param socket_path The UNIX socket to listen on, or NULL to use stdin/stdout.
+ * @param workers The number of jobs rendered concurrently.
+ * @return 0 on a clean shutdown, 1 on failure.
+ */
+int server_run(const EngineProfile* profile, const char* socket_path, int workers);
+
+#endif // SERVER_H
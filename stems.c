@@ -0,0 +1,367 @@
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#include "instruments.h"
+#include "meter.h"
+#include "render.h"
+#include "stems.h"
+#include "wav.h"
+
+#define REMIX_BLOCK_FRAMES 4096 // Frames mixed per pass over the stems.
+#define STEM_NAME_MAX 128       // Longest track name kept in the index.
+
+// --- Stem Rendering ---
+
+/**
+ * @brief The open stem files of a render and the buses they are filled from.
+ */
+typedef struct {
+    WavWriter* writers;
+    MYFLT** buses; /**< Csound's audio channel for every stem, ksmps samples each. */
+    Meter* meters; /**< The meter of the mix, then one per stem. */
+    int count;
+} StemSet;
+
+static int write_stem_block(void* user, const MYFLT* samples, int frames, int nchnls) {
+    (void)nchnls;
+    StemSet* set = (StemSet*)user;
+    meter_process(&set->meters[0], samples, frames);
+    for (int i = 0; i < set->count; i++) {
+        meter_process(&set->meters[i + 1], set->buses[i], frames);
+        if (wav_write(&set->writers[i], set->buses[i], frames) != 0) {
+            return -1;
+        }
+        // chnmix adds to the bus, so it is emptied for the next block.
+        memset(set->buses[i], 0, (size_t)frames * sizeof(MYFLT));
+    }
+    return 0;
+}
+
+static void free_meters(Meter* meters, int count) {
+    for (int i = 0; i < count; i++) {
+        meter_free(&meters[i]);
+    }
+    free(meters);
+}
+
+static void stem_path(char* path, size_t size, const char* dir, int stem) {
+    snprintf(path, size, "%s/stem-%03d.wav", dir, stem);
+}
+
+/**
+ * @brief Writes stems.txt, naming the stem file of every track.
+ */
+static int write_index(const char* dir, const Track* tracks, int num_tracks) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", dir, STEMS_INDEX_FILE);
+    FILE* index = fopen(path, "w");
+    if (index == NULL) {
+        fprintf(stderr, "Error: Cannot create '%s'.\n", path);
+        return -1;
+    }
+    for (int t = 0; t < num_tracks; t++) {
+        fprintf(index, "stem-%03d.wav %s\n", t + 1, tracks[t].name);
+    }
+    return fclose(index) == 0 ? 0 : -1;
+}
+
+int stems_render(CSOUND* csound, Track* tracks, int num_tracks, const char* dir) {
+    if (num_tracks > STEM_BUS_MAX) {
+        fprintf(stderr, "Error: At most %d tracks can be rendered to stems.\n", STEM_BUS_MAX);
+        return -1;
+    }
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Error: Cannot create stem directory '%s'.\n", dir);
+        return -1;
+    }
+
+    StemSet set;
+    set.count = 0;
+    set.writers = (WavWriter*)calloc(num_tracks, sizeof(WavWriter));
+    set.buses = (MYFLT**)calloc(num_tracks, sizeof(MYFLT*));
+    set.meters = (Meter*)calloc(num_tracks + 1, sizeof(Meter));
+    int meters = 0;
+    while (set.meters != NULL && meters <= num_tracks
+        && meter_init(&set.meters[meters], meters == 0 ? (int)csoundGetNchnls(csound) : 1, csoundGetSr(csound)) == 0) {
+        meters++;
+    }
+    Player player;
+    int result = -1;
+    if (set.writers == NULL || set.buses == NULL || meters <= num_tracks
+        || player_init(&player, tracks, num_tracks, csoundGetScoreTime(csound), NULL) != 0) {
+        fprintf(stderr, "Error: Failed to allocate memory for the stems.\n");
+        free_meters(set.meters, meters);
+        free(set.writers);
+        free(set.buses);
+        return -1;
+    }
+
+    // Create every bus before the first note so chnmix finds it, and open its file.
+    int sr = (int)csoundGetSr(csound);
+    for (; set.count < num_tracks; set.count++) {
+        char name[32];
+        char path[PATH_MAX];
+        snprintf(name, sizeof(name), STEM_BUS_FORMAT, set.count + 1);
+        if (csoundGetChannelPtr(csound, &set.buses[set.count], name, CSOUND_AUDIO_CHANNEL | CSOUND_INPUT_CHANNEL | CSOUND_OUTPUT_CHANNEL) != 0) {
+            fprintf(stderr, "Error: Cannot create stem bus '%s'.\n", name);
+            break;
+        }
+        memset(set.buses[set.count], 0, (size_t)csoundGetKsmps(csound) * sizeof(MYFLT));
+        stem_path(path, sizeof(path), dir, set.count + 1);
+        if (wav_open(&set.writers[set.count], path, WAV_FLOAT32, sr, 1) != 0) {
+            break;
+        }
+    }
+
+    if (set.count == num_tracks) {
+        player.stems = 1;
+        result = render_player(csound, &player, write_stem_block, &set);
+    }
+    for (int i = 0; i < set.count; i++) {
+        if (wav_close(&set.writers[i]) != 0) {
+            result = -1;
+        }
+    }
+    if (result == 0) {
+        result = write_index(dir, tracks, num_tracks);
+    }
+    if (result == 0) {
+        char path[PATH_MAX];
+        snprintf(path, sizeof(path), "%s/%s", dir, STEMS_LEVELS_FILE);
+        result = meter_save(path, &set.meters[0], &set.meters[1], num_tracks);
+    }
+
+    player_free(&player);
+    free_meters(set.meters, meters);
+    free(set.writers);
+    free(set.buses);
+    return result;
+}
+
+// --- Mixing Kernel ---
+
+/**
+ * @brief Adds a mono block to an interleaved stereo block with a gain per side.
+ * @param in frames mono samples.
+ * @param frames The number of frames.
+ * @param left The gain applied to the left channel.
+ * @param right The gain applied to the right channel.
+ * @param out frames * 2 interleaved samples, added to.
+ */
+static void mix_stem(const float* in, size_t frames, MYFLT left, MYFLT right, MYFLT* out) {
+    size_t i = 0;
+#if defined(USE_DOUBLE) && defined(__SSE2__)
+    const __m128d left_gain = _mm_set1_pd(left);
+    const __m128d right_gain = _mm_set1_pd(right);
+    for (; i + 2 <= frames; i += 2) {
+        __m128d v = _mm_cvtps_pd(_mm_castsi128_ps(_mm_loadl_epi64((const __m128i*)(in + i))));
+        __m128d l = _mm_mul_pd(v, left_gain);
+        __m128d r = _mm_mul_pd(v, right_gain);
+        _mm_storeu_pd(out + 2 * i, _mm_add_pd(_mm_loadu_pd(out + 2 * i), _mm_unpacklo_pd(l, r)));
+        _mm_storeu_pd(out + 2 * i + 2, _mm_add_pd(_mm_loadu_pd(out + 2 * i + 2), _mm_unpackhi_pd(l, r)));
+    }
+#elif defined(USE_DOUBLE) && defined(__ARM_NEON) && defined(__aarch64__)
+    for (; i + 2 <= frames; i += 2) {
+        float64x2_t v = vcvt_f64_f32(vld1_f32(in + i));
+        float64x2_t l = vmulq_n_f64(v, left);
+        float64x2_t r = vmulq_n_f64(v, right);
+        vst1q_f64(out + 2 * i, vaddq_f64(vld1q_f64(out + 2 * i), vzip1q_f64(l, r)));
+        vst1q_f64(out + 2 * i + 2, vaddq_f64(vld1q_f64(out + 2 * i + 2), vzip2q_f64(l, r)));
+    }
+#endif
+    for (; i < frames; i++) {
+        out[2 * i] += in[i] * left;
+        out[2 * i + 1] += in[i] * right;
+    }
+}
+
+// --- Remixing ---
+
+/**
+ * @brief The settings and input file of one stem in a remix.
+ */
+typedef struct {
+    char name[STEM_NAME_MAX];
+    WavReader reader;
+    double gain; /**< Linear gain. */
+    double pan;  /**< -1 (left) to 1 (right). */
+    int mute;
+} RemixStem;
+
+/**
+ * @brief Reads stems.txt and opens every stem it lists.
+ * @return The number of stems, or -1 on failure.
+ */
+static int open_stems(const char* dir, RemixStem** stems) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", dir, STEMS_INDEX_FILE);
+    FILE* index = fopen(path, "r");
+    if (index == NULL) {
+        fprintf(stderr, "Error: Cannot open '%s'; render the stems first with --stems.\n", path);
+        return -1;
+    }
+
+    int count = 0;
+    *stems = NULL;
+    char line[PATH_MAX + STEM_NAME_MAX];
+    while (fgets(line, sizeof(line), index) != NULL) {
+        char file[NAME_MAX + 1];
+        int name_start = 0;
+        if (sscanf(line, "%255s %n", file, &name_start) != 1) {
+            continue;
+        }
+        RemixStem* grown = (RemixStem*)realloc(*stems, (count + 1) * sizeof(RemixStem));
+        if (grown == NULL) {
+            fprintf(stderr, "Error: Failed to allocate memory for the stems.\n");
+            break;
+        }
+        *stems = grown;
+        RemixStem* stem = &grown[count];
+        memset(stem, 0, sizeof(*stem));
+        snprintf(stem->name, sizeof(stem->name), "%s", line + name_start);
+        stem->name[strcspn(stem->name, "\n")] = '\0';
+        stem->gain = 1.0;
+
+        snprintf(path, sizeof(path), "%s/%s", dir, file);
+        if (wav_read_open(&stem->reader, path) != 0) {
+            break;
+        }
+        if (stem->reader.nchnls != 1 || (count > 0 && stem->reader.sr != grown[0].reader.sr)) {
+            fprintf(stderr, "Error: Stem '%s' is not mono at the sample rate of the other stems.\n", path);
+            wav_read_close(&stem->reader);
+            break;
+        }
+        count++;
+    }
+    int complete = feof(index);
+    fclose(index);
+
+    if (!complete || count == 0) {
+        if (complete) {
+            fprintf(stderr, "Error: '%s' lists no stems.\n", dir);
+        }
+        for (int i = 0; i < count; i++) {
+            wav_read_close(&(*stems)[i].reader);
+        }
+        free(*stems);
+        *stems = NULL;
+        return -1;
+    }
+    return count;
+}
+
+/**
+ * @brief Applies a mix specification to the stems.
+ * @return 0 on success, -1 if the specification is malformed.
+ */
+static int parse_mix(const char* mix, RemixStem* stems, int count) {
+    const char* item = mix;
+    while (item != NULL && *item != '\0') {
+        char setting[64];
+        size_t length = strcspn(item, ",");
+        snprintf(setting, sizeof(setting), "%.*s", (int)(length < sizeof(setting) ? length : sizeof(setting) - 1), item);
+        item = item[length] == ',' ? item + length + 1 : NULL;
+
+        int stem = 0;
+        double gain_db = 0.0;
+        double pan = 0.0;
+        char word[8];
+        int fields = sscanf(setting, "%d:%lf:%lf", &stem, &gain_db, &pan);
+        int mute = fields == 1 && sscanf(setting, "%d:%7s", &stem, word) == 2 && strcmp(word, "mute") == 0;
+        if (stem < 1 || stem > count || (fields < 2 && !mute) || pan < -1.0 || pan > 1.0) {
+            fprintf(stderr, "Error: Invalid mix setting '%s' (use <stem>:<gain dB>[:<pan>] or <stem>:mute, stems 1-%d).\n", setting, count);
+            return -1;
+        }
+        RemixStem* target = &stems[stem - 1];
+        if (mute) {
+            target->mute = 1;
+        } else {
+            target->gain = pow(10.0, gain_db / 20.0);
+            target->pan = fields == 3 ? pan : 0.0;
+        }
+    }
+    return 0;
+}
+
+int stems_remix(const char* dir, const char* mix, const char* output_path) {
+    struct timespec started;
+    clock_gettime(CLOCK_MONOTONIC, &started);
+
+    RemixStem* stems = NULL;
+    int count = open_stems(dir, &stems);
+    if (count < 0) {
+        return -1;
+    }
+
+    int result = -1;
+    float* input = (float*)malloc(REMIX_BLOCK_FRAMES * sizeof(float));
+    MYFLT* output = (MYFLT*)malloc(2 * REMIX_BLOCK_FRAMES * sizeof(MYFLT));
+    WavWriter writer;
+    if (input == NULL || output == NULL) {
+        fprintf(stderr, "Error: Failed to allocate memory for the mix buffers.\n");
+    } else if (parse_mix(mix, stems, count) == 0 && wav_open(&writer, output_path, WAV_PCM16, stems[0].reader.sr, 2) == 0) {
+        long frames = 0;
+        for (int i = 0; i < count; i++) {
+            if (stems[i].reader.frames > frames) {
+                frames = stems[i].reader.frames;
+            }
+        }
+
+        result = 0;
+        for (long done = 0; result == 0 && done < frames; done += REMIX_BLOCK_FRAMES) {
+            long block = frames - done < REMIX_BLOCK_FRAMES ? frames - done : REMIX_BLOCK_FRAMES;
+            memset(output, 0, 2 * block * sizeof(MYFLT));
+            for (int i = 0; i < count && result == 0; i++) {
+                RemixStem* stem = &stems[i];
+                if (stem->mute) {
+                    continue;
+                }
+                long got = wav_read(&stem->reader, input, block);
+                if (got < 0) {
+                    fprintf(stderr, "Error: Failed to read stem %d ('%s').\n", i + 1, stem->name);
+                    result = -1;
+                    break;
+                }
+                // Balance panning: the centre leaves both sides at full gain, like the master mix.
+                MYFLT left = stem->gain * (stem->pan > 0 ? 1.0 - stem->pan : 1.0);
+                MYFLT right = stem->gain * (stem->pan < 0 ? 1.0 + stem->pan : 1.0);
+                mix_stem(input, (size_t)got, left, right, output);
+            }
+            if (result == 0 && wav_write(&writer, output, (int)block) != 0) {
+                fprintf(stderr, "Error: Failed to write '%s'.\n", output_path);
+                result = -1;
+            }
+        }
+        if (wav_close(&writer) != 0) {
+            result = -1;
+        }
+        if (result == 0) {
+            struct timespec finished;
+            clock_gettime(CLOCK_MONOTONIC, &finished);
+            double seconds = (double)(finished.tv_sec - started.tv_sec) + (finished.tv_nsec - started.tv_nsec) * 1e-9;
+            printf("Mixed %d stems (%.1f seconds of audio) into '%s' in %.3f seconds.\n",
+                count, (double)frames / stems[0].reader.sr, output_path, seconds);
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        wav_read_close(&stems[i].reader);
+    }
+    free(stems);
+    free(input);
+    free(output);
+    return result;
+}
@@ -0,0 +1,52 @@
+#ifndef STEMS_H
+#define STEMS_H
+
+#include <csound.h>
+#include "score.h"
+
+// --- Stems and Remixing ---
+//
+// A stem render plays the piece once with every track mixed into its own
+// stem bus as well as the master, and writes each bus to a mono 32-bit
+// float WAV file in a directory, along with an index file, stems.txt:
+//
+//   <file> <track name>
+//
+// The levels of the mix and of every stem are written to a report,
+// levels.txt (see meter.h).
+//
+// A remix reads the stems back and mixes them to stereo with a gain, pan and
+// mute per stem, without starting Csound, so trying a new balance costs a
+// pass over the stem files instead of a full synthesis.
+//
+// A mix is written as a comma-separated list of stem settings, numbered
+// from 1 in the order of stems.txt:
+//
+//   <stem>:mute
+//   <stem>:<gain in dB>[:<pan from -1 (left) to 1 (right)>]
+//
+// e.g. "1:-3:0.4,2:mute,3:+2". Unlisted stems keep unity gain, centred.
+
+#define STEMS_INDEX_FILE "stems.txt"   /**< The index written next to the stems. */
+#define STEMS_LEVELS_FILE "levels.txt" /**< The level report written next to the stems. */
+
+/**
+ * @brief Renders every track to its own stem file.
+ * @param csound A started Csound instance created without audio output.
+ * @param tracks The tracks to render.
+ * @param num_tracks The number of tracks (at most STEM_BUS_MAX).
+ * @param dir The directory to write the stems to. It is created if needed.
+ * @return 0 on success, -1 on failure (an error is printed).
+ */
+int stems_render(CSOUND* csound, Track* tracks, int num_tracks, const char* dir);
+
+/**
+ * @brief Mixes a directory of stems into a stereo 16-bit WAV file.
+ * @param dir A directory written by stems_render().
+ * @param mix The per-stem settings, or NULL to mix every stem at unity gain, centred.
+ * @param output_path The WAV file to create.
+ * @return 0 on success, -1 on failure (an error is printed).
+ */
+int stems_remix(const char* dir, const char* mix, const char* output_path);
+
+#endif // STEMS_H
@@ -0,0 +1,71 @@
+#include <stdlib.h>
+
+#include "timeline.h"
+
+void timeline_init(Timeline* timeline) {
+    timeline->notes = NULL;
+    timeline->count = 0;
+    timeline->capacity = 0;
+    timeline->failed = 0;
+}
+
+void timeline_free(Timeline* timeline) {
+    free(timeline->notes);
+    timeline_init(timeline);
+}
+
+void timeline_collect(void* user, const PlayerNote* note) {
+    Timeline* timeline = (Timeline*)user;
+    if (timeline->count == timeline->capacity) {
+        int capacity = timeline->capacity == 0 ? 256 : timeline->capacity * 2;
+        PlayerNote* notes = (PlayerNote*)realloc(timeline->notes, capacity * sizeof(PlayerNote));
+        if (notes == NULL) {
+            timeline->failed = 1;
+            return;
+        }
+        timeline->notes = notes;
+        timeline->capacity = capacity;
+    }
+    timeline->notes[timeline->count++] = *note;
+}
+
+static void skip_note(void* user, const PlayerNote* note) {
+    (void)user;
+    (void)note;
+}
+
+static int compare_times(const void* a, const void* b) {
+    const PlayerNote* x = (const PlayerNote*)a;
+    const PlayerNote* y = (const PlayerNote*)b;
+    if (x->time != y->time) return x->time < y->time ? -1 : 1;
+    if (x->track != y->track) return x->track - y->track;
+    return (x->freq > y->freq) - (x->freq < y->freq);
+}
+
+int timeline_build(Timeline* timeline, Track* tracks, int num_tracks, double from, double to) {
+    Player player;
+    if (player_init(&player, tracks, num_tracks, 0.0, NULL) != 0) {
+        return -1;
+    }
+
+    // Notes retriggered by the seek started earlier, so they are skipped.
+    player.on_note = skip_note;
+    if (from > 0 && player_seek(&player, NULL, from) != 0) {
+        player_free(&player);
+        return -1;
+    }
+    player.on_note = timeline_collect;
+    player.note_user = timeline;
+
+    int first = timeline->count;
+    while (player.running && (to < 0 || player_next_time(&player) - player.start_time < to)) {
+        player_update(&player, NULL, player_next_time(&player));
+    }
+    player_free(&player);
+    if (timeline->failed) {
+        return -1;
+    }
+
+    qsort(timeline->notes + first, timeline->count - first, sizeof(PlayerNote), compare_times);
+    return 0;
+}
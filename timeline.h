@@ -0,0 +1,56 @@
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include "player.h"
+
+// --- Timelines ---
+// A piece (or part of one) laid out ahead of time as a flat list of notes in
+// seconds, using the player's own timing. Work that needs every note up
+// front, such as caching or looping, builds a timeline once instead of
+// stepping a player repeatedly.
+
+/**
+ * @brief A growable list of notes produced by a player.
+ */
+typedef struct {
+    PlayerNote* notes; /**< The notes, in the order they were added (sorted by time after timeline_build()). */
+    int count;         /**< The number of notes. */
+    int capacity;      /**< The allocated length of notes. */
+    int failed;        /**< Non-zero if a note could not be stored because allocation failed. */
+} Timeline;
+
+/**
+ * @brief Prepares an empty timeline.
+ * @param timeline The timeline to initialize.
+ */
+void timeline_init(Timeline* timeline);
+
+/**
+ * @brief Releases the notes of a timeline and leaves it empty.
+ * @param timeline The timeline to free.
+ */
+void timeline_free(Timeline* timeline);
+
+/**
+ * @brief A PlayerNoteFn that appends each note to the Timeline passed as user.
+ * @param user The Timeline to append to.
+ * @param note The note to store.
+ */
+void timeline_collect(void* user, const PlayerNote* note);
+
+/**
+ * @brief Lays out the notes that start in a span of a piece, sorted by start time.
+ *
+ * Notes keep their times from the beginning of the piece. Notes that start
+ * before `from` (even if still sounding there) are left out.
+ *
+ * @param timeline An initialized timeline to append to.
+ * @param tracks The tracks to lay out.
+ * @param num_tracks The number of tracks.
+ * @param from The start of the span in seconds.
+ * @param to The end of the span in seconds (exclusive), or a negative value for the end of the piece.
+ * @return 0 on success, -1 if from is outside the piece or memory allocation fails.
+ */
+int timeline_build(Timeline* timeline, Track* tracks, int num_tracks, double from, double to);
+
+#endif // TIMELINE_H
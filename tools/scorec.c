@@ -0,0 +1,347 @@
+// scorec: compiles score files into constant C tables at build time.
+//
+//   scorec -o score_tables.c scores/twinkle.score ...
+//
+// Every score is parsed and validated with the same code the player uses for
+// --score, then written out as static const MusicEvent, Measure, Section and
+// event table arrays, named after the score file (scores/twinkle.score
+// becomes "twinkle"). A measure whose events do not add up to its time
+// signature, or a duration that is not a whole number of ticks, fails the
+// build instead of producing a warning at startup.
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "event_table.h"
+#include "form.h"
+#include "instrument_piano.h"
+#include "score_file.h"
+
+#define SCOREC_MAX_SCORES 256   // The most score files one run can compile.
+#define SCOREC_MAX_IDENTIFIER 64 // The longest score name, in bytes.
+
+/**
+ * @brief A parsed score and the identifier its tables are named after.
+ */
+typedef struct {
+    const char* path;                     // The score file.
+    char identifier[SCOREC_MAX_IDENTIFIER]; // The file name without directory or extension, as a C identifier.
+    ScoreFile score;                      // The loaded tracks.
+    EventTable* tables;                   // The converted events of every track.
+} CompiledFile;
+
+/**
+ * @brief Derives the score name from a path: "scores/twinkle.score" becomes "twinkle".
+ * @return 0 on success, -1 if the name is empty or too long.
+ */
+static int make_identifier(const char* path, char* identifier) {
+    const char* base = strrchr(path, '/');
+    base = base != NULL ? base + 1 : path;
+    const char* dot = strrchr(base, '.');
+    size_t length = dot != NULL && dot > base ? (size_t)(dot - base) : strlen(base);
+    if (length == 0 || length >= SCOREC_MAX_IDENTIFIER - 1) {
+        return -1;
+    }
+
+    size_t out = 0;
+    if (isdigit((unsigned char)base[0])) {
+        identifier[out++] = '_';
+    }
+    for (size_t i = 0; i < length; i++) {
+        identifier[out++] = isalnum((unsigned char)base[i]) ? base[i] : '_';
+    }
+    identifier[out] = '\0';
+    return 0;
+}
+
+/**
+ * @brief Checks a track's durations strictly: every measure must fill its time signature exactly.
+ * @return The number of problems found (each is printed to stderr).
+ */
+static int check_track(const char* path, const Track* track, const EventTable* table) {
+    int errors = 0;
+    if (table->inexact_events > 0) {
+        fprintf(stderr, "Error: %s: Track '%s': %d event durations are not a multiple of 1/%d quarter note.\n",
+            path, track->name, table->inexact_events, TICKS_PER_QUARTER);
+        errors++;
+    }
+    for (int m = 0; m < track->measure_count; m++) {
+        const Measure* measure = &track->measures[m];
+        uint32_t total_ticks = event_table_measure_ticks(table, m);
+        if ((uint64_t)total_ticks * measure->beat_unit != (uint64_t)measure->beats_per_measure * 4 * TICKS_PER_QUARTER) {
+            double expected = (double)measure->beats_per_measure * (4.0 / (double)measure->beat_unit);
+            fprintf(stderr, "Error: %s: Track '%s', Measure %d: For %d/%d time, expected %.2f quarter notes, but found %.2f.\n",
+                path, track->name, m + 1, measure->beats_per_measure, measure->beat_unit, expected,
+                (double)total_ticks / TICKS_PER_QUARTER);
+            errors++;
+        }
+    }
+    return errors;
+}
+
+/**
+ * @brief Loads, converts and validates one score file.
+ * @return 0 on success, -1 on failure (an error is printed).
+ */
+static int compile_file(CompiledFile* file) {
+    if (score_file_load(file->path, &file->score) != 0) {
+        return -1;
+    }
+    file->tables = (EventTable*)calloc(file->score.track_count, sizeof(EventTable));
+    if (file->tables == NULL) {
+        fprintf(stderr, "Error: Failed to allocate memory for the events of '%s'.\n", file->path);
+        return -1;
+    }
+
+    int errors = 0;
+    for (int t = 0; t < file->score.track_count; t++) {
+        const Track* track = &file->score.tracks[t];
+        if (event_table_build(&file->tables[t], track) != 0) {
+            errors++;
+            continue;
+        }
+        errors += check_track(file->path, track, &file->tables[t]);
+    }
+    return errors == 0 ? 0 : -1;
+}
+
+static void free_file(CompiledFile* file) {
+    if (file->tables != NULL) {
+        for (int t = 0; t < file->score.track_count; t++) {
+            event_table_free(&file->tables[t]);
+        }
+    }
+    free(file->tables);
+    score_file_free(&file->score);
+}
+
+// --- Output ---
+
+static void write_string(FILE* out, const char* text) {
+    fputc('"', out);
+    for (const char* p = text; *p != '\0'; p++) {
+        if (*p == '"' || *p == '\\') {
+            fputc('\\', out);
+        }
+        fputc(*p, out);
+    }
+    fputc('"', out);
+}
+
+static void write_range(FILE* out, const MeasureRange* range) {
+    fprintf(out, "{%d, %d, %.17g}", range->start, range->length, range->bpm);
+}
+
+/**
+ * @brief Writes the tables of one track, each prefixed by "<score>_t<track>_".
+ */
+static void write_track(FILE* out, const char* id, int t, const Track* track, const EventTable* table) {
+    fprintf(out, "// --- %s: %s ---\n", id, track->name);
+
+    // The events of every measure, as written in the score.
+    for (int m = 0; m < track->measure_count; m++) {
+        const Measure* measure = &track->measures[m];
+        if (measure->event_count == 0) {
+            continue;
+        }
+        fprintf(out, "static const MusicEvent %s_t%d_m%d[] = {", id, t, m + 1);
+        for (int i = 0; i < measure->event_count; i++) {
+            fprintf(out, "%s{%d, %.17g}", i > 0 ? ", " : " ", measure->events[i].value, measure->events[i].duration);
+        }
+        fprintf(out, " };\n");
+    }
+    if (track->measure_count > 0) {
+        fprintf(out, "static const Measure %s_t%d_measures[] = {\n", id, t);
+        for (int m = 0; m < track->measure_count; m++) {
+            const Measure* measure = &track->measures[m];
+            if (measure->event_count > 0) {
+                fprintf(out, "    {%s_t%d_m%d, %d, ", id, t, m + 1, measure->event_count);
+            } else {
+                fprintf(out, "    {NULL, 0, ");
+            }
+            fprintf(out, "%d, %d, %.17g},\n", measure->beats_per_measure, measure->beat_unit, measure->bpm);
+        }
+        fprintf(out, "};\n");
+    }
+
+    // The form.
+    for (int s = 0; s < track->section_count; s++) {
+        const Section* section = &track->sections[s];
+        if (section->ending_count == 0) {
+            continue;
+        }
+        fprintf(out, "static const MeasureRange %s_t%d_s%d_endings[] = {", id, t, s + 1);
+        for (int e = 0; e < section->ending_count; e++) {
+            fprintf(out, e > 0 ? ", " : " ");
+            write_range(out, &section->endings[e]);
+        }
+        fprintf(out, " };\n");
+    }
+    if (track->section_count > 0) {
+        fprintf(out, "static const Section %s_t%d_sections[] = {\n", id, t);
+        for (int s = 0; s < track->section_count; s++) {
+            const Section* section = &track->sections[s];
+            fprintf(out, "    {");
+            write_range(out, &section->body);
+            if (section->ending_count > 0) {
+                fprintf(out, ", %d, %s_t%d_s%d_endings, %d},\n", section->times, id, t, s + 1, section->ending_count);
+            } else {
+                fprintf(out, ", %d, NULL, 0},\n", section->times);
+            }
+        }
+        fprintf(out, "};\n");
+    }
+
+    // The event table the player would otherwise build at startup, start times included.
+    if (table->event_count > 0) {
+        fprintf(out, "static const int16_t %s_t%d_pitch[] = {", id, t);
+        for (int e = 0; e < table->event_count; e++) {
+            fprintf(out, "%s%d", e > 0 ? ", " : " ", table->pitch[e]);
+        }
+        fprintf(out, " };\n");
+        fprintf(out, "static const uint16_t %s_t%d_duration[] = {", id, t);
+        for (int e = 0; e < table->event_count; e++) {
+            fprintf(out, "%s%u", e > 0 ? ", " : " ", (unsigned)table->duration[e]);
+        }
+        fprintf(out, " };\n");
+    }
+    fprintf(out, "static const uint32_t %s_t%d_start[] = {", id, t);
+    for (int e = 0; e <= table->event_count; e++) {
+        fprintf(out, "%s%u", e > 0 ? ", " : " ", (unsigned)table->start[e]);
+    }
+    fprintf(out, " };\n");
+    fprintf(out, "static const int %s_t%d_measure_first[] = {", id, t);
+    for (int m = 0; m <= table->measure_count; m++) {
+        fprintf(out, "%s%d", m > 0 ? ", " : " ", table->measure_first[m]);
+    }
+    fprintf(out, " };\n");
+    fprintf(out, "static const EventTable %s_t%d_table = {NULL, %d, %d, ", id, t, table->event_count, table->measure_count);
+    if (table->event_count > 0) {
+        fprintf(out, "%s_t%d_pitch, %s_t%d_duration, ", id, t, id, t);
+    } else {
+        fprintf(out, "NULL, NULL, ");
+    }
+    fprintf(out, "%s_t%d_start, %s_t%d_measure_first, 0};\n\n", id, t, id, t);
+}
+
+static void write_file(FILE* out, const CompiledFile* files, int count) {
+    fprintf(out, "// Generated by tools/scorec. Do not edit: change the score files and rebuild.\n\n");
+    fprintf(out, "#include <stddef.h>\n#include <string.h>\n\n#include \"event_table.h\"\n#include \"score_tables.h\"\n\n");
+
+    for (int f = 0; f < count; f++) {
+        const CompiledFile* file = &files[f];
+        fprintf(out, "// ===== %s =====\n\n", file->path);
+        for (int t = 0; t < file->score.track_count; t++) {
+            write_track(out, file->identifier, t, &file->score.tracks[t], &file->tables[t]);
+        }
+        // The tracks themselves are small and stay writable, since the player takes Track pointers.
+        fprintf(out, "static Track %s_tracks[] = {\n", file->identifier);
+        for (int t = 0; t < file->score.track_count; t++) {
+            const Track* track = &file->score.tracks[t];
+            const char* id = file->identifier;
+            fprintf(out, "    {");
+            write_string(out, track->name);
+            fprintf(out, ", %s, %d, ", track->type == TRACK_CHORD ? "TRACK_CHORD" : "TRACK_MELODY", track->instrument);
+            if (track->measure_count > 0) {
+                fprintf(out, "%s_t%d_measures, %d, ", id, t, track->measure_count);
+            } else {
+                fprintf(out, "NULL, 0, ");
+            }
+            if (track->section_count > 0) {
+                fprintf(out, "%s_t%d_sections, %d, ", id, t, track->section_count);
+            } else {
+                fprintf(out, "NULL, 0, ");
+            }
+            fprintf(out, "&%s_t%d_table},\n", id, t);
+        }
+        fprintf(out, "};\n\n");
+    }
+
+    fprintf(out, "// --- Index ---\n\n");
+    fprintf(out, "const CompiledScore compiled_scores[] = {\n");
+    for (int f = 0; f < count; f++) {
+        fprintf(out, "    {\"%s\", %s_tracks, %d},\n", files[f].identifier, files[f].identifier, files[f].score.track_count);
+    }
+    if (count == 0) {
+        fprintf(out, "    {NULL, NULL, 0}, // No score files were compiled.\n");
+    }
+    fprintf(out, "};\n");
+    fprintf(out, "const int COMPILED_SCORE_COUNT = %d;\n\n", count);
+
+    fprintf(out, "const CompiledScore* compiled_score_find(const char* name) {\n");
+    fprintf(out, "    for (int i = 0; i < COMPILED_SCORE_COUNT; i++) {\n");
+    fprintf(out, "        if (strcmp(compiled_scores[i].name, name) == 0) {\n");
+    fprintf(out, "            return &compiled_scores[i];\n");
+    fprintf(out, "        }\n");
+    fprintf(out, "    }\n");
+    fprintf(out, "    return NULL;\n");
+    fprintf(out, "}\n");
+}
+
+static void print_usage(const char* program) {
+    fprintf(stderr, "Usage: %s -o OUTPUT.c [SCORE_FILE...]\n", program);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3 || strcmp(argv[1], "-o") != 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    const char* output_path = argv[2];
+    int count = argc - 3;
+    if (count > SCOREC_MAX_SCORES) {
+        fprintf(stderr, "Error: At most %d score files can be compiled at once.\n", SCOREC_MAX_SCORES);
+        return 1;
+    }
+
+    // Chord names resolve through the chord pool, exactly as they do at runtime.
+    generate_piano_frequencies();
+    if (generate_chord_pool() != 0) {
+        fprintf(stderr, "Error: Failed to allocate memory for the chord pool.\n");
+        return 1;
+    }
+
+    static CompiledFile files[SCOREC_MAX_SCORES];
+    int failed = 0;
+    for (int f = 0; f < count; f++) {
+        CompiledFile* file = &files[f];
+        file->path = argv[3 + f];
+        if (make_identifier(file->path, file->identifier) != 0) {
+            fprintf(stderr, "Error: %s: Cannot derive a score name from the file name.\n", file->path);
+            failed = 1;
+            continue;
+        }
+        for (int g = 0; g < f; g++) {
+            if (strcmp(files[g].identifier, file->identifier) == 0) {
+                fprintf(stderr, "Error: %s and %s would both be compiled as '%s'.\n", files[g].path, file->path, file->identifier);
+                failed = 1;
+            }
+        }
+        if (compile_file(file) != 0) {
+            failed = 1;
+        }
+    }
+
+    if (!failed) {
+        FILE* out = fopen(output_path, "w");
+        if (out == NULL) {
+            fprintf(stderr, "Error: Cannot create '%s'.\n", output_path);
+            failed = 1;
+        } else {
+            write_file(out, files, count);
+            if (fclose(out) != 0) {
+                fprintf(stderr, "Error: Failed to write '%s'.\n", output_path);
+                remove(output_path);
+                failed = 1;
+            }
+        }
+    }
+
+    for (int f = 0; f < count; f++) {
+        free_file(&files[f]);
+    }
+    free_chord_pool();
+    return failed ? 1 : 0;
+}
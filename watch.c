@@ -0,0 +1,321 @@
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
+
+#include "engine.h"
+#include "watch.h"
+
+#define WATCH_WAKE_MS 100 // How long the thread waits for an event before checking whether to stop.
+
+/**
+ * @brief One version of the score, with the player prepared for it.
+ */
+typedef struct {
+    ScoreFile score;          /**< The tracks of this version. */
+    Player player;            /**< Before it is played, the prepared player. After, the state of the player it replaced. */
+    int has_player;           /**< Non-zero if player holds state to free. */
+    unsigned char* unchanged; /**< Per track, non-zero if it is identical in the version played before. */
+} Version;
+
+struct ScoreWatch {
+    char* path;
+    FILE* log;
+    Version* active;           /**< The version playing. Used by the audio path only. */
+    _Atomic(Version*) pending; /**< A prepared version waiting to be played, handed from the thread to the audio path. */
+    _Atomic(Version*) retired; /**< The version replaced by the last switch, handed back to the thread to free. */
+    Version* base;             /**< The version the next edit is compared with. Used by the thread only. */
+    Version* published;        /**< The last version put in pending. Used by the thread only. */
+    atomic_int stop;
+    pthread_t thread;
+#if defined(__linux__)
+    int inotify_fd;
+    const char* name;          /**< The file name within its directory, to pick out its events. */
+#else
+    struct stat last;          /**< The file's status when it was last read. */
+#endif
+};
+
+static void free_version(Version* version) {
+    if (version == NULL) {
+        return;
+    }
+    if (version->has_player) {
+        player_free(&version->player);
+    }
+    score_file_free(&version->score);
+    free(version->unchanged);
+    free(version);
+}
+
+// --- Comparing Versions ---
+
+static int same_measure(const Measure* a, const Measure* b) {
+    if (a->event_count != b->event_count || a->beats_per_measure != b->beats_per_measure
+        || a->beat_unit != b->beat_unit || a->bpm != b->bpm) {
+        return 0;
+    }
+    for (int e = 0; e < a->event_count; e++) {
+        if (a->events[e].value != b->events[e].value || a->events[e].duration != b->events[e].duration) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int same_range(const MeasureRange* a, const MeasureRange* b) {
+    return a->start == b->start && a->length == b->length && a->bpm == b->bpm;
+}
+
+/**
+ * @brief Checks whether two tracks play the same music (their names may differ).
+ */
+static int same_track(const Track* a, const Track* b) {
+    if (a->type != b->type || a->instrument != b->instrument
+        || a->measure_count != b->measure_count || a->section_count != b->section_count) {
+        return 0;
+    }
+    for (int m = 0; m < a->measure_count; m++) {
+        if (!same_measure(&a->measures[m], &b->measures[m])) {
+            return 0;
+        }
+    }
+    for (int s = 0; s < a->section_count; s++) {
+        const Section* x = &a->sections[s];
+        const Section* y = &b->sections[s];
+        if (!same_range(&x->body, &y->body) || x->times != y->times || x->ending_count != y->ending_count) {
+            return 0;
+        }
+        for (int e = 0; e < x->ending_count; e++) {
+            if (!same_range(&x->endings[e], &y->endings[e])) {
+                return 0;
+            }
+        }
+    }
+    return 1;
+}
+
+// --- Watch Thread ---
+
+/**
+ * @brief Waits up to WATCH_WAKE_MS for the file to be saved.
+ * @return Non-zero if it was.
+ */
+static int wait_for_change(ScoreWatch* watch) {
+#if defined(__linux__)
+    struct pollfd fd = {watch->inotify_fd, POLLIN, 0};
+    if (poll(&fd, 1, WATCH_WAKE_MS) <= 0) {
+        return 0;
+    }
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t length = read(watch->inotify_fd, buffer, sizeof(buffer));
+    int changed = 0;
+    for (ssize_t offset = 0; offset < length;) {
+        const struct inotify_event* event = (const struct inotify_event*)(buffer + offset);
+        // Editors that save to a temporary file and rename it show up as IN_MOVED_TO.
+        if (event->len > 0 && strcmp(event->name, watch->name) == 0) {
+            changed = 1;
+        }
+        offset += sizeof(struct inotify_event) + event->len;
+    }
+    return changed;
+#else
+    for (int waited = 0; waited < WATCH_WAKE_MS; waited += WATCH_POLL_MS) {
+        struct timespec pause = {0, WATCH_POLL_MS * 1000000L};
+        nanosleep(&pause, NULL);
+        struct stat now;
+        if (stat(watch->path, &now) == 0 && (now.st_mtime != watch->last.st_mtime
+                || now.st_size != watch->last.st_size || now.st_ino != watch->last.st_ino)) {
+            watch->last = now;
+            return 1;
+        }
+    }
+    return 0;
+#endif
+}
+
+/**
+ * @brief Loads the saved file, compares it with the version it replaces and hands it to the audio path.
+ */
+static void prepare_version(ScoreWatch* watch) {
+    double start = engine_now_seconds();
+
+    // An edit that was not played yet is superseded; otherwise it is what this one replaces.
+    Version* superseded = atomic_exchange(&watch->pending, NULL);
+    if (superseded != NULL) {
+        free_version(superseded);
+    } else if (watch->published != NULL) {
+        watch->base = watch->published;
+    }
+    watch->published = NULL;
+
+    Version* version = (Version*)calloc(1, sizeof(Version));
+    if (version == NULL) {
+        fprintf(stderr, "Error: Failed to allocate memory for the edited score.\n");
+        return;
+    }
+    if (score_file_load(watch->path, &version->score) != 0) {
+        fprintf(stderr, "Error: Keeping the version of '%s' that is playing.\n", watch->path);
+        free_version(version);
+        return;
+    }
+
+    const ScoreFile* base = &watch->base->score;
+    int count = version->score.track_count;
+    int common = base->track_count < count ? base->track_count : count;
+    version->unchanged = (unsigned char*)calloc(common > 0 ? common : 1, 1);
+    if (version->unchanged == NULL) {
+        fprintf(stderr, "Error: Failed to allocate memory for the edited score.\n");
+        free_version(version);
+        return;
+    }
+    int changed = count - common + (base->track_count - common);
+    for (int t = 0; t < common; t++) {
+        version->unchanged[t] = (unsigned char)same_track(&base->tracks[t], &version->score.tracks[t]);
+        changed += !version->unchanged[t];
+    }
+    if (changed == 0) {
+        free_version(version);
+        return; // Saved without a musical change (e.g., a comment).
+    }
+
+    validate_score(version->score.tracks, count, watch->log);
+    if (player_prepare_reload(&version->player, version->score.tracks, count, version->unchanged, common) != 0) {
+        fprintf(stderr, "Error: Failed to prepare the edited score, keeping the version that is playing.\n");
+        free_version(version);
+        return;
+    }
+    version->has_player = 1;
+
+    watch->published = version;
+    atomic_store(&watch->pending, version);
+    fprintf(watch->log, "Reloaded '%s': %d track%s changed, ready in %.1f ms.\n",
+        watch->path, changed, changed == 1 ? "" : "s", (engine_now_seconds() - start) * 1000.0);
+    fflush(watch->log);
+}
+
+static void* watch_thread(void* arg) {
+    ScoreWatch* watch = (ScoreWatch*)arg;
+    while (!atomic_load(&watch->stop)) {
+        free_version(atomic_exchange(&watch->retired, NULL));
+        if (wait_for_change(watch)) {
+            prepare_version(watch);
+        }
+    }
+    return NULL;
+}
+
+// --- Watching ---
+
+ScoreWatch* score_watch_start(const char* path, ScoreFile* score, FILE* log) {
+    ScoreWatch* watch = (ScoreWatch*)calloc(1, sizeof(ScoreWatch));
+    Version* active = (Version*)calloc(1, sizeof(Version));
+    char* copy = strdup(path);
+    if (watch == NULL || active == NULL || copy == NULL) {
+        fprintf(stderr, "Error: Failed to allocate memory to watch '%s'.\n", path);
+        free(watch);
+        free(active);
+        free(copy);
+        return NULL;
+    }
+    watch->path = copy;
+    watch->log = log;
+
+#if defined(__linux__)
+    // Watch the directory rather than the file, which editors often replace.
+    const char* slash = strrchr(watch->path, '/');
+    watch->name = slash != NULL ? slash + 1 : watch->path;
+    char directory[4096];
+    if (slash == NULL) {
+        snprintf(directory, sizeof(directory), ".");
+    } else if (slash == watch->path) {
+        snprintf(directory, sizeof(directory), "/");
+    } else {
+        snprintf(directory, sizeof(directory), "%.*s", (int)(slash - watch->path), watch->path);
+    }
+    watch->inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (watch->inotify_fd < 0 || inotify_add_watch(watch->inotify_fd, directory, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+        perror("Error: Cannot watch the score file");
+        if (watch->inotify_fd >= 0) {
+            close(watch->inotify_fd);
+        }
+        free(watch->path);
+        free(watch);
+        free(active);
+        return NULL;
+    }
+#else
+    if (stat(path, &watch->last) != 0) {
+        perror("Error: Cannot watch the score file");
+        free(watch->path);
+        free(watch);
+        free(active);
+        return NULL;
+    }
+#endif
+
+    active->score = *score;
+    watch->active = active;
+    watch->base = active;
+    atomic_init(&watch->pending, NULL);
+    atomic_init(&watch->retired, NULL);
+    atomic_init(&watch->stop, 0);
+    if (pthread_create(&watch->thread, NULL, watch_thread, watch) != 0) {
+        fprintf(stderr, "Error: Failed to start the thread watching '%s'.\n", path);
+#if defined(__linux__)
+        close(watch->inotify_fd);
+#endif
+        free(watch->path);
+        free(watch);
+        free(active);
+        return NULL;
+    }
+    memset(score, 0, sizeof(*score));
+    fprintf(log, "Watching '%s' for changes.\n", path);
+    return watch;
+}
+
+int score_watch_apply(ScoreWatch* watch, Player* player, double score_time) {
+    // Wait until the thread has collected the last replaced version, so one slot is enough.
+    if (atomic_load_explicit(&watch->pending, memory_order_relaxed) == NULL || atomic_load(&watch->retired) != NULL) {
+        return 0;
+    }
+    Version* version = atomic_exchange(&watch->pending, NULL);
+    if (version == NULL) {
+        return 0;
+    }
+    player_reload(player, &version->player, version->unchanged, score_time);
+
+    // The replaced player state refers to the previous version's tracks: free them together.
+    Version* previous = watch->active;
+    previous->player = version->player;
+    previous->has_player = 1;
+    version->has_player = 0;
+    watch->active = version;
+    atomic_store(&watch->retired, previous);
+    return 1;
+}
+
+void score_watch_stop(ScoreWatch* watch) {
+    if (watch == NULL) {
+        return;
+    }
+    atomic_store(&watch->stop, 1);
+    pthread_join(watch->thread, NULL);
+#if defined(__linux__)
+    close(watch->inotify_fd);
+#endif
+    free_version(atomic_exchange(&watch->pending, NULL));
+    free_version(atomic_exchange(&watch->retired, NULL));
+    free_version(watch->active);
+    free(watch->path);
+    free(watch);
+}
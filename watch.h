@@ -0,0 +1,59 @@
+#ifndef WATCH_H
+#define WATCH_H
+
+#include <stdio.h>
+#include "player.h"
+#include "score_file.h"
+
+// --- Score Hot Reload ---
+//
+// While a score file plays, a thread watches it (inotify on Linux, polling
+// its modification time elsewhere). When the file is saved, the thread
+// parses it, compares every track with the one playing and prepares a
+// player for the edited piece, all off the audio path. Between two blocks
+// the playing player is then switched over with player_reload(): the
+// playback position and the notes that are sounding are kept, unchanged
+// tracks keep their exact state, and changed tracks resume at their next
+// event in the edited piece. A file that does not parse is reported and the
+// current version keeps playing.
+
+#define WATCH_POLL_MS 10 // How often the file's modification time is checked where inotify is not available.
+
+/**
+ * @brief A score file being watched. The internal structure is hidden; use the score_watch_* functions.
+ */
+typedef struct ScoreWatch ScoreWatch;
+
+/**
+ * @brief Starts watching a score file that is playing.
+ * @param path The score file.
+ * @param score The loaded score the player is playing. The watch takes it over and frees it.
+ * @param log Where reloads are reported.
+ * @return The watch, or NULL on failure (an error is printed; score is then still the caller's).
+ */
+ScoreWatch* score_watch_start(const char* path, ScoreFile* score, FILE* log);
+
+/**
+ * @brief Switches the player over to the latest edit of the score, if one is ready.
+ *
+ * Call it between two control blocks. It only checks an atomic pointer
+ * unless an edit is ready, and it never allocates or waits.
+ *
+ * @param watch The watch.
+ * @param player The playing player.
+ * @param score_time The current Csound score time in seconds.
+ * @return 1 if the player was switched over, 0 otherwise.
+ */
+int score_watch_apply(ScoreWatch* watch, Player* player, double score_time);
+
+/**
+ * @brief Stops watching and frees every version of the score.
+ *
+ * The player must have been freed first, since it refers to the tracks of
+ * the current version.
+ *
+ * @param watch The watch to stop (may be NULL).
+ */
+void score_watch_stop(ScoreWatch* watch);
+
+#endif // WATCH_H
@@ -0,0 +1,202 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "pcm.h"
+#include "wav.h"
+
+#define WAV_HEADER_SIZE 44
+#define WAV_CONVERT_SAMPLES 1024 // Samples converted per fwrite() or fread() call.
+
+static void put_u16(unsigned char* p, uint16_t value) {
+    p[0] = (unsigned char)(value & 0xff);
+    p[1] = (unsigned char)(value >> 8);
+}
+
+static void put_u32(unsigned char* p, uint32_t value) {
+    p[0] = (unsigned char)(value & 0xff);
+    p[1] = (unsigned char)((value >> 8) & 0xff);
+    p[2] = (unsigned char)((value >> 16) & 0xff);
+    p[3] = (unsigned char)(value >> 24);
+}
+
+static uint16_t get_u16(const unsigned char* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get_u32(const unsigned char* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static int bytes_per_sample(WavFormat format) {
+    return format == WAV_PCM16 ? 2 : 4;
+}
+
+/**
+ * @brief Writes the canonical 44-byte RIFF/WAVE header at the current file position.
+ */
+static int write_header(WavWriter* writer) {
+    unsigned char header[WAV_HEADER_SIZE];
+    int sample_bytes = bytes_per_sample(writer->format);
+    uint32_t data_size = (uint32_t)(writer->frames * writer->nchnls * sample_bytes);
+
+    memcpy(header, "RIFF", 4);
+    put_u32(header + 4, 36 + data_size);
+    memcpy(header + 8, "WAVE", 4);
+    memcpy(header + 12, "fmt ", 4);
+    put_u32(header + 16, 16);
+    put_u16(header + 20, writer->format == WAV_PCM16 ? 1 : 3); // 1 = PCM, 3 = IEEE float
+    put_u16(header + 22, (uint16_t)writer->nchnls);
+    put_u32(header + 24, (uint32_t)writer->sr);
+    put_u32(header + 28, (uint32_t)(writer->sr * writer->nchnls * sample_bytes));
+    put_u16(header + 32, (uint16_t)(writer->nchnls * sample_bytes));
+    put_u16(header + 34, (uint16_t)(sample_bytes * 8));
+    memcpy(header + 36, "data", 4);
+    put_u32(header + 40, data_size);
+
+    return fwrite(header, 1, WAV_HEADER_SIZE, writer->file) == WAV_HEADER_SIZE ? 0 : -1;
+}
+
+int wav_open(WavWriter* writer, const char* path, WavFormat format, int sr, int nchnls) {
+    writer->file = fopen(path, "wb");
+    if (writer->file == NULL) {
+        fprintf(stderr, "Error: Cannot create WAV file '%s'.\n", path);
+        return -1;
+    }
+    writer->format = format;
+    writer->sr = sr;
+    writer->nchnls = nchnls;
+    writer->frames = 0;
+    return write_header(writer);
+}
+
+int wav_write(WavWriter* writer, const MYFLT* samples, int frames) {
+    long total = (long)frames * writer->nchnls;
+    long done = 0;
+
+    while (done < total) {
+        long count = total - done;
+        if (count > WAV_CONVERT_SAMPLES) {
+            count = WAV_CONVERT_SAMPLES;
+        }
+
+        size_t written;
+        if (writer->format == WAV_PCM16) {
+            int16_t converted[WAV_CONVERT_SAMPLES];
+            pcm_convert_int16(samples + done, converted, (size_t)count);
+            written = fwrite(converted, sizeof(int16_t), (size_t)count, writer->file);
+        } else {
+            float converted[WAV_CONVERT_SAMPLES];
+            pcm_convert_float32(samples + done, converted, (size_t)count);
+            written = fwrite(converted, sizeof(float), (size_t)count, writer->file);
+        }
+        if (written != (size_t)count) {
+            return -1;
+        }
+        done += count;
+    }
+
+    writer->frames += frames;
+    return 0;
+}
+
+int wav_write_pcm16(WavWriter* writer, const int16_t* samples, long frames) {
+    if (writer->format != WAV_PCM16) {
+        return -1;
+    }
+    size_t count = (size_t)frames * writer->nchnls;
+    if (fwrite(samples, sizeof(int16_t), count, writer->file) != count) {
+        return -1;
+    }
+    writer->frames += frames;
+    return 0;
+}
+
+int wav_close(WavWriter* writer) {
+    int result = 0;
+    if (fseek(writer->file, 0, SEEK_SET) != 0 || write_header(writer) != 0) {
+        result = -1;
+    }
+    if (fclose(writer->file) != 0) {
+        result = -1;
+    }
+    writer->file = NULL;
+    return result;
+}
+
+int wav_read_open(WavReader* reader, const char* path) {
+    memset(reader, 0, sizeof(*reader));
+    reader->file = fopen(path, "rb");
+    if (reader->file == NULL) {
+        fprintf(stderr, "Error: Cannot open WAV file '%s'.\n", path);
+        return -1;
+    }
+
+    // Walk the chunks until the audio data, reading the format on the way.
+    unsigned char header[12];
+    int have_format = 0;
+    if (fread(header, 1, 12, reader->file) == 12 && memcmp(header, "RIFF", 4) == 0 && memcmp(header + 8, "WAVE", 4) == 0) {
+        unsigned char chunk[8];
+        while (fread(chunk, 1, 8, reader->file) == 8) {
+            uint32_t size = get_u32(chunk + 4);
+            if (memcmp(chunk, "fmt ", 4) == 0 && size >= 16) {
+                unsigned char format[16];
+                if (fread(format, 1, 16, reader->file) != 16 || fseek(reader->file, size - 16 + (size & 1), SEEK_CUR) != 0) {
+                    break;
+                }
+                uint16_t tag = get_u16(format);
+                uint16_t bits = get_u16(format + 14);
+                if (tag == 1 && bits == 16) {
+                    reader->format = WAV_PCM16;
+                } else if (tag == 3 && bits == 32) {
+                    reader->format = WAV_FLOAT32;
+                } else {
+                    break;
+                }
+                reader->nchnls = get_u16(format + 2);
+                reader->sr = (int)get_u32(format + 4);
+                have_format = reader->nchnls > 0;
+            } else if (memcmp(chunk, "data", 4) == 0 && have_format) {
+                reader->frames = (long)(size / ((uint32_t)reader->nchnls * bytes_per_sample(reader->format)));
+                return 0;
+            } else if (fseek(reader->file, size + (size & 1), SEEK_CUR) != 0) {
+                break;
+            }
+        }
+    }
+
+    fprintf(stderr, "Error: '%s' is not a 16-bit or 32-bit float WAV file.\n", path);
+    wav_read_close(reader);
+    return -1;
+}
+
+long wav_read(WavReader* reader, float* samples, long frames) {
+    if (frames > reader->frames - reader->position) {
+        frames = reader->frames - reader->position;
+    }
+    size_t count = (size_t)frames * reader->nchnls;
+    if (reader->format == WAV_FLOAT32) {
+        if (fread(samples, sizeof(float), count, reader->file) != count) {
+            return -1;
+        }
+    } else {
+        int16_t encoded[WAV_CONVERT_SAMPLES];
+        for (size_t done = 0; done < count; done += WAV_CONVERT_SAMPLES) {
+            size_t n = count - done < WAV_CONVERT_SAMPLES ? count - done : WAV_CONVERT_SAMPLES;
+            if (fread(encoded, sizeof(int16_t), n, reader->file) != n) {
+                return -1;
+            }
+            for (size_t i = 0; i < n; i++) {
+                samples[done + i] = encoded[i] / 32768.0f;
+            }
+        }
+    }
+    reader->position += frames;
+    return frames;
+}
+
+void wav_read_close(WavReader* reader) {
+    if (reader->file != NULL) {
+        fclose(reader->file);
+    }
+    reader->file = NULL;
+}
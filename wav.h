@@ -0,0 +1,109 @@
+#ifndef WAV_H
+#define WAV_H
+
+#include <csound.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// --- WAV File Output ---
+
+/**
+ * @brief The sample encoding of a WAV file.
+ */
+typedef enum {
+    WAV_PCM16,  /**< 16-bit signed integer samples. */
+    WAV_FLOAT32 /**< 32-bit IEEE float samples. */
+} WavFormat;
+
+/**
+ * @brief An open WAV file that audio is appended to.
+ *
+ * The header is written with placeholder sizes when the file is opened and
+ * patched by wav_close() once the final length is known.
+ */
+typedef struct {
+    FILE* file;       /**< The underlying file. */
+    WavFormat format; /**< The sample encoding. */
+    int sr;           /**< The sample rate in Hz. */
+    int nchnls;       /**< The number of interleaved channels. */
+    long frames;      /**< The number of sample frames written so far. */
+} WavWriter;
+
+/**
+ * @brief Creates a WAV file and writes its header.
+ * @param writer The writer to initialize.
+ * @param path The path of the file to create.
+ * @param format The sample encoding.
+ * @param sr The sample rate in Hz.
+ * @param nchnls The number of channels.
+ * @return 0 on success, -1 if the file cannot be created.
+ */
+int wav_open(WavWriter* writer, const char* path, WavFormat format, int sr, int nchnls);
+
+/**
+ * @brief Appends interleaved samples to the file.
+ *
+ * Samples are expected in the range [-1, 1] (0dbfs = 1) and are clipped
+ * when converted to 16-bit.
+ *
+ * @param writer The writer.
+ * @param samples Interleaved samples, frames * nchnls values.
+ * @param frames The number of sample frames.
+ * @return 0 on success, -1 on a write error.
+ */
+int wav_write(WavWriter* writer, const MYFLT* samples, int frames);
+
+/**
+ * @brief Appends interleaved samples that are already encoded as 16-bit integers.
+ * @param writer A writer opened with WAV_PCM16.
+ * @param samples Interleaved samples, frames * nchnls values.
+ * @param frames The number of sample frames.
+ * @return 0 on success, -1 on a write error or if the file is not 16-bit.
+ */
+int wav_write_pcm16(WavWriter* writer, const int16_t* samples, long frames);
+
+/**
+ * @brief Completes the header and closes the file.
+ * @param writer The writer to close.
+ * @return 0 on success, -1 on a write error.
+ */
+int wav_close(WavWriter* writer);
+
+// --- WAV File Input ---
+
+/**
+ * @brief An open WAV file that audio is read from.
+ */
+typedef struct {
+    FILE* file;       /**< The underlying file, positioned in the data chunk. */
+    WavFormat format; /**< The sample encoding. */
+    int sr;           /**< The sample rate in Hz. */
+    int nchnls;       /**< The number of interleaved channels. */
+    long frames;      /**< The number of sample frames in the file. */
+    long position;    /**< The number of sample frames read so far. */
+} WavReader;
+
+/**
+ * @brief Opens a 16-bit or 32-bit float WAV file and finds its audio data.
+ * @param reader The reader to initialize.
+ * @param path The file to open.
+ * @return 0 on success, -1 if the file cannot be opened or is not a supported WAV file (an error is printed).
+ */
+int wav_read_open(WavReader* reader, const char* path);
+
+/**
+ * @brief Reads interleaved samples as floats in the range [-1, 1].
+ * @param reader The reader.
+ * @param samples Receives up to frames * nchnls values.
+ * @param frames The number of sample frames wanted.
+ * @return The number of frames read (0 at the end of the data), or -1 on a read error.
+ */
+long wav_read(WavReader* reader, float* samples, long frames);
+
+/**
+ * @brief Closes a reader.
+ * @param reader The reader to close.
+ */
+void wav_read_close(WavReader* reader);
+
+#endif // WAV_H